@@ -0,0 +1,60 @@
+#include "CameraPath.h"
+
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+
+bool CameraPath::load(const char* path) {
+	std::ifstream file(path);
+	if (!file) {
+		std::cout << "Failed to open camera path: " << path << std::endl;
+		return false;
+	}
+	poses.clear();
+	std::string line;
+	while (std::getline(file, line)) {
+		if (line.empty() || line[0] == '#') {
+			continue;
+		}
+		std::istringstream s(line);
+		CameraPose pose;
+		s >> pose.time >> pose.position.x >> pose.position.y >> pose.position.z >> pose.fov;
+		for (int c = 0; c < 4; c++) {
+			for (int r = 0; r < 4; r++) {
+				s >> pose.view[c][r];
+			}
+		}
+		if (!s) {
+			std::cout << "Malformed pose in camera path " << path << ": " << line << std::endl;
+			return false;
+		}
+		poses.push_back(pose);
+	}
+	if (poses.empty()) {
+		std::cout << "Camera path " << path << " contains no poses" << std::endl;
+		return false;
+	}
+	return true;
+}
+
+bool CameraPath::save(const char* path) const {
+	std::ofstream file(path);
+	if (!file) {
+		std::cout << "Failed to write camera path: " << path << std::endl;
+		return false;
+	}
+	file << "# time position.x position.y position.z fov view[0][0] view[0][1] ... view[3][3]\n";
+	file.precision(9);
+	for (const CameraPose& pose : poses) {
+		file << pose.time << " " << pose.position.x << " " << pose.position.y << " " << pose.position.z << " " << pose.fov;
+		for (int c = 0; c < 4; c++) {
+			for (int r = 0; r < 4; r++) {
+				file << " " << pose.view[c][r];
+			}
+		}
+		file << "\n";
+	}
+	std::cout << "Camera path of " << poses.size() << " poses written to " << path << std::endl;
+	return true;
+}
\ No newline at end of file
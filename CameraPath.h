@@ -0,0 +1,36 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include <vector>
+
+struct CameraPose {
+	double time; // seconds since recording started
+	glm::vec3 position;
+	glm::mat4 view;
+	float fov;
+};
+
+//Camera poses recorded while flying around (C starts/stops recording in Main.cpp), played back by the autotuner so every
+//configuration is measured over exactly the same views
+class CameraPath {
+public:
+	void clear() {
+		poses.clear();
+	}
+	void add(const CameraPose& pose) {
+		poses.push_back(pose);
+	}
+	int size() const {
+		return (int)poses.size();
+	}
+	const CameraPose& operator[](int i) const {
+		return poses[i];
+	}
+
+	//plain text, one pose per line: time, position, fov then the 16 view matrix elements in column order
+	bool load(const char* path);
+	bool save(const char* path) const;
+
+private:
+	std::vector<CameraPose> poses;
+};
\ No newline at end of file
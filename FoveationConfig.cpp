@@ -0,0 +1,107 @@
+#include "FoveationConfig.h"
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+FoveationConfig FoveationConfig::defaults() {
+	FoveationConfig config;
+	config.sizes = { 0, 900, 250 };
+	config.resolutionScales = { 1.0f / 3.0f, 0.5f, 1.0f };
+	return config;
+}
+
+void FoveationConfig::toPixels(int screenWidth, int screenHeight, int* layerSizes, int* layerResolutions) const {
+	int n = numLayers();
+	for (int i = 0; i < n; i++) {
+		int width = screenWidth, height = screenHeight;
+		if (i > 0) {
+			width = height = std::min(sizes[i], std::min(screenWidth, screenHeight));
+		}
+		//resolution shouldn't be larger than the size, since that would go over the screen's resolution
+		float scale = (i == n - 1) ? 1.0f : std::min(resolutionScales[i], 1.0f);
+		layerSizes[2 * i] = width;
+		layerSizes[2 * i + 1] = height;
+		layerResolutions[2 * i] = std::max(1, (int)std::lround(width * scale));
+		layerResolutions[2 * i + 1] = std::max(1, (int)std::lround(height * scale));
+	}
+}
+
+bool FoveationConfig::isValid(int maxLayers) const {
+	if (numLayers() < 2 || numLayers() > maxLayers || resolutionScales.size() != sizes.size()) {
+		return false;
+	}
+	for (int i = 0; i < numLayers(); i++) {
+		if (resolutionScales[i] <= 0.0f || resolutionScales[i] > 1.0f) {
+			return false;
+		}
+		//each inner layer has to fit inside the one around it
+		if (i > 0 && (sizes[i] <= 0 || (i > 1 && sizes[i] >= sizes[i - 1]))) {
+			return false;
+		}
+	}
+	return true;
+}
+
+std::string FoveationConfig::describe() const {
+	std::ostringstream s;
+	for (int i = 0; i < numLayers(); i++) {
+		if (i > 0) {
+			s << " | ";
+		}
+		if (i == 0) {
+			s << "screen";
+		}
+		else {
+			s << sizes[i];
+		}
+		s << " @ " << resolutionScales[i];
+	}
+	return s.str();
+}
+
+bool FoveationConfig::load(const char* path, int maxLayers) {
+	std::ifstream file(path);
+	if (!file) {
+		return false;
+	}
+	FoveationConfig loaded;
+	std::string line;
+	while (std::getline(file, line)) {
+		std::istringstream s(line);
+		std::string keyword;
+		if (!(s >> keyword) || keyword[0] == '#') {
+			continue;
+		}
+		int size;
+		float scale;
+		if (keyword != "layer" || !(s >> size >> scale)) {
+			std::cout << "Unrecognised line in foveation config " << path << ": " << line << std::endl;
+			return false;
+		}
+		loaded.sizes.push_back(size);
+		loaded.resolutionScales.push_back(scale);
+	}
+	if (!loaded.isValid(maxLayers)) {
+		std::cout << "Foveation config " << path << " is not a valid layout (2 to " << maxLayers << " nested layers), ignoring it" << std::endl;
+		return false;
+	}
+	*this = loaded;
+	return true;
+}
+
+bool FoveationConfig::save(const char* path) const {
+	std::ofstream file(path);
+	if (!file) {
+		std::cout << "Failed to write foveation config: " << path << std::endl;
+		return false;
+	}
+	file << "# layered foveation layout, base (periphery) layer first and fovea last\n";
+	file << "# layer <size in pixels, ignored for the base layer which covers the screen> <resolution as a fraction of size>\n";
+	for (int i = 0; i < numLayers(); i++) {
+		file << "layer " << sizes[i] << " " << resolutionScales[i] << "\n";
+	}
+	return true;
+}
\ No newline at end of file
@@ -0,0 +1,28 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+//Layout of the eccentricity layers used by the layered foveation mode. Layer 0 is the base (periphery) layer, which always covers
+//the whole screen, and the last layer is the fovea, which is always drawn at native resolution. Inner layers are square since the
+//layers are blended with circular boundaries (anything outside the circle would be wasted computation)
+struct FoveationConfig {
+	std::vector<int> sizes; // side length in pixels of each inner layer, the entry for the base layer is ignored
+	std::vector<float> resolutionScales; // resolution of each layer as a fraction of the area of the screen it covers
+
+	//the original hand-picked layout (900/450 and 250/250 inner layers, WIDTH/3 base layer)
+	static FoveationConfig defaults();
+
+	int numLayers() const {
+		return (int)sizes.size();
+	}
+	//fills in the sizes and resolutions arrays (width, height pairs per layer, as used by build_foveation_graph) for a screen
+	void toPixels(int screenWidth, int screenHeight, int* layerSizes, int* layerResolutions) const;
+	//false if the layout can't be drawn (eg more layers than maxLayers or inner layers that aren't nested)
+	bool isValid(int maxLayers) const;
+	std::string describe() const;
+
+	//plain text, one "layer <size> <resolution scale>" line per layer from the base layer inwards
+	bool load(const char* path, int maxLayers);
+	bool save(const char* path) const;
+};
\ No newline at end of file
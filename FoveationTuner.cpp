@@ -0,0 +1,188 @@
+#include "FoveationTuner.h"
+
+#include <glad/glad.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+
+FoveationTuner::FoveationTuner(int width, int height, RenderFunction render, ApplyFunction apply) :
+	width(width), height(height), render(render), apply(apply) {
+	glGenQueries(1, &timerQuery);
+}
+
+FoveationTuner::~FoveationTuner() {
+	glDeleteQueries(1, &timerQuery);
+}
+
+std::vector<FoveationConfig> FoveationTuner::candidateGrid(int maxLayers, int screenWidth, int screenHeight) {
+	//inner layer sizes are picked relative to the screen height so the grid makes sense on any display
+	const float baseScales[] = { 0.25f, 1.0f / 3.0f, 0.5f };
+	const float foveaSizes[] = { 0.15f, 0.25f, 0.35f };
+	const float middleSizes[] = { 0.5f, 0.7f, 0.9f };
+	const float middleScales[] = { 0.35f, 0.5f, 0.7f };
+	int shortSide = std::min(screenWidth, screenHeight);
+
+	std::vector<FoveationConfig> candidates;
+	for (float baseScale : baseScales) {
+		for (float foveaSize : foveaSizes) {
+			int fovea = (int)(foveaSize * shortSide);
+			FoveationConfig twoLayers;
+			twoLayers.sizes = { 0, fovea };
+			twoLayers.resolutionScales = { baseScale, 1.0f };
+			candidates.push_back(twoLayers);
+
+			if (maxLayers < 3) {
+				continue;
+			}
+			for (float middleSize : middleSizes) {
+				for (float middleScale : middleScales) {
+					FoveationConfig threeLayers;
+					threeLayers.sizes = { 0, (int)(middleSize * shortSide), fovea };
+					threeLayers.resolutionScales = { baseScale, middleScale, 1.0f };
+					candidates.push_back(threeLayers);
+				}
+			}
+		}
+	}
+	return candidates;
+}
+
+void FoveationTuner::run(const CameraPath& path, const std::vector<FoveationConfig>& candidates) {
+	std::vector<int> frames;
+	int numFrames = std::min((int)TUNING_FRAMES, path.size());
+	for (int i = 0; i < numFrames; i++) {
+		frames.push_back((int)((long long)i * (path.size() - 1) / std::max(1, numFrames - 1)));
+	}
+
+	//the reference images only depend on the pose, so are drawn once up front
+	std::cout << "Rendering " << frames.size() << " reference frames at " << width << "x" << height << std::endl;
+	std::vector<std::vector<unsigned char>> referenceImages(frames.size());
+	referenceMs = 0.0;
+	for (int f = 0; f < frames.size(); f++) {
+		referenceMs += timeFrame(path[frames[f]], true);
+		readFramebuffer(referenceImages[f]);
+	}
+	referenceMs /= frames.size();
+	std::cout << "Full resolution: " << referenceMs << " ms" << std::endl;
+
+	results.clear();
+	std::vector<unsigned char> image;
+	for (int c = 0; c < candidates.size(); c++) {
+		apply(candidates[c]);
+		TuningResult result = { candidates[c], 0.0, 0.0, false };
+		for (int f = 0; f < frames.size(); f++) {
+			result.gpuMs += timeFrame(path[frames[f]], false);
+			readFramebuffer(image);
+			result.psnr += psnr(image, referenceImages[f]);
+		}
+		result.gpuMs /= frames.size();
+		result.psnr /= frames.size();
+		results.push_back(result);
+		printf("[%d/%d] %s: %.3f ms, %.2f dB\n", c + 1, (int)candidates.size(), result.config.describe().c_str(), result.gpuMs, result.psnr);
+	}
+	markParetoFront();
+}
+
+double FoveationTuner::timeFrame(const CameraPose& pose, bool reference) {
+	double best = -1.0;
+	for (int i = 0; i < TIMING_REPEATS; i++) {
+		glBeginQuery(GL_TIME_ELAPSED, timerQuery);
+		render(pose, reference);
+		glEndQuery(GL_TIME_ELAPSED);
+		//waits for the GPU, which is fine since nothing else is going on
+		GLuint64 nanoseconds = 0;
+		glGetQueryObjectui64v(timerQuery, GL_QUERY_RESULT, &nanoseconds);
+		double ms = nanoseconds / 1e6;
+		if (best < 0.0 || ms < best) {
+			best = ms;
+		}
+	}
+	return best;
+}
+
+void FoveationTuner::readFramebuffer(std::vector<unsigned char>& pixels) const {
+	pixels.resize((size_t)width * height * 3);
+	glBindFramebuffer(GL_READ_FRAMEBUFFER, 0);
+	glReadBuffer(GL_BACK);
+	glPixelStorei(GL_PACK_ALIGNMENT, 1);
+	glReadPixels(0, 0, width, height, GL_RGB, GL_UNSIGNED_BYTE, &pixels[0]);
+}
+
+double FoveationTuner::psnr(const std::vector<unsigned char>& image, const std::vector<unsigned char>& reference) {
+	double squaredError = 0.0;
+	for (size_t i = 0; i < image.size(); i++) {
+		double d = (double)image[i] - reference[i];
+		squaredError += d * d;
+	}
+	double mse = squaredError / image.size();
+	//identical images, capped so they don't swamp the average
+	if (mse < 1e-10) {
+		return 100.0;
+	}
+	return 10.0 * std::log10(255.0 * 255.0 / mse);
+}
+
+void FoveationTuner::markParetoFront() {
+	//sorted fastest first, a result is on the front if it beats the quality of everything faster than it
+	std::vector<int> order(results.size());
+	for (int i = 0; i < order.size(); i++) {
+		order[i] = i;
+	}
+	std::sort(order.begin(), order.end(), [this](int a, int b) {
+		return results[a].gpuMs < results[b].gpuMs || (results[a].gpuMs == results[b].gpuMs && results[a].psnr > results[b].psnr);
+	});
+	double bestPsnr = -1.0;
+	for (int i : order) {
+		results[i].pareto = results[i].psnr > bestPsnr;
+		bestPsnr = std::max(bestPsnr, results[i].psnr);
+	}
+}
+
+const TuningResult* FoveationTuner::choose(double minPsnr) const {
+	const TuningResult* fastest = NULL;
+	const TuningResult* best = NULL;
+	for (const TuningResult& result : results) {
+		if (!result.pareto) {
+			continue;
+		}
+		if (result.psnr >= minPsnr && (!fastest || result.gpuMs < fastest->gpuMs)) {
+			fastest = &result;
+		}
+		if (!best || result.psnr > best->psnr) {
+			best = &result;
+		}
+	}
+	return fastest ? fastest : best;
+}
+
+void FoveationTuner::printParetoFront() const {
+	std::vector<const TuningResult*> front;
+	for (const TuningResult& result : results) {
+		if (result.pareto) {
+			front.push_back(&result);
+		}
+	}
+	std::sort(front.begin(), front.end(), [](const TuningResult* a, const TuningResult* b) { return a->gpuMs < b->gpuMs; });
+
+	std::cout << "Pareto front (" << front.size() << " of " << results.size() << " layouts, full resolution takes " << referenceMs << " ms):" << std::endl;
+	for (const TuningResult* result : front) {
+		printf("  %8.3f ms  %6.2f dB  %s\n", result->gpuMs, result->psnr, result->config.describe().c_str());
+	}
+}
+
+bool FoveationTuner::writeResults(const char* path) const {
+	std::ofstream file(path);
+	if (!file) {
+		std::cout << "Failed to write tuning results: " << path << std::endl;
+		return false;
+	}
+	file << "layers,layout,gpu_ms,psnr_db,pareto\n";
+	file << "0,full resolution," << referenceMs << ",,\n";
+	for (const TuningResult& result : results) {
+		file << result.config.numLayers() << "," << result.config.describe() << "," << result.gpuMs << "," << result.psnr << "," << (result.pareto ? 1 : 0) << "\n";
+	}
+	return true;
+}
\ No newline at end of file
@@ -0,0 +1,57 @@
+#pragma once
+
+#include <functional>
+#include <vector>
+#include "CameraPath.h"
+#include "FoveationConfig.h"
+
+struct TuningResult {
+	FoveationConfig config;
+	double gpuMs; // average over the path's frames of the fastest of TIMING_REPEATS renders
+	double psnr; // average over the path's frames against the full resolution render, in dB
+	bool pareto; // no other configuration is both faster and higher quality
+};
+
+//Offline search over eccentricity layer layouts. Each candidate is applied, then a fixed set of frames from a recorded camera path
+//is drawn with it, timing the GPU work with a timer query and comparing the image against a full resolution render of the same
+//frame. Needs the GL context current (a hidden window works) and blocks on the GPU constantly, so only use it in the tuning run
+class FoveationTuner {
+public:
+	//draw the frame seen from pose into the window's framebuffer, either foveated with the current layout or at full resolution
+	typedef std::function<void(const CameraPose& pose, bool reference)> RenderFunction;
+	//switch the foveated renderer over to a new layout
+	typedef std::function<void(const FoveationConfig& config)> ApplyFunction;
+
+	static const int TUNING_FRAMES = 16; // poses used from the camera path, spread evenly along it
+	static const int TIMING_REPEATS = 3;
+
+	FoveationTuner(int width, int height, RenderFunction render, ApplyFunction apply);
+	~FoveationTuner();
+
+	//grid of layer counts (2 up to maxLayers, at most 3), inner layer sizes and resolution scales for the given screen
+	static std::vector<FoveationConfig> candidateGrid(int maxLayers, int screenWidth, int screenHeight);
+
+	void run(const CameraPath& path, const std::vector<FoveationConfig>& candidates);
+	const std::vector<TuningResult>& getResults() const {
+		return results;
+	}
+	//fastest layout on the Pareto front reaching minPsnr, or the highest quality one if none does (NULL before run)
+	const TuningResult* choose(double minPsnr) const;
+	void printParetoFront() const;
+	//every result as CSV, for plotting
+	bool writeResults(const char* path) const;
+
+private:
+	int width, height;
+	RenderFunction render;
+	ApplyFunction apply;
+	unsigned int timerQuery = 0;
+	std::vector<TuningResult> results;
+	double referenceMs = 0.0;
+
+	//GPU time of the fastest of TIMING_REPEATS draws of the frame, leaving the last one in the framebuffer
+	double timeFrame(const CameraPose& pose, bool reference);
+	void readFramebuffer(std::vector<unsigned char>& pixels) const;
+	static double psnr(const std::vector<unsigned char>& image, const std::vector<unsigned char>& reference);
+	void markParetoFront();
+};
\ No newline at end of file
@@ -0,0 +1,381 @@
+#define STB_IMAGE_WRITE_IMPLEMENTATION // png writing library
+
+#include "FrameCapture.h"
+
+#include <glad/glad.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <thread>
+#include "Profiler.h"
+#include "stb_image_write.h"
+#ifdef _WIN32
+#include <direct.h>
+#else
+#include <sys/stat.h>
+#endif
+
+namespace {
+	template<typename T>
+	void writeValue(std::ofstream& file, T value) {
+		file.write((const char*)&value, sizeof(T));
+	}
+
+	void writeAttribute(std::ofstream& file, const char* name, const char* type, int size) {
+		file.write(name, std::strlen(name) + 1);
+		file.write(type, std::strlen(type) + 1);
+		writeValue<int32_t>(file, size);
+	}
+
+	float srgbToLinear(unsigned char value) {
+		float c = value / 255.0f;
+		return c <= 0.04045f ? c / 12.92f : std::pow((c + 0.055f) / 1.055f, 2.4f);
+	}
+
+	//minimal OpenEXR writer: uncompressed scanlines of 32 bit float B, G, R channels (linear, as EXR expects), little endian only
+	bool writeEXR(const char* path, int width, int height, const unsigned char* rgba) {
+		std::ofstream file(path, std::ios::binary);
+		if (!file) {
+			return false;
+		}
+		writeValue<int32_t>(file, 20000630); // magic number
+		writeValue<int32_t>(file, 2); // version 2, single part scanline file
+
+		//channels have to be in alphabetical order
+		const char* channels[] = { "B", "G", "R" };
+		writeAttribute(file, "channels", "chlist", 3 * (2 + 16) + 1);
+		for (const char* channel : channels) {
+			file.write(channel, 2);
+			writeValue<int32_t>(file, 2); // FLOAT
+			writeValue<int32_t>(file, 0); // pLinear and reserved bytes
+			writeValue<int32_t>(file, 1); // x sampling
+			writeValue<int32_t>(file, 1); // y sampling
+		}
+		writeValue<char>(file, 0);
+		writeAttribute(file, "compression", "compression", 1);
+		writeValue<char>(file, 0); // NO_COMPRESSION
+		for (const char* window : { "dataWindow", "displayWindow" }) {
+			writeAttribute(file, window, "box2i", 16);
+			writeValue<int32_t>(file, 0);
+			writeValue<int32_t>(file, 0);
+			writeValue<int32_t>(file, width - 1);
+			writeValue<int32_t>(file, height - 1);
+		}
+		writeAttribute(file, "lineOrder", "lineOrder", 1);
+		writeValue<char>(file, 0); // INCREASING_Y
+		writeAttribute(file, "pixelAspectRatio", "float", 4);
+		writeValue<float>(file, 1.0f);
+		writeAttribute(file, "screenWindowCenter", "v2f", 8);
+		writeValue<float>(file, 0.0f);
+		writeValue<float>(file, 0.0f);
+		writeAttribute(file, "screenWindowWidth", "float", 4);
+		writeValue<float>(file, 1.0f);
+		writeValue<char>(file, 0); // end of header
+
+		//offset table then one block per scanline, rows are top first while openGL's are bottom first
+		int32_t rowBytes = width * 3 * sizeof(float);
+		uint64_t offset = (uint64_t)file.tellp() + (uint64_t)height * sizeof(uint64_t);
+		for (int y = 0; y < height; y++) {
+			writeValue<uint64_t>(file, offset + (uint64_t)y * (8 + rowBytes));
+		}
+		std::vector<float> row(width * 3);
+		for (int y = 0; y < height; y++) {
+			const unsigned char* source = rgba + (size_t)(height - 1 - y) * width * 4;
+			for (int x = 0; x < width; x++) {
+				row[x] = srgbToLinear(source[4 * x + 2]);
+				row[width + x] = srgbToLinear(source[4 * x + 1]);
+				row[2 * width + x] = srgbToLinear(source[4 * x]);
+			}
+			writeValue<int32_t>(file, y);
+			writeValue<int32_t>(file, rowBytes);
+			file.write((const char*)&row[0], rowBytes);
+		}
+		return (bool)file;
+	}
+}
+
+FrameCapture::FrameCapture(int width, int height, int samples, int numWorkers) : width(width), height(height), workers(numWorkers) {
+	referenceColour = GLRenderbuffer::create();
+	referenceDepth = GLRenderbuffer::create();
+	glBindRenderbuffer(GL_RENDERBUFFER, referenceColour.id());
+	glRenderbufferStorageMultisample(GL_RENDERBUFFER, samples, GL_RGBA8, width, height);
+	referenceColour.setBytes(GPUMemoryCategory::RENDER_TARGETS, (size_t)width * height * 4 * std::max(samples, 1));
+	glBindRenderbuffer(GL_RENDERBUFFER, referenceDepth.id());
+	glRenderbufferStorageMultisample(GL_RENDERBUFFER, samples, GL_DEPTH_COMPONENT24, width, height);
+	referenceDepth.setBytes(GPUMemoryCategory::RENDER_TARGETS, (size_t)width * height * 4 * std::max(samples, 1));
+
+	referenceFramebuffer = GLFramebuffer::create();
+	glBindFramebuffer(GL_FRAMEBUFFER, referenceFramebuffer.id());
+	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, referenceColour.id());
+	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, referenceDepth.id());
+	if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+		std::cout << "Frame capture reference framebuffer is not complete!" << std::endl;
+	}
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+	readFramebuffer = GLFramebuffer::create();
+	resolveFramebuffer = GLFramebuffer::create();
+}
+
+FrameCapture::~FrameCapture() {
+	for (Slot& slot : slots) {
+		if (slot.fence) {
+			glDeleteSync(slot.fence);
+		}
+	}
+	//let queued images finish writing rather than dropping them with the pool
+	while (tasksInFlight.load() > 0) {
+		std::this_thread::yield();
+	}
+}
+
+int FrameCapture::beginFrame(bool evaluate, bool save, float fovY, glm::vec2 fovea) {
+	int id = nextFrameId++;
+	PendingFrame& frame = pending[id];
+	frame.evaluate = evaluate;
+	frame.save = save;
+	frame.fov = fovY;
+	frame.fovea = fovea;
+	if (save) {
+#ifdef _WIN32
+		_mkdir(CAPTURE_DIRECTORY);
+#else
+		mkdir(CAPTURE_DIRECTORY, 0755);
+#endif
+	}
+	return id;
+}
+
+void FrameCapture::captureWindow(int frameId) {
+	TRACE_FUNCTION();
+	glBindFramebuffer(GL_READ_FRAMEBUFFER, 0);
+	glReadBuffer(GL_BACK);
+	readback(frameId, ImageKind::WINDOW, 0, width, height);
+}
+
+void FrameCapture::captureLayer(int frameId, int layer, unsigned int texture, int samples, int layerWidth, int layerHeight) {
+	TRACE_FUNCTION();
+	glBindFramebuffer(GL_READ_FRAMEBUFFER, readFramebuffer.id());
+	glFramebufferTexture2D(GL_READ_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, samples > 0 ? GL_TEXTURE_2D_MULTISAMPLE : GL_TEXTURE_2D, texture, 0);
+	glReadBuffer(GL_COLOR_ATTACHMENT0);
+	if (samples > 0) {
+		resolve(layerWidth, layerHeight);
+	}
+	readback(frameId, ImageKind::LAYER, layer, layerWidth, layerHeight);
+	glBindFramebuffer(GL_READ_FRAMEBUFFER, 0);
+}
+
+void FrameCapture::beginReference() {
+	glBindFramebuffer(GL_FRAMEBUFFER, referenceFramebuffer.id());
+	glViewport(0, 0, width, height);
+	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+}
+
+void FrameCapture::captureReference(int frameId) {
+	TRACE_FUNCTION();
+	glBindFramebuffer(GL_READ_FRAMEBUFFER, referenceFramebuffer.id());
+	glReadBuffer(GL_COLOR_ATTACHMENT0);
+	resolve(width, height);
+	readback(frameId, ImageKind::REFERENCE, 0, width, height);
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+}
+
+void FrameCapture::resolve(int readWidth, int readHeight) {
+	if (readWidth != resolveWidth || readHeight != resolveHeight) {
+		resolveColour = GLRenderbuffer::create();
+		glBindRenderbuffer(GL_RENDERBUFFER, resolveColour.id());
+		glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, readWidth, readHeight);
+		resolveColour.setBytes(GPUMemoryCategory::RENDER_TARGETS, (size_t)readWidth * readHeight * 4);
+		glBindFramebuffer(GL_DRAW_FRAMEBUFFER, resolveFramebuffer.id());
+		glFramebufferRenderbuffer(GL_DRAW_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, resolveColour.id());
+		resolveWidth = readWidth;
+		resolveHeight = readHeight;
+	}
+	glBindFramebuffer(GL_DRAW_FRAMEBUFFER, resolveFramebuffer.id());
+	glBlitFramebuffer(0, 0, readWidth, readHeight, 0, 0, readWidth, readHeight, GL_COLOR_BUFFER_BIT, GL_NEAREST);
+	glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
+	glBindFramebuffer(GL_READ_FRAMEBUFFER, resolveFramebuffer.id());
+	glReadBuffer(GL_COLOR_ATTACHMENT0);
+}
+
+bool FrameCapture::readback(int frameId, ImageKind kind, int layer, int readWidth, int readHeight) {
+	Slot* slot = NULL;
+	for (Slot& s : slots) {
+		if (!s.fence) {
+			slot = &s;
+			break;
+		}
+	}
+	if (!slot) {
+		//waiting here would stall the render thread on the GPU, which is exactly what this is meant to avoid
+		if (dropped++ == 0) {
+			std::cout << "Frame capture readbacks are all in use, dropping captures" << std::endl;
+		}
+		return false;
+	}
+
+	size_t bytes = (size_t)readWidth * readHeight * 4;
+	if (!slot->buffer) {
+		slot->buffer = GLBuffer::create();
+	}
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, slot->buffer.id());
+	if (slot->capacity < bytes) {
+		glBufferData(GL_PIXEL_PACK_BUFFER, bytes, NULL, GL_STREAM_READ);
+		slot->capacity = bytes;
+		slot->buffer.setBytes(GPUMemoryCategory::BUFFERS, bytes);
+	}
+	glPixelStorei(GL_PACK_ALIGNMENT, 4);
+	glReadPixels(0, 0, readWidth, readHeight, GL_RGBA, GL_UNSIGNED_BYTE, (void*)0);
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+	slot->fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+	slot->frameId = frameId;
+	slot->kind = kind;
+	slot->layer = layer;
+	slot->width = readWidth;
+	slot->height = readHeight;
+	pending[frameId].outstanding++;
+	return true;
+}
+
+void FrameCapture::update() {
+	TRACE_FUNCTION();
+	for (Slot& slot : slots) {
+		if (!slot.fence) {
+			continue;
+		}
+		GLenum status = glClientWaitSync(slot.fence, 0, 0);
+		if (status == GL_TIMEOUT_EXPIRED) {
+			continue;
+		}
+		glDeleteSync(slot.fence);
+		slot.fence = NULL;
+		if (status == GL_WAIT_FAILED) {
+			pending[slot.frameId].outstanding--;
+			continue;
+		}
+
+		//the copy out of the mapped buffer is the only part done here, everything else happens on the workers
+		std::shared_ptr<Image> image = std::make_shared<Image>();
+		image->width = slot.width;
+		image->height = slot.height;
+		image->pixels.resize((size_t)slot.width * slot.height * 4);
+		glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.buffer.id());
+		void* data = glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, image->pixels.size(), GL_MAP_READ_BIT);
+		if (data) {
+			std::memcpy(&image->pixels[0], data, image->pixels.size());
+			glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+		}
+		glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+		pending[slot.frameId].outstanding--;
+		if (data) {
+			deliver(slot, image);
+		}
+	}
+
+	for (auto it = pending.begin(); it != pending.end();) {
+		//captures for a frame are all issued before the next update, so a frame with nothing outstanding is complete
+		if (it->second.outstanding > 0) {
+			++it;
+			continue;
+		}
+		finishFrame(it->first, it->second);
+		it = pending.erase(it);
+	}
+}
+
+void FrameCapture::deliver(const Slot& slot, std::shared_ptr<Image> image) {
+	PendingFrame& frame = pending[slot.frameId];
+	if (slot.kind == ImageKind::WINDOW) {
+		frame.window = image;
+	}
+	else if (slot.kind == ImageKind::REFERENCE) {
+		frame.reference = image;
+	}
+
+	if (frame.save) {
+		std::string name = std::string(CAPTURE_DIRECTORY) + "/frame" + std::to_string(slot.frameId) + "_";
+		if (slot.kind == ImageKind::WINDOW) {
+			name += "window";
+		}
+		else if (slot.kind == ImageKind::REFERENCE) {
+			name += "reference";
+		}
+		else {
+			name += "layer" + std::to_string(slot.layer);
+		}
+		submit([image, name]() {
+			if (writeImage(*image, name)) {
+				std::cout << "Captured " << name << std::endl;
+			}
+		});
+	}
+}
+
+void FrameCapture::finishFrame(int frameId, const PendingFrame& frame) {
+	if (!frame.evaluate || !frame.window || !frame.reference) {
+		return;
+	}
+	std::shared_ptr<Image> image = frame.window, reference = frame.reference;
+	float fov = frame.fov;
+	glm::vec2 fovea = frame.fovea;
+	submit([this, image, reference, fov, fovea]() {
+		std::shared_ptr<const EccentricityWeights> frameWeights;
+		{
+			std::lock_guard<std::mutex> lock(resultMutex);
+			frameWeights = weights;
+		}
+		//the fovea follows the gaze, so the weights are often rebuilt, which is done here rather than holding up the render thread
+		if (!frameWeights || !frameWeights->matches(fov, fovea)) {
+			frameWeights = std::make_shared<const EccentricityWeights>(width, height, fov, fovea);
+			std::lock_guard<std::mutex> lock(resultMutex);
+			weights = frameWeights;
+		}
+		ImageQuality quality = compareImages(&image->pixels[0], &reference->pixels[0], *frameWeights);
+		std::lock_guard<std::mutex> lock(resultMutex);
+		if (evaluated == 0 || quality.psnr < worstPsnr) {
+			worstPsnr = quality.psnr;
+		}
+		if (evaluated == 0 || quality.ssim < worstSsim) {
+			worstSsim = quality.ssim;
+		}
+		psnrTotal += quality.psnr;
+		ssimTotal += quality.ssim;
+		evaluated++;
+	});
+}
+
+void FrameCapture::submit(std::function<void()> task) {
+	tasksInFlight++;
+	workers.submit([this, task]() {
+		task();
+		tasksInFlight--;
+	});
+}
+
+void FrameCapture::printSummary() {
+	std::lock_guard<std::mutex> lock(resultMutex);
+	if (evaluated == 0) {
+		return;
+	}
+	printf("quality vs full resolution over %d frames: weighted PSNR %.2f dB (worst %.2f), weighted SSIM %.4f (worst %.4f)\n",
+		evaluated, psnrTotal / evaluated, worstPsnr, ssimTotal / evaluated, worstSsim);
+	evaluated = 0;
+	psnrTotal = ssimTotal = 0.0;
+}
+
+bool FrameCapture::writeImage(const Image& image, const std::string& name) {
+	stbi_flip_vertically_on_write(1);
+	bool png = stbi_write_png((name + ".png").c_str(), image.width, image.height, 4, &image.pixels[0], image.width * 4) != 0;
+	bool exr = writeEXR((name + ".exr").c_str(), image.width, image.height, &image.pixels[0]);
+	if (!png || !exr) {
+		std::cout << "Failed to write capture " << name << std::endl;
+	}
+	return png && exr;
+}
\ No newline at end of file
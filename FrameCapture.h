@@ -0,0 +1,98 @@
+#pragma once
+
+#include <atomic>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include "GLResource.h"
+#include "ImageMetrics.h"
+#include "ThreadPool.h"
+
+struct __GLsync;
+
+//Reads frames back from the GPU without stalling the render thread. Each readback goes into a pixel pack buffer from a small pool
+//with a fence after it, and is only mapped once update() sees the fence has signalled (a few frames later), so glReadPixels never
+//waits for the GPU. Finished frames are handed to worker threads, which compare them against a full resolution reference of the same
+//frame (eccentricity weighted PSNR/SSIM, see ImageMetrics) and/or write every image to CAPTURE_DIRECTORY as PNG and EXR.
+//Everything but the workers runs on the render thread, which owns the GL context
+class FrameCapture {
+public:
+	static const int NUM_SLOTS = 12; // readbacks in flight, captures are dropped (not waited for) when they are all in use
+	static constexpr const char* CAPTURE_DIRECTORY = "captures";
+
+	//samples: MSAA samples of the reference target, matching the window's so the reference is drawn the same way
+	FrameCapture(int width, int height, int samples, int numWorkers);
+	~FrameCapture();
+	FrameCapture(const FrameCapture&) = delete;
+	FrameCapture& operator=(const FrameCapture&) = delete;
+
+	//starts capturing a frame, the returned id is passed to the capture calls for the frame. evaluate compares the window's image
+	//against the reference, save writes every image captured for the frame to disk. fovY and fovea (the one the frame was blended
+	//around, in normalised device coordinates) place the eccentricity weights
+	int beginFrame(bool evaluate, bool save, float fovY, glm::vec2 fovea);
+	//the window's back buffer, so call after drawing the frame and before swapping
+	void captureWindow(int frameId);
+	//a colour attachment (eg an eccentricity layer), multisample textures (samples > 0) are resolved first
+	void captureLayer(int frameId, int layer, unsigned int texture, int samples, int width, int height);
+	//binds the offscreen full resolution target (cleared, viewport set) to draw the frame's reference into
+	void beginReference();
+	//reads the reference back and binds the window's framebuffer again
+	void captureReference(int frameId);
+
+	//once a frame: copies out readbacks that have finished and hands completed frames to the workers
+	void update();
+	//average and worst quality of the frames evaluated since the last call
+	void printSummary();
+
+private:
+	enum class ImageKind { WINDOW, REFERENCE, LAYER };
+	struct Slot {
+		GLBuffer buffer;
+		size_t capacity = 0;
+		__GLsync* fence = NULL; // NULL while the slot is free
+		int frameId = 0;
+		ImageKind kind = ImageKind::WINDOW;
+		int layer = 0;
+		int width = 0, height = 0;
+	};
+	//RGBA8, bottom row first as read from openGL
+	struct Image {
+		int width, height;
+		std::vector<unsigned char> pixels;
+	};
+	struct PendingFrame {
+		bool evaluate = false, save = false;
+		float fov = 0.0f;
+		glm::vec2 fovea = glm::vec2(0.0f);
+		int outstanding = 0; // readbacks issued but not finished yet
+		std::shared_ptr<Image> window, reference;
+	};
+
+	int width, height;
+	Slot slots[NUM_SLOTS];
+	std::map<int, PendingFrame> pending;
+	int nextFrameId = 0;
+	int dropped = 0;
+
+	GLFramebuffer referenceFramebuffer, readFramebuffer, resolveFramebuffer;
+	GLRenderbuffer referenceColour, referenceDepth, resolveColour;
+	int resolveWidth = 0, resolveHeight = 0;
+
+	std::shared_ptr<const EccentricityWeights> weights; // last built, by a worker when the field of view or fovea changes (resultMutex)
+	ThreadPool workers;
+	std::atomic<int> tasksInFlight{ 0 };
+
+	std::mutex resultMutex;
+	int evaluated = 0;
+	double psnrTotal = 0.0, ssimTotal = 0.0, worstPsnr = 0.0, worstSsim = 0.0;
+
+	//reads the bound read framebuffer into a free slot, false if they are all busy
+	bool readback(int frameId, ImageKind kind, int layer, int readWidth, int readHeight);
+	//blits the bound read framebuffer into the single sample resolve target and binds that for reading instead
+	void resolve(int readWidth, int readHeight);
+	void deliver(const Slot& slot, std::shared_ptr<Image> image);
+	void finishFrame(int frameId, const PendingFrame& frame);
+	void submit(std::function<void()> task);
+	static bool writeImage(const Image& image, const std::string& name);
+};
\ No newline at end of file
@@ -0,0 +1,366 @@
+#include <glad/glad.h>
+
+#include "FrameGraph.h"
+#include "Profiler.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <iostream>
+
+FrameGraph::~FrameGraph() {
+	release();
+}
+
+int FrameGraph::createResource(const char* name, FrameGraphResourceDesc desc) {
+	Resource r;
+	r.name = name;
+	r.desc = desc;
+	resources.push_back(r);
+	return resources.size() - 1;
+}
+
+int FrameGraph::addPass(const char* name, std::vector<int> inputs, std::vector<int> colourOutputs, int depthOutput, PassFunction execute) {
+	Pass p;
+	p.name = name;
+	p.inputs = inputs;
+	p.colourOutputs = colourOutputs;
+	p.depthOutput = depthOutput;
+	p.execute = execute;
+#ifdef ENABLE_TRACING
+	p.traceName = Profiler::intern(p.name);
+#endif
+	passes.push_back(std::move(p));
+	return passes.size() - 1;
+}
+
+void FrameGraph::markUse(int resource, int pass) {
+	if (resources[resource].firstUse == -1) {
+		resources[resource].firstUse = pass;
+	}
+	resources[resource].lastUse = pass;
+}
+
+bool FrameGraph::compatible(const FrameGraphResourceDesc& a, const FrameGraphResourceDesc& b) const {
+	if (a.internalFormat != b.internalFormat || a.samples != b.samples || a.renderbuffer != b.renderbuffer || a.sampled != b.sampled) {
+		return false;
+	}
+	//sampled resources are read with normalised coordinates, so a larger physical texture would stretch them
+	if (a.sampled && (a.width != b.width || a.height != b.height)) {
+		return false;
+	}
+	return true;
+}
+
+void FrameGraph::compile() {
+	if (compiled) {
+		std::cout << "Frame graph is already compiled, release() and declare it again to change it" << std::endl;
+		return;
+	}
+
+	//lifetimes - passes are executed in declaration order so a resource is alive from the first pass touching it to the last
+	for (int p = 0; p < passes.size(); p++) {
+		for (int r : passes[p].inputs) markUse(r, p);
+		for (int r : passes[p].colourOutputs) markUse(r, p);
+		if (passes[p].depthOutput != -1) markUse(passes[p].depthOutput, p);
+	}
+
+	//assign resources to physical resources in order of first use, reusing any compatible physical resource whose
+	//current occupant is no longer needed by the time this one is first written
+	std::vector<int> order;
+	for (int r = 0; r < resources.size(); r++) {
+		if (resources[r].firstUse == -1) {
+			std::cout << "Frame graph resource " << resources[r].name << " is never used" << std::endl;
+			continue;
+		}
+		order.push_back(r);
+	}
+	std::sort(order.begin(), order.end(), [this](int a, int b) { return resources[a].firstUse < resources[b].firstUse; });
+
+	for (int r : order) {
+		Resource& res = resources[r];
+		for (int p = 0; p < physicalResources.size(); p++) {
+			if (physicalResources[p].lastUse < res.firstUse && compatible(physicalResources[p].desc, res.desc)) {
+				res.physical = p;
+				break;
+			}
+		}
+		if (res.physical == -1) {
+			PhysicalResource physical;
+			physical.desc = res.desc;
+			physicalResources.push_back(std::move(physical));
+			res.physical = physicalResources.size() - 1;
+		}
+		PhysicalResource& physical = physicalResources[res.physical];
+		physical.desc.width = std::max(physical.desc.width, res.desc.width);
+		physical.desc.height = std::max(physical.desc.height, res.desc.height);
+		physical.lastUse = res.lastUse;
+	}
+
+	for (PhysicalResource& physical : physicalResources) {
+		createPhysical(physical);
+	}
+
+	//a framebuffer per pass, attachments may be shared with other passes' framebuffers
+	for (Pass& pass : passes) {
+		if (pass.colourOutputs.empty() && pass.depthOutput == -1) {
+			continue; // draws to the window's framebuffer
+		}
+		pass.framebuffer = GLFramebuffer::create();
+		glBindFramebuffer(GL_FRAMEBUFFER, pass.framebuffer.id());
+
+		std::vector<GLenum> drawBuffers;
+		for (int i = 0; i < pass.colourOutputs.size(); i++) {
+			const PhysicalResource& physical = physicalResources[resources[pass.colourOutputs[i]].physical];
+			if (physical.desc.renderbuffer) {
+				glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0 + i, GL_RENDERBUFFER, physical.id());
+			}
+			else {
+				glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0 + i, physical.desc.samples > 0 ? GL_TEXTURE_2D_MULTISAMPLE : GL_TEXTURE_2D, physical.id(), 0);
+			}
+			drawBuffers.push_back(GL_COLOR_ATTACHMENT0 + i);
+		}
+		if (drawBuffers.empty()) {
+			glDrawBuffer(GL_NONE);
+		}
+		else {
+			glDrawBuffers(drawBuffers.size(), &drawBuffers[0]);
+		}
+
+		if (pass.depthOutput != -1) {
+			const PhysicalResource& physical = physicalResources[resources[pass.depthOutput].physical];
+			if (physical.desc.renderbuffer) {
+				glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, physical.id());
+			}
+			else {
+				glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, physical.desc.samples > 0 ? GL_TEXTURE_2D_MULTISAMPLE : GL_TEXTURE_2D, physical.id(), 0);
+			}
+		}
+
+		//check framebuffer is complete
+		if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+			std::cout << "Framebuffer for pass " << pass.name << " is not complete!" << std::endl;
+		}
+	}
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+	compiled = true;
+	printReport();
+}
+
+void FrameGraph::createPhysical(PhysicalResource& physical) {
+	const FrameGraphResourceDesc& desc = physical.desc;
+	if (desc.renderbuffer) {
+		physical.renderbuffer = GLRenderbuffer::create();
+		glBindRenderbuffer(GL_RENDERBUFFER, physical.renderbuffer.id());
+		if (desc.samples > 0) {
+			glRenderbufferStorageMultisample(GL_RENDERBUFFER, desc.samples, desc.internalFormat, desc.width, desc.height);
+			glGetRenderbufferParameteriv(GL_RENDERBUFFER, GL_RENDERBUFFER_SAMPLES, &physical.samples);
+		}
+		else {
+			glRenderbufferStorage(GL_RENDERBUFFER, desc.internalFormat, desc.width, desc.height);
+		}
+	}
+	else if (desc.samples > 0) {
+		physical.texture = GLTexture::create();
+		glBindTexture(GL_TEXTURE_2D_MULTISAMPLE, physical.texture.id());
+		glTexImage2DMultisample(GL_TEXTURE_2D_MULTISAMPLE, desc.samples, desc.internalFormat, desc.width, desc.height, GL_TRUE);
+		glGetTexLevelParameteriv(GL_TEXTURE_2D_MULTISAMPLE, 0, GL_TEXTURE_SAMPLES, &physical.samples);
+	}
+	else {
+		//format/type only matter when uploading data, which we never do (but must still be valid for the internal format)
+		bool depth = desc.internalFormat == GL_DEPTH_COMPONENT24 || desc.internalFormat == GL_DEPTH_COMPONENT32F || desc.internalFormat == GL_DEPTH_COMPONENT;
+		physical.texture = GLTexture::create();
+		glBindTexture(GL_TEXTURE_2D, physical.texture.id());
+		glTexImage2D(GL_TEXTURE_2D, 0, desc.internalFormat, desc.width, desc.height, 0, depth ? GL_DEPTH_COMPONENT : GL_RGB, depth ? GL_FLOAT : GL_UNSIGNED_BYTE, NULL);
+		//need to set these as we sample from the texture
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	}
+
+	size_t bytes = sizeInBytes(desc, std::max(physical.samples, desc.samples));
+	if (desc.renderbuffer) {
+		physical.renderbuffer.setBytes(GPUMemoryCategory::RENDER_TARGETS, bytes);
+	}
+	else {
+		physical.texture.setBytes(GPUMemoryCategory::RENDER_TARGETS, bytes);
+	}
+}
+
+void FrameGraph::setPassSkipped(int pass, bool skipped) {
+	passes[pass].skipped = skipped;
+}
+
+void FrameGraph::execute() {
+	if (!compiled) {
+		std::cout << "Frame graph executed before being compiled" << std::endl;
+		return;
+	}
+	int slot = frameIndex % QUERY_FRAMES;
+#ifdef ENABLE_TRACING
+	//GPU timestamps are on their own clock, work out where it is relative to the CPU one to put passes on the same timeline
+	int64_t gpuToCpu = 0;
+	if (timingEnabled && Profiler::isCapturing()) {
+		GLint64 gpuNow;
+		glGetInteger64v(GL_TIMESTAMP, &gpuNow);
+		gpuToCpu = Profiler::now() - gpuNow;
+	}
+#endif
+	for (Pass& pass : passes) {
+		TRACE_SCOPE(pass.traceName);
+		if (timingEnabled) {
+			if (pass.queries[0] == 0) {
+				glGenQueries(2 * QUERY_FRAMES, pass.queries);
+			}
+			//timestamps at the start and end of the pass rather than a GL_TIME_ELAPSED query, so each pass' GPU work can also be
+			//placed on the trace timeline. This slot's queries were issued QUERY_FRAMES frames ago so are almost always ready,
+			//if they aren't then skip them rather than wait
+			unsigned int startQuery = pass.queries[2 * slot], endQuery = pass.queries[2 * slot + 1];
+			if (pass.queryIssued[slot]) {
+				GLint available = 0;
+				glGetQueryObjectiv(endQuery, GL_QUERY_RESULT_AVAILABLE, &available);
+				if (available) {
+					GLuint64 start, end;
+					glGetQueryObjectui64v(startQuery, GL_QUERY_RESULT, &start);
+					glGetQueryObjectui64v(endQuery, GL_QUERY_RESULT, &end);
+					pass.totalGpuMs += (end - start) / 1000000.0;
+					pass.timedFrames++;
+#ifdef ENABLE_TRACING
+					if (Profiler::isCapturing()) {
+						Profiler::recordGpu(pass.traceName, (int64_t)start + gpuToCpu, (int64_t)(end - start));
+					}
+#endif
+				}
+			}
+			pass.queryIssued[slot] = !pass.skipped;
+			if (!pass.skipped) {
+				glQueryCounter(startQuery, GL_TIMESTAMP);
+			}
+		}
+		if (pass.skipped) {
+			continue;
+		}
+
+		glBindFramebuffer(GL_FRAMEBUFFER, pass.framebuffer.id());
+
+		//aliased physical resources can be larger than the resource using them, don't waste time shading the excess
+		int output = !pass.colourOutputs.empty() ? pass.colourOutputs[0] : pass.depthOutput;
+		if (output != -1) {
+			glEnable(GL_SCISSOR_TEST);
+			glScissor(0, 0, resources[output].desc.width, resources[output].desc.height);
+		}
+		pass.execute(*this);
+		if (output != -1) {
+			glDisable(GL_SCISSOR_TEST);
+		}
+
+		if (timingEnabled) {
+			glQueryCounter(pass.queries[2 * slot + 1], GL_TIMESTAMP);
+		}
+	}
+	frameIndex++;
+}
+
+void FrameGraph::setTimingEnabled(bool enabled) {
+	timingEnabled = enabled;
+}
+
+void FrameGraph::printTimings() {
+	double total = 0.0;
+	for (Pass& pass : passes) {
+		if (pass.timedFrames == 0) continue;
+		double ms = pass.totalGpuMs / pass.timedFrames;
+		total += ms;
+		printf("  %s: %f ms GPU\n", pass.name.c_str(), ms);
+		pass.totalGpuMs = 0.0;
+		pass.timedFrames = 0;
+	}
+	printf("  all passes: %f ms GPU\n", total);
+}
+
+void FrameGraph::release() {
+	//framebuffers and attachments are deleted by their handles
+	for (Pass& pass : passes) {
+		if (pass.queries[0] != 0) {
+			glDeleteQueries(2 * QUERY_FRAMES, pass.queries);
+		}
+	}
+	passes.clear();
+	resources.clear();
+	physicalResources.clear();
+	compiled = false;
+}
+
+unsigned int FrameGraph::getTexture(int resource) const {
+	return physicalResources[resources[resource].physical].id();
+}
+
+unsigned int FrameGraph::getFramebuffer(int pass) const {
+	return passes[pass].framebuffer.id();
+}
+
+int FrameGraph::getSamples(int resource) const {
+	return physicalResources[resources[resource].physical].samples;
+}
+
+const FrameGraphResourceDesc& FrameGraph::getDesc(int resource) const {
+	return resources[resource].desc;
+}
+
+//estimates, drivers are free to pad formats (3 byte formats are almost always stored as 4)
+size_t FrameGraph::bytesPerPixel(unsigned int internalFormat) {
+	switch (internalFormat) {
+	case GL_R8:
+		return 1;
+	case GL_RG8:
+	case GL_R16F:
+	case GL_DEPTH_COMPONENT16:
+		return 2;
+	case GL_RGB16F:
+	case GL_RGBA16F:
+	case GL_RG32F:
+		return 8;
+	case GL_RGB32F:
+	case GL_RGBA32F:
+		return 16;
+	default: // GL_RGB, GL_RGB8, GL_RGBA8, GL_DEPTH_COMPONENT24, GL_DEPTH_COMPONENT32F, GL_R32F etc
+		return 4;
+	}
+}
+
+size_t FrameGraph::sizeInBytes(const FrameGraphResourceDesc& desc, int samples) {
+	return (size_t)desc.width * desc.height * std::max(samples, 1) * bytesPerPixel(desc.internalFormat);
+}
+
+size_t FrameGraph::getPeakBytes() const {
+	//every physical resource stays allocated for the whole frame, so the peak is simply their sum
+	size_t total = 0;
+	for (const PhysicalResource& physical : physicalResources) {
+		total += sizeInBytes(physical.desc, std::max(physical.samples, physical.desc.samples));
+	}
+	return total;
+}
+
+size_t FrameGraph::getUnaliasedBytes() const {
+	size_t total = 0;
+	for (const Resource& res : resources) {
+		if (res.physical != -1) {
+			total += sizeInBytes(res.desc, std::max(physicalResources[res.physical].samples, res.desc.samples));
+		}
+	}
+	return total;
+}
+
+void FrameGraph::printReport() const {
+	std::cout << "Frame graph: " << passes.size() << " passes, " << resources.size() << " resources in " << physicalResources.size() << " physical resources" << std::endl;
+	for (const Resource& res : resources) {
+		if (res.physical == -1) continue;
+		std::cout << "  " << res.name << " (" << res.desc.width << "x" << res.desc.height;
+		if (res.desc.samples > 0) {
+			std::cout << ", " << physicalResources[res.physical].samples << "x";
+		}
+		std::cout << ") passes " << res.firstUse << "-" << res.lastUse << " -> physical " << res.physical << std::endl;
+	}
+	printf("  Peak VRAM: %.2f MB (%.2f MB without aliasing)\n", getPeakBytes() / (1024.0 * 1024.0), getUnaliasedBytes() / (1024.0 * 1024.0));
+}
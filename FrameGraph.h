@@ -0,0 +1,108 @@
+#pragma once
+
+#include <functional>
+#include <string>
+#include <vector>
+#include "GLResource.h"
+
+//Description of a transient attachment. Resources with compatible descriptions whose lifetimes (first to last pass using them)
+//don't overlap are given the same physical texture/renderbuffer
+struct FrameGraphResourceDesc {
+	unsigned int internalFormat; // eg GL_RGB, GL_DEPTH_COMPONENT24
+	int width;
+	int height;
+	int samples; // 0 for a regular texture/renderbuffer, otherwise a multisample one with (at least) this many samples
+	bool renderbuffer; // renderbuffers can't be read by shaders, so use them for attachments that are only rendered to (eg depth)
+	bool sampled; // read using normalised texture coordinates, so can only share memory with resources of exactly the same size
+};
+
+class FrameGraph {
+public:
+	//called with the pass' framebuffer already bound (framebuffer 0 if the pass writes no resources) and, if the pass has an
+	//output, the scissor rectangle set to the size of the output
+	typedef std::function<void(FrameGraph&)> PassFunction;
+
+	~FrameGraph();
+
+	//declare a transient resource, returns a handle used to refer to it when adding passes
+	int createResource(const char* name, FrameGraphResourceDesc desc);
+	//declare a pass, the order passes are added in is the order they are executed in. colourOutputs are attached as
+	//GL_COLOR_ATTACHMENT0..n and depthOutput (-1 for none) as the depth attachment of the pass' framebuffer
+	int addPass(const char* name, std::vector<int> inputs, std::vector<int> colourOutputs, int depthOutput, PassFunction execute);
+
+	//works out resource lifetimes, assigns transient resources to physical ones (aliasing where possible) and creates all
+	//of the openGL objects, must be called after declaring everything and before execute()
+	void compile();
+	void execute();
+	//skipped passes are left out of execute() until unskipped, so their outputs keep what they were last drawn with. Only
+	//meaningful for outputs that are read later in the frame (so not aliased with anything written before they are read)
+	void setPassSkipped(int pass, bool skipped);
+	//deletes all openGL objects and forgets all passes and resources, so the graph can be declared again
+	void release();
+
+	unsigned int getTexture(int resource) const;
+	unsigned int getFramebuffer(int pass) const;
+	//sample count actually allocated by the driver, which is allowed to be higher than the count asked for
+	int getSamples(int resource) const;
+	const FrameGraphResourceDesc& getDesc(int resource) const;
+
+	//memory used by the physical resources after aliasing, and what it would have been with every resource kept separately
+	size_t getPeakBytes() const;
+	size_t getUnaliasedBytes() const;
+	void printReport() const;
+
+	//GPU time of every pass is measured with timestamp queries, which are read back QUERY_FRAMES frames later so the CPU never
+	//waits. While a trace is being captured they are also recorded on the trace's GPU track
+	void setTimingEnabled(bool enabled);
+	//prints the average GPU time of each pass since the last call
+	void printTimings();
+
+private:
+	struct Resource {
+		std::string name;
+		FrameGraphResourceDesc desc;
+		int firstUse = -1, lastUse = -1;
+		int physical = -1;
+	};
+	static const int QUERY_FRAMES = 3;
+
+	struct Pass {
+		std::string name;
+		std::vector<int> inputs;
+		std::vector<int> colourOutputs;
+		int depthOutput;
+		PassFunction execute;
+		GLFramebuffer framebuffer; // empty for passes drawing to the window
+		bool skipped = false;
+
+		unsigned int queries[2 * QUERY_FRAMES] = {}; // start and end timestamp for each frame in flight
+		const char* traceName = NULL; // name for trace events, kept valid after the pass is released
+		bool queryIssued[QUERY_FRAMES] = {};
+		double totalGpuMs = 0.0;
+		int timedFrames = 0;
+	};
+	struct PhysicalResource {
+		FrameGraphResourceDesc desc; // width and height are the largest of all resources aliased onto it
+		int lastUse = -1;
+		GLTexture texture;
+		GLRenderbuffer renderbuffer;
+		int samples = 0;
+
+		unsigned int id() const {
+			return desc.renderbuffer ? renderbuffer.id() : texture.id();
+		}
+	};
+
+	std::vector<Resource> resources;
+	std::vector<Pass> passes;
+	std::vector<PhysicalResource> physicalResources;
+	bool compiled = false;
+	bool timingEnabled = false;
+	int frameIndex = 0;
+
+	void markUse(int resource, int pass);
+	bool compatible(const FrameGraphResourceDesc& a, const FrameGraphResourceDesc& b) const;
+	void createPhysical(PhysicalResource& physical);
+	static size_t bytesPerPixel(unsigned int internalFormat);
+	static size_t sizeInBytes(const FrameGraphResourceDesc& desc, int samples);
+};
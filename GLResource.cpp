@@ -0,0 +1,102 @@
+#include <glad/glad.h>
+#include <GLFW/glfw3.h>
+
+#include "GLResource.h"
+
+#include <cstring>
+#include <iostream>
+
+std::atomic<long long> GPUMemory::bytes[(int)GPUMemoryCategory::NUM_CATEGORIES];
+
+void GPUMemory::add(GPUMemoryCategory category, long long amount) {
+	bytes[(int)category] += amount;
+}
+
+long long GPUMemory::getBytes(GPUMemoryCategory category) {
+	return bytes[(int)category];
+}
+
+long long GPUMemory::getTotalBytes() {
+	long long total = 0;
+	for (int i = 0; i < (int)GPUMemoryCategory::NUM_CATEGORIES; i++) {
+		total += bytes[i];
+	}
+	return total;
+}
+
+void GPUMemory::printReport() {
+	const char* names[] = { "buffers", "textures", "render targets" };
+	std::cout << "GPU memory:" << std::endl;
+	for (int i = 0; i < (int)GPUMemoryCategory::NUM_CATEGORIES; i++) {
+		std::cout << "  " << names[i] << ": " << bytes[i] / (1024.0 * 1024.0) << " MB" << std::endl;
+	}
+	std::cout << "  total: " << getTotalBytes() / (1024.0 * 1024.0) << " MB" << std::endl;
+}
+
+bool hasGLExtension(const char* name) {
+	GLint numExtensions = 0;
+	glGetIntegerv(GL_NUM_EXTENSIONS, &numExtensions);
+	for (GLint i = 0; i < numExtensions; i++) {
+		if (std::strcmp((const char*)glGetStringi(GL_EXTENSIONS, i), name) == 0) {
+			return true;
+		}
+	}
+	return false;
+}
+
+unsigned int createGLObject(GLResourceType type) {
+	unsigned int id = 0;
+	switch (type) {
+	case GLResourceType::BUFFER:
+		glGenBuffers(1, &id);
+		break;
+	case GLResourceType::VERTEX_ARRAY:
+		glGenVertexArrays(1, &id);
+		break;
+	case GLResourceType::TEXTURE:
+		glGenTextures(1, &id);
+		break;
+	case GLResourceType::FRAMEBUFFER:
+		glGenFramebuffers(1, &id);
+		break;
+	case GLResourceType::RENDERBUFFER:
+		glGenRenderbuffers(1, &id);
+		break;
+	case GLResourceType::PROGRAM:
+		id = glCreateProgram();
+		break;
+	case GLResourceType::QUERY:
+		glGenQueries(1, &id);
+		break;
+	}
+	return id;
+}
+
+void deleteGLObject(GLResourceType type, unsigned int id) {
+	if (glfwGetCurrentContext() == NULL) {
+		return;
+	}
+	switch (type) {
+	case GLResourceType::BUFFER:
+		glDeleteBuffers(1, &id);
+		break;
+	case GLResourceType::VERTEX_ARRAY:
+		glDeleteVertexArrays(1, &id);
+		break;
+	case GLResourceType::TEXTURE:
+		glDeleteTextures(1, &id);
+		break;
+	case GLResourceType::FRAMEBUFFER:
+		glDeleteFramebuffers(1, &id);
+		break;
+	case GLResourceType::RENDERBUFFER:
+		glDeleteRenderbuffers(1, &id);
+		break;
+	case GLResourceType::PROGRAM:
+		glDeleteProgram(id);
+		break;
+	case GLResourceType::QUERY:
+		glDeleteQueries(1, &id);
+		break;
+	}
+}
\ No newline at end of file
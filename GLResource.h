@@ -0,0 +1,111 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+
+//What GPU memory is being used for, tracked separately by GPUMemory
+enum class GPUMemoryCategory {
+	BUFFERS, // vertex/index/uniform/staging buffers
+	TEXTURES, // material textures
+	RENDER_TARGETS, // framebuffer attachments
+	NUM_CATEGORIES
+};
+
+//Process wide count of the GPU memory owned by GLHandles, per category. Only what the handles were told about with setBytes() is
+//counted (the driver's own overheads aren't visible through openGL), but that is everything this program allocates
+class GPUMemory {
+public:
+	static void add(GPUMemoryCategory category, long long bytes);
+	static long long getBytes(GPUMemoryCategory category);
+	static long long getTotalBytes();
+	static void printReport();
+private:
+	static std::atomic<long long> bytes[(int)GPUMemoryCategory::NUM_CATEGORIES];
+};
+
+enum class GLResourceType {
+	BUFFER,
+	VERTEX_ARRAY,
+	TEXTURE,
+	FRAMEBUFFER,
+	RENDERBUFFER,
+	PROGRAM,
+	QUERY
+};
+
+//whether the current context's driver advertises the extension
+bool hasGLExtension(const char* name);
+
+unsigned int createGLObject(GLResourceType type);
+//does nothing if no context is current, eg for handles destroyed after glfwTerminate (which already freed everything)
+void deleteGLObject(GLResourceType type, unsigned int id);
+
+//Move-only owner of an openGL object, deleting it (and removing its memory from GPUMemory) when destroyed or reset
+template <GLResourceType TYPE>
+class GLHandle {
+public:
+	GLHandle() {}
+	~GLHandle() {
+		reset();
+	}
+	GLHandle(GLHandle&& other) noexcept : handle(other.handle), bytes(other.bytes), category(other.category) {
+		other.handle = 0;
+		other.bytes = 0;
+	}
+	GLHandle& operator=(GLHandle&& other) noexcept {
+		if (this != &other) {
+			reset();
+			handle = other.handle;
+			bytes = other.bytes;
+			category = other.category;
+			other.handle = 0;
+			other.bytes = 0;
+		}
+		return *this;
+	}
+	GLHandle(const GLHandle&) = delete;
+	GLHandle& operator=(const GLHandle&) = delete;
+
+	//glGen*()/glCreateProgram() a new object
+	static GLHandle create() {
+		GLHandle h;
+		h.handle = createGLObject(TYPE);
+		return h;
+	}
+
+	unsigned int id() const {
+		return handle;
+	}
+	explicit operator bool() const {
+		return handle != 0;
+	}
+
+	//how much GPU memory the object's storage uses, replacing any earlier value (eg when a texture is redefined)
+	void setBytes(GPUMemoryCategory newCategory, size_t newBytes) {
+		GPUMemory::add(category, -(long long)bytes);
+		category = newCategory;
+		bytes = newBytes;
+		GPUMemory::add(category, (long long)bytes);
+	}
+
+	void reset() {
+		if (handle != 0) {
+			deleteGLObject(TYPE, handle);
+			handle = 0;
+		}
+		setBytes(category, 0);
+	}
+
+private:
+	unsigned int handle = 0;
+	size_t bytes = 0;
+	GPUMemoryCategory category = GPUMemoryCategory::BUFFERS;
+};
+
+typedef GLHandle<GLResourceType::BUFFER> GLBuffer;
+typedef GLHandle<GLResourceType::VERTEX_ARRAY> GLVertexArray;
+typedef GLHandle<GLResourceType::TEXTURE> GLTexture;
+typedef GLHandle<GLResourceType::FRAMEBUFFER> GLFramebuffer;
+typedef GLHandle<GLResourceType::RENDERBUFFER> GLRenderbuffer;
+typedef GLHandle<GLResourceType::PROGRAM> GLProgram;
+typedef GLHandle<GLResourceType::QUERY> GLQuery;
\ No newline at end of file
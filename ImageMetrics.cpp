@@ -0,0 +1,114 @@
+#include "ImageMetrics.h"
+#include "SimdLanes.h"
+#include "Profiler.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace {
+	//SSIM windows and the stride between them, the window width is a whole number of SIMD steps for every lane width
+	const int SSIM_WINDOW = 8;
+	const int SSIM_STRIDE = 4;
+	//stabilising constants for 8 bit values
+	const float SSIM_C1 = (0.01f * 255.0f) * (0.01f * 255.0f);
+	const float SSIM_C2 = (0.03f * 255.0f) * (0.03f * 255.0f);
+
+	//Rec. 709 luma, padded by a SIMD step at the end of the buffer so row loads never need a scalar tail
+	std::vector<float> luminance(const unsigned char* rgba, int width, int height) {
+		size_t count = (size_t)width * height;
+		std::vector<float> result(count + Lanes::WIDTH, 0.0f);
+		for (size_t i = 0; i < count; i++) {
+			const unsigned char* p = rgba + 4 * i;
+			result[i] = 0.2126f * p[0] + 0.7152f * p[1] + 0.0722f * p[2];
+		}
+		return result;
+	}
+
+	double weightedPsnr(const std::vector<float>& a, const std::vector<float>& b, const EccentricityWeights& weights) {
+		int width = weights.getWidth();
+		double squaredError = 0.0, totalWeight = 0.0;
+		for (int y = 0; y < weights.getHeight(); y++) {
+			const float* rowA = &a[(size_t)y * width];
+			const float* rowB = &b[(size_t)y * width];
+			const float* rowW = weights.row(y);
+			//accumulated in floats across a row, doubles across the image
+			Lanes error = Lanes::set(0.0f), weight = Lanes::set(0.0f);
+			int x = 0;
+			for (; x + Lanes::WIDTH <= width; x += Lanes::WIDTH) {
+				Lanes d = Lanes::load(rowA + x) - Lanes::load(rowB + x);
+				Lanes w = Lanes::load(rowW + x);
+				error = madd(w * d, d, error);
+				weight = weight + w;
+			}
+			squaredError += hsum(error);
+			totalWeight += hsum(weight);
+			for (; x < width; x++) {
+				float d = rowA[x] - rowB[x];
+				squaredError += rowW[x] * d * d;
+				totalWeight += rowW[x];
+			}
+		}
+		double mse = squaredError / std::max(totalWeight, 1e-12);
+		//identical images, capped so they don't swamp averages
+		if (mse < 1e-10) {
+			return 100.0;
+		}
+		return 10.0 * std::log10(255.0 * 255.0 / mse);
+	}
+
+	double weightedSsim(const std::vector<float>& a, const std::vector<float>& b, const EccentricityWeights& weights) {
+		int width = weights.getWidth(), height = weights.getHeight();
+		const float n = (float)(SSIM_WINDOW * SSIM_WINDOW);
+		double total = 0.0, totalWeight = 0.0;
+		for (int y = 0; y + SSIM_WINDOW <= height; y += SSIM_STRIDE) {
+			for (int x = 0; x + SSIM_WINDOW <= width; x += SSIM_STRIDE) {
+				Lanes sumA = Lanes::set(0.0f), sumB = sumA, sumAA = sumA, sumBB = sumA, sumAB = sumA;
+				for (int row = 0; row < SSIM_WINDOW; row++) {
+					size_t offset = (size_t)(y + row) * width + x;
+					for (int col = 0; col < SSIM_WINDOW; col += Lanes::WIDTH) {
+						Lanes va = Lanes::load(&a[offset + col]);
+						Lanes vb = Lanes::load(&b[offset + col]);
+						sumA = sumA + va;
+						sumB = sumB + vb;
+						sumAA = madd(va, va, sumAA);
+						sumBB = madd(vb, vb, sumBB);
+						sumAB = madd(va, vb, sumAB);
+					}
+				}
+				float meanA = hsum(sumA) / n, meanB = hsum(sumB) / n;
+				float varianceA = hsum(sumAA) / n - meanA * meanA;
+				float varianceB = hsum(sumBB) / n - meanB * meanB;
+				float covariance = hsum(sumAB) / n - meanA * meanB;
+				double ssim = ((2.0 * meanA * meanB + SSIM_C1) * (2.0 * covariance + SSIM_C2)) /
+					((meanA * meanA + meanB * meanB + SSIM_C1) * (varianceA + varianceB + SSIM_C2));
+
+				float w = weights.row(y + SSIM_WINDOW / 2)[x + SSIM_WINDOW / 2];
+				total += w * ssim;
+				totalWeight += w;
+			}
+		}
+		return totalWeight > 0.0 ? total / totalWeight : 1.0;
+	}
+}
+
+EccentricityWeights::EccentricityWeights(int width, int height, float fovYDegrees, glm::vec2 fovea) :
+	width(width), height(height), fov(fovYDegrees), fovea(fovea), weights((size_t)width * height + Lanes::WIDTH, 0.0f) {
+	//distance from the eye to the screen in pixels, from the vertical field of view
+	float focalLength = (height * 0.5f) / std::tan(fovYDegrees * 3.14159265f / 360.0f);
+	float foveaX = (fovea.x + 1.0f) * 0.5f * width, foveaY = (fovea.y + 1.0f) * 0.5f * height;
+	for (int y = 0; y < height; y++) {
+		float dy = y + 0.5f - foveaY;
+		for (int x = 0; x < width; x++) {
+			float dx = x + 0.5f - foveaX;
+			float eccentricity = std::atan(std::sqrt(dx * dx + dy * dy) / focalLength) * 180.0f / 3.14159265f;
+			weights[(size_t)y * width + x] = E2 / (E2 + eccentricity);
+		}
+	}
+}
+
+ImageQuality compareImages(const unsigned char* image, const unsigned char* reference, const EccentricityWeights& weights) {
+	TRACE_FUNCTION();
+	std::vector<float> a = luminance(image, weights.getWidth(), weights.getHeight());
+	std::vector<float> b = luminance(reference, weights.getWidth(), weights.getHeight());
+	return { weightedPsnr(a, b, weights), weightedSsim(a, b, weights) };
+}
\ No newline at end of file
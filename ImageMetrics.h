@@ -0,0 +1,43 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include <cstddef>
+#include <vector>
+
+//Per pixel weights for the quality metrics, modelled on cortical magnification: errors at eccentricity e degrees from the fovea
+//count E2 / (E2 + e) as much as errors at the fovea, so detail the eye can't resolve in the periphery barely affects the score
+class EccentricityWeights {
+public:
+	static constexpr float E2 = 2.3f; // eccentricity in degrees at which the weight has halved
+
+	//fovea is in normalised device coordinates, and rows are bottom first like openGL's
+	EccentricityWeights(int width, int height, float fovYDegrees, glm::vec2 fovea);
+
+	int getWidth() const {
+		return width;
+	}
+	int getHeight() const {
+		return height;
+	}
+	//whether these are the weights for a view with this field of view and fovea
+	bool matches(float fovYDegrees, glm::vec2 otherFovea) const {
+		return fov == fovYDegrees && fovea == otherFovea;
+	}
+	const float* row(int y) const {
+		return &weights[(size_t)y * width];
+	}
+
+private:
+	int width, height;
+	float fov;
+	glm::vec2 fovea;
+	std::vector<float> weights;
+};
+
+struct ImageQuality {
+	double psnr; // eccentricity weighted PSNR of the luminance, in dB
+	double ssim; // eccentricity weighted mean SSIM of the luminance over 8x8 windows, 1 for identical images
+};
+
+//both images RGBA8 with the same size as the weights. Runs on the calling thread, frames are spread over threads by the caller
+ImageQuality compareImages(const unsigned char* image, const unsigned char* reference, const EccentricityWeights& weights);
\ No newline at end of file
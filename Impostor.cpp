@@ -0,0 +1,256 @@
+#include <glad/glad.h>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "Impostor.h"
+#include "Scene.h"
+#include "Profiler.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sys/stat.h>
+
+//billboards cover a handful of pixels, so the atlas only needs mips down to 16 pixel views. Smaller ones would mostly be filtered
+//from neighbouring views
+static const int MIP_LEVELS = 4;
+static const char CACHE_MAGIC[8] = { 'I', 'M', 'P', 'O', 'S', 'T', 'O', 'R' };
+
+struct ImpostorCacheHeader {
+	char magic[8];
+	uint32_t grid;
+	uint32_t viewSize;
+	float centre[3];
+	float radius;
+};
+
+//direction from the model towards the camera that a view was baked from, hemi-octahedral mapping of the view cell's centre.
+//REMEMBER TO KEEP THIS CONSISTENT WITH impostorVertexShader.gl
+static glm::vec3 viewDirection(int x, int y) {
+	glm::vec2 uv((x + 0.5f) / ImpostorAtlas::GRID * 2.0f - 1.0f, (y + 0.5f) / ImpostorAtlas::GRID * 2.0f - 1.0f);
+	glm::vec2 p = 0.5f * glm::vec2(uv.x + uv.y, uv.x - uv.y);
+	return glm::normalize(glm::vec3(p.x, 1.0f - std::fabs(p.x) - std::fabs(p.y), p.y));
+}
+
+ImpostorAtlas::ImpostorAtlas() :
+	bakeShader("impostorBakeVertexShader.gl", "impostorBakeFragmentShader.gl"),
+	shader("impostorVertexShader.gl", "impostorFragmentShader.gl"),
+	vao(GLVertexArray::create()) {
+}
+
+bool ImpostorAtlas::build(Scene& scene, const std::string& sourcePath, const std::string& cachePath) {
+	TRACE_FUNCTION();
+	//the cache is only used if it was written after the model was last modified
+	struct stat sourceStat, cacheStat;
+	bool sourceExists = stat(sourcePath.c_str(), &sourceStat) == 0;
+	bool cacheExists = stat(cachePath.c_str(), &cacheStat) == 0;
+	if (cacheExists && (!sourceExists || cacheStat.st_mtime >= sourceStat.st_mtime) && readCache(cachePath)) {
+		std::cout << "Loaded impostor atlas from " << cachePath << std::endl;
+	}
+	else {
+		glm::vec3 min, max;
+		if (!scene.getBounds(min, max) || min == max) {
+			std::cout << "Nothing to bake impostors from" << std::endl;
+			return false;
+		}
+		centre = 0.5f * (min + max);
+		radius = 0.5f * glm::length(max - min);
+		bake(scene);
+		writeCache(cachePath);
+	}
+
+	shader.use();
+	shader.setInt("albedoMap", 0);
+	shader.setInt("normalDepthMap", 1);
+	shader.setVec3f("boundsCentre", centre);
+	shader.setFloat("boundsRadius", radius);
+	ready = true;
+	placeSpheres();
+	return true;
+}
+
+void ImpostorAtlas::placeInstances(const glm::mat4* instanceModels, int count) {
+	models.assign(instanceModels, instanceModels + count);
+	placeSpheres();
+}
+
+void ImpostorAtlas::placeSpheres() {
+	instanceSpheres.resize(models.size());
+	for (int i = 0; i < (int)models.size(); i++) {
+		const glm::mat4& model = models[i];
+		float scale = std::max(glm::length(glm::vec3(model[0])), std::max(glm::length(glm::vec3(model[1])), glm::length(glm::vec3(model[2]))));
+		instanceSpheres[i] = glm::vec4(glm::vec3(model * glm::vec4(centre, 1.0f)), radius * scale);
+	}
+}
+
+void ImpostorAtlas::select(const glm::vec3& camPos, float pixelScale, float maxDistance, float minPixels, int* geometry, int& numGeometry, int* impostors, int& numImpostors) const {
+	numGeometry = 0;
+	numImpostors = 0;
+	for (int i = 0; i < (int)instanceSpheres.size(); i++) {
+		bool impostor = false;
+		if (ready) {
+			const glm::vec4& sphere = instanceSpheres[i];
+			float distance = glm::length(glm::vec3(sphere) - camPos);
+			//an instance the camera is inside of is always drawn properly
+			impostor = distance > sphere.w && (distance > maxDistance || 2.0f * sphere.w * pixelScale / distance < minPixels);
+		}
+		if (impostor) {
+			impostors[numImpostors++] = i;
+		}
+		else {
+			geometry[numGeometry++] = i;
+		}
+	}
+}
+
+void ImpostorAtlas::draw(const int* instances, int count) {
+	TRACE_FUNCTION();
+	if (!ready || count == 0) {
+		return;
+	}
+	shader.use();
+	for (int i = 0; i < count; i++) {
+		shader.setInt(("instanceIds[" + std::to_string(i) + "]").c_str(), instances[i]);
+	}
+	glActiveTexture(GL_TEXTURE0);
+	glBindTexture(GL_TEXTURE_2D, albedo.id());
+	glActiveTexture(GL_TEXTURE1);
+	glBindTexture(GL_TEXTURE_2D, normalDepth.id());
+	glBindVertexArray(vao.id());
+	glDrawArraysInstanced(GL_TRIANGLES, 0, 6, count);
+	glBindVertexArray(0);
+}
+
+void ImpostorAtlas::bake(Scene& scene) {
+	TRACE_FUNCTION();
+	createTextures(NULL, NULL);
+	GLFramebuffer framebuffer = GLFramebuffer::create();
+	GLRenderbuffer depth = GLRenderbuffer::create();
+	glBindRenderbuffer(GL_RENDERBUFFER, depth.id());
+	glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, ATLAS_SIZE, ATLAS_SIZE);
+	glBindFramebuffer(GL_FRAMEBUFFER, framebuffer.id());
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, albedo.id(), 0);
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT1, GL_TEXTURE_2D, normalDepth.id(), 0);
+	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, depth.id());
+	unsigned int attachments[] = { GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1 };
+	glDrawBuffers(2, attachments);
+	if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+		std::cout << "Impostor atlas framebuffer is incomplete" << std::endl;
+	}
+
+	//zero coverage wherever no view draws anything
+	float clearColour[] = { 0.0f, 0.0f, 0.0f, 0.0f };
+	glClearBufferfv(GL_COLOR, 0, clearColour);
+	glClearBufferfv(GL_COLOR, 1, clearColour);
+	glClear(GL_DEPTH_BUFFER_BIT);
+	int polygonMode[2];
+	glGetIntegerv(GL_POLYGON_MODE, polygonMode);
+	glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
+	//the reference and full resolution draws rely on the window's viewport being left alone
+	int viewport[4];
+	glGetIntegerv(GL_VIEWPORT, viewport);
+	glEnable(GL_DEPTH_TEST);
+
+	bakeShader.use();
+	bakeShader.setInt("diffuseMap", 0);
+	//each view is orthographic and just fits the bounding sphere, so its depth is linear from the front of the sphere to the back
+	glm::mat4 projection = glm::ortho(-radius, radius, -radius, radius, radius, 3.0f * radius);
+	for (int y = 0; y < GRID; y++) {
+		for (int x = 0; x < GRID; x++) {
+			glm::vec3 direction = viewDirection(x, y);
+			//same axes as the billboard shader works out
+			glm::vec3 upHint = std::fabs(direction.y) > 0.999f ? glm::vec3(0.0f, 0.0f, -1.0f) : glm::vec3(0.0f, 1.0f, 0.0f);
+			glm::mat4 viewProjection = projection * glm::lookAt(centre + 2.0f * radius * direction, centre, upHint);
+			bakeShader.setMat4f("viewProjection", &viewProjection[0][0]);
+			glViewport(x * VIEW_SIZE, y * VIEW_SIZE, VIEW_SIZE, VIEW_SIZE);
+			scene.draw(bakeShader, 1);
+		}
+	}
+
+	glPolygonMode(GL_FRONT_AND_BACK, polygonMode[0]);
+	glViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	for (GLTexture* texture : { &albedo, &normalDepth }) {
+		glBindTexture(GL_TEXTURE_2D, texture->id());
+		glGenerateMipmap(GL_TEXTURE_2D);
+	}
+	std::cout << "Baked " << GRID * GRID << " impostor views" << std::endl;
+}
+
+bool ImpostorAtlas::readCache(const std::string& path) {
+	TRACE_FUNCTION();
+	std::ifstream file(path, std::ios::binary);
+	if (!file) {
+		return false;
+	}
+	ImpostorCacheHeader header;
+	file.read((char*)&header, sizeof(header));
+	if (!file || std::memcmp(header.magic, CACHE_MAGIC, sizeof(CACHE_MAGIC)) != 0 || header.grid != GRID || header.viewSize != VIEW_SIZE || !(header.radius > 0.0f)) {
+		std::cout << "Invalid or outdated impostor cache file: " << path << std::endl;
+		return false;
+	}
+	size_t bytes = (size_t)ATLAS_SIZE * ATLAS_SIZE * 4;
+	std::vector<unsigned char> albedoPixels(bytes), normalDepthPixels(bytes);
+	file.read((char*)albedoPixels.data(), bytes);
+	file.read((char*)normalDepthPixels.data(), bytes);
+	if (!file) {
+		std::cout << "Truncated impostor cache file: " << path << std::endl;
+		return false;
+	}
+	centre = glm::vec3(header.centre[0], header.centre[1], header.centre[2]);
+	radius = header.radius;
+	createTextures(albedoPixels.data(), normalDepthPixels.data());
+	return true;
+}
+
+bool ImpostorAtlas::writeCache(const std::string& path) {
+	std::ofstream file(path, std::ios::binary);
+	if (!file) {
+		std::cout << "Failed to write impostor cache: " << path << std::endl;
+		return false;
+	}
+	ImpostorCacheHeader header;
+	std::memcpy(header.magic, CACHE_MAGIC, sizeof(CACHE_MAGIC));
+	header.grid = GRID;
+	header.viewSize = VIEW_SIZE;
+	header.centre[0] = centre.x;
+	header.centre[1] = centre.y;
+	header.centre[2] = centre.z;
+	header.radius = radius;
+	file.write((const char*)&header, sizeof(header));
+
+	//baked once, so reading back synchronously is fine
+	std::vector<unsigned char> pixels((size_t)ATLAS_SIZE * ATLAS_SIZE * 4);
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+	glPixelStorei(GL_PACK_ALIGNMENT, 4);
+	for (GLTexture* texture : { &albedo, &normalDepth }) {
+		glBindTexture(GL_TEXTURE_2D, texture->id());
+		glGetTexImage(GL_TEXTURE_2D, 0, GL_RGBA, GL_UNSIGNED_BYTE, pixels.data());
+		file.write((const char*)pixels.data(), pixels.size());
+	}
+	return (bool)file;
+}
+
+void ImpostorAtlas::createTextures(const unsigned char* albedoPixels, const unsigned char* normalDepthPixels) {
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+	const unsigned char* pixels[] = { albedoPixels, normalDepthPixels };
+	GLTexture* textures[] = { &albedo, &normalDepth };
+	for (int i = 0; i < 2; i++) {
+		*textures[i] = GLTexture::create();
+		glBindTexture(GL_TEXTURE_2D, textures[i]->id());
+		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, ATLAS_SIZE, ATLAS_SIZE, 0, GL_RGBA, GL_UNSIGNED_BYTE, pixels[i]);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, MIP_LEVELS - 1);
+		if (pixels[i]) {
+			glGenerateMipmap(GL_TEXTURE_2D);
+		}
+		//the mips add about a third
+		textures[i]->setBytes(GPUMemoryCategory::TEXTURES, (size_t)ATLAS_SIZE * ATLAS_SIZE * 4 * 4 / 3);
+	}
+}
@@ -0,0 +1,66 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include <string>
+#include <vector>
+#include "GLResource.h"
+#include "shader.h"
+
+class Scene;
+
+//Instances far enough away (or small enough in the pixels of the layer drawing them) are drawn as a single lit billboard rather than
+//as the whole model, so their cost depends on the pixels they cover rather than their triangles. The scene is baked once into an atlas
+//of GRID x GRID orthographic views spread over the upper hemisphere (hemi-octahedral mapping), storing the albedo and coverage in one
+//texture and the model space normal and depth in another. Each billboard shows the view nearest the direction it is seen from and is
+//lit like the real geometry (diffuse only), writing the baked depth so it still intersects properly with everything else
+class ImpostorAtlas {
+public:
+	static const int GRID = 8; // views per side of the atlas
+	static const int VIEW_SIZE = 128; // pixels per side of each view
+	static const int ATLAS_SIZE = GRID * VIEW_SIZE;
+
+	//only creates the shaders, nothing is drawn until build() succeeds
+	ImpostorAtlas();
+	ImpostorAtlas(const ImpostorAtlas&) = delete;
+	ImpostorAtlas& operator=(const ImpostorAtlas&) = delete;
+
+	//loads the atlas from cachePath if it was written after sourcePath (the model file) was last modified and for the same layout,
+	//otherwise bakes it from the scene, which must be fully loaded, and writes the cache for next time. Must be called from the thread
+	//owning the context
+	bool build(Scene& scene, const std::string& sourcePath, const std::string& cachePath);
+	bool isReady() const {
+		return ready;
+	}
+
+	//model matrices of the instances select() chooses between, kept to place their bounding spheres once the atlas is built
+	void placeInstances(const glm::mat4* instanceModels, int count);
+	//splits the instances into those drawn as geometry and those drawn as impostors, for a view from camPos where something one
+	//world unit across at a distance of one unit covers pixelScale pixels. An instance becomes an impostor beyond maxDistance, or when
+	//it covers less than minPixels across. Everything is geometry until the atlas is ready
+	void select(const glm::vec3& camPos, float pixelScale, float maxDistance, float minPixels, int* geometry, int& numGeometry, int* impostors, int& numImpostors) const;
+
+	//billboard shader, which needs the same model/normalMatrix, lighting and FrameData uniforms as the main shader
+	Shader& getShader() {
+		return shader;
+	}
+	//draws the listed instances as billboards into the bound framebuffer and viewport
+	void draw(const int* instances, int count);
+
+private:
+	Shader bakeShader, shader;
+	GLTexture albedo, normalDepth;
+	GLVertexArray vao; // billboard corners come from gl_VertexID, but the core profile needs something bound
+	glm::vec3 centre = glm::vec3(0.0f);
+	float radius = 0.0f;
+	std::vector<glm::mat4> models;
+	std::vector<glm::vec4> instanceSpheres; // world space (centre, radius)
+	bool ready = false;
+
+	void bake(Scene& scene);
+	//bounding sphere of the atlas placed by each instance's model matrix
+	void placeSpheres();
+	bool readCache(const std::string& path);
+	bool writeCache(const std::string& path);
+	//(re)defines the atlas textures, with pixels (ATLAS_SIZE^2 RGBA8 each) or uninitialised to be baked into
+	void createTextures(const unsigned char* albedoPixels, const unsigned char* normalDepthPixels);
+};
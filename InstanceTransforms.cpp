@@ -0,0 +1,187 @@
+#include "InstanceTransforms.h"
+#include "ThreadPool.h"
+#include "Profiler.h"
+#include "SimdLanes.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace {
+	//storage is padded to this so every lane width reads whole batches, and parallel chunks start on a batch boundary
+	const int PADDING = 8;
+
+	//elements of a batch of matrices, element[c * 4 + r] is column c row r
+	struct Batch {
+		Lanes element[16];
+	};
+
+	inline Batch loadBatch(const std::vector<float>* elements, int first) {
+		Batch b;
+		for (int e = 0; e < 16; e++) {
+			b.element[e] = Lanes::load(elements[e].data() + first);
+		}
+		return b;
+	}
+
+	//the kernels work out whole batches into lane arrays then scatter the valid lanes out to the caller's glm types
+	void mvpRange(const std::vector<float>* elements, const glm::mat4& vp, glm::mat4* mvp, int begin, int end) {
+		Lanes vpElement[16];
+		for (int c = 0; c < 4; c++) {
+			for (int r = 0; r < 4; r++) {
+				vpElement[c * 4 + r] = Lanes::set(vp[c][r]);
+			}
+		}
+
+		float result[16][Lanes::WIDTH];
+		for (int first = begin; first < end; first += Lanes::WIDTH) {
+			Batch m = loadBatch(elements, first);
+			//(vp * m)[c][r] = sum over k of vp[k][r] * m[c][k]
+			for (int c = 0; c < 4; c++) {
+				for (int r = 0; r < 4; r++) {
+					Lanes sum = vpElement[r] * m.element[c * 4];
+					sum = madd(vpElement[4 + r], m.element[c * 4 + 1], sum);
+					sum = madd(vpElement[8 + r], m.element[c * 4 + 2], sum);
+					sum = madd(vpElement[12 + r], m.element[c * 4 + 3], sum);
+					sum.store(result[c * 4 + r]);
+				}
+			}
+
+			int lanes = std::min((int)Lanes::WIDTH, end - first);
+			for (int l = 0; l < lanes; l++) {
+				float* out = &mvp[first + l][0][0];
+				for (int e = 0; e < 16; e++) {
+					out[e] = result[e][l];
+				}
+			}
+		}
+	}
+
+	void normalRange(const std::vector<float>* elements, glm::mat3* normalMatrix, int begin, int end) {
+		float result[9][Lanes::WIDTH];
+		for (int first = begin; first < end; first += Lanes::WIDTH) {
+			Batch m = loadBatch(elements, first);
+			//columns of the upper 3x3
+			Lanes a[3][3];
+			for (int c = 0; c < 3; c++) {
+				for (int r = 0; r < 3; r++) {
+					a[c][r] = m.element[c * 4 + r];
+				}
+			}
+			//transpose(inverse(A)) is the cofactor matrix over the determinant, whose columns are the cross products of A's columns
+			Lanes cofactor[3][3];
+			for (int c = 0; c < 3; c++) {
+				const Lanes* u = a[(c + 1) % 3];
+				const Lanes* v = a[(c + 2) % 3];
+				cofactor[c][0] = u[1] * v[2] - u[2] * v[1];
+				cofactor[c][1] = u[2] * v[0] - u[0] * v[2];
+				cofactor[c][2] = u[0] * v[1] - u[1] * v[0];
+			}
+			Lanes det = a[0][0] * cofactor[0][0] + a[0][1] * cofactor[0][1] + a[0][2] * cofactor[0][2];
+			Lanes invDet = Lanes::set(1.0f) / det;
+			for (int c = 0; c < 3; c++) {
+				for (int r = 0; r < 3; r++) {
+					(cofactor[c][r] * invDet).store(result[c * 3 + r]);
+				}
+			}
+
+			int lanes = std::min((int)Lanes::WIDTH, end - first);
+			for (int l = 0; l < lanes; l++) {
+				float* out = &normalMatrix[first + l][0][0];
+				for (int e = 0; e < 9; e++) {
+					out[e] = result[e][l];
+				}
+			}
+		}
+	}
+
+	void boundsRange(const std::vector<float>* elements, const glm::vec3& localMin, const glm::vec3& localMax,
+		glm::vec3* worldMin, glm::vec3* worldMax, int begin, int end) {
+		//transform the box's centre, the world extent along each axis is the sum of the absolute matrix rows times the local extent
+		Lanes centre[3], extent[3];
+		for (int i = 0; i < 3; i++) {
+			centre[i] = Lanes::set((localMin[i] + localMax[i]) * 0.5f);
+			extent[i] = Lanes::set((localMax[i] - localMin[i]) * 0.5f);
+		}
+
+		float resultMin[3][Lanes::WIDTH], resultMax[3][Lanes::WIDTH];
+		for (int first = begin; first < end; first += Lanes::WIDTH) {
+			Batch m = loadBatch(elements, first);
+			for (int r = 0; r < 3; r++) {
+				Lanes worldCentre = m.element[12 + r];
+				Lanes worldExtent = Lanes::set(0.0f);
+				for (int c = 0; c < 3; c++) {
+					worldCentre = madd(m.element[c * 4 + r], centre[c], worldCentre);
+					worldExtent = madd(abs(m.element[c * 4 + r]), extent[c], worldExtent);
+				}
+				(worldCentre - worldExtent).store(resultMin[r]);
+				(worldCentre + worldExtent).store(resultMax[r]);
+			}
+
+			int lanes = std::min((int)Lanes::WIDTH, end - first);
+			for (int l = 0; l < lanes; l++) {
+				worldMin[first + l] = glm::vec3(resultMin[0][l], resultMin[1][l], resultMin[2][l]);
+				worldMax[first + l] = glm::vec3(resultMax[0][l], resultMax[1][l], resultMax[2][l]);
+			}
+		}
+	}
+
+	template<typename Fn>
+	void forRange(int count, ThreadPool* pool, Fn fn) {
+		if (pool && count >= InstanceStore::PARALLEL_THRESHOLD) {
+			//a few chunks per thread to even out uneven scheduling, kept a multiple of the padding so chunks start on a batch
+			int chunks = (pool->getNumThreads() + 1) * 4;
+			int grain = ((count + chunks - 1) / chunks + PADDING - 1) / PADDING * PADDING;
+			pool->parallelFor(count, grain, fn);
+		}
+		else {
+			fn(0, count);
+		}
+	}
+}
+
+int InstanceStore::add(const glm::mat4& model) {
+	if (count % PADDING == 0) {
+		for (int e = 0; e < 16; e++) {
+			elements[e].resize(count + PADDING, 0.0f);
+		}
+	}
+	set(count, model);
+	return count++;
+}
+
+void InstanceStore::set(int instance, const glm::mat4& model) {
+	for (int c = 0; c < 4; c++) {
+		for (int r = 0; r < 4; r++) {
+			elements[c * 4 + r][instance] = model[c][r];
+		}
+	}
+}
+
+glm::mat4 InstanceStore::getModel(int instance) const {
+	glm::mat4 model;
+	for (int c = 0; c < 4; c++) {
+		for (int r = 0; r < 4; r++) {
+			model[c][r] = elements[c * 4 + r][instance];
+		}
+	}
+	return model;
+}
+
+int InstanceStore::size() const {
+	return count;
+}
+
+void InstanceStore::computeMVP(const glm::mat4& viewProjection, glm::mat4* mvp, ThreadPool* pool) const {
+	TRACE_FUNCTION();
+	forRange(count, pool, [&](int begin, int end) { mvpRange(elements, viewProjection, mvp, begin, end); });
+}
+
+void InstanceStore::computeNormalMatrices(glm::mat3* normalMatrix, ThreadPool* pool) const {
+	TRACE_FUNCTION();
+	forRange(count, pool, [&](int begin, int end) { normalRange(elements, normalMatrix, begin, end); });
+}
+
+void InstanceStore::computeWorldBounds(const glm::vec3& localMin, const glm::vec3& localMax, glm::vec3* worldMin, glm::vec3* worldMax, ThreadPool* pool) const {
+	TRACE_FUNCTION();
+	forRange(count, pool, [&](int begin, int end) { boundsRange(elements, localMin, localMax, worldMin, worldMax, begin, end); });
+}
\ No newline at end of file
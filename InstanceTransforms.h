@@ -0,0 +1,33 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include <vector>
+
+class ThreadPool;
+
+//Model matrices of every instance stored structure of arrays (one array per matrix element), so the per frame transforms can be
+//done several instances at a time with SIMD (8 at once with AVX2, 4 with SSE, otherwise one at a time). Results are written
+//out as regular glm matrices ready to be uploaded
+class InstanceStore {
+public:
+	//instance counts at or above this are split across the thread pool's workers (if one is given)
+	static const int PARALLEL_THRESHOLD = 4096;
+
+	//returns the index of the new instance
+	int add(const glm::mat4& model);
+	void set(int instance, const glm::mat4& model);
+	glm::mat4 getModel(int instance) const;
+	int size() const;
+
+	//mvp[i] = viewProjection * model[i]
+	void computeMVP(const glm::mat4& viewProjection, glm::mat4* mvp, ThreadPool* pool = NULL) const;
+	//normalMatrix[i] = transpose(inverse(mat3(model[i])))
+	void computeNormalMatrices(glm::mat3* normalMatrix, ThreadPool* pool = NULL) const;
+	//world space bounding box of a model space bounding box (the same one for every instance, eg the scene's) for each instance
+	void computeWorldBounds(const glm::vec3& localMin, const glm::vec3& localMax, glm::vec3* worldMin, glm::vec3* worldMax, ThreadPool* pool = NULL) const;
+
+private:
+	//elements[c * 4 + r][i] is column c row r of instance i's model matrix, padded to a whole number of SIMD batches
+	std::vector<float> elements[16];
+	int count = 0;
+};
\ No newline at end of file
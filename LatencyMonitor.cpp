@@ -0,0 +1,129 @@
+#include "LatencyMonitor.h"
+
+#include <glad/glad.h>
+#include <GLFW/glfw3.h>
+
+#include <algorithm>
+#include <cstdio>
+
+LatencyMonitor::LatencyMonitor() {
+	for (Pending& p : pending) {
+		glGenQueries(1, &p.query);
+	}
+}
+
+LatencyMonitor::~LatencyMonitor() {
+	for (Pending& p : pending) {
+		glDeleteQueries(1, &p.query);
+	}
+}
+
+void LatencyMonitor::frameSwapped(double inputTime, double gazeTime, double fovealDrift, double axisDrift, int margin) {
+	Pending& p = pending[nextQuery];
+	if (p.issued) {
+		//waiting for it would stall the render thread, which is the latency being measured
+		unmeasured++;
+		return;
+	}
+	nextQuery = (nextQuery + 1) % NUM_QUERIES;
+
+	//reading the GPU's clock doesn't wait for the GPU to catch up, only for the driver to ask it the time
+	GLint64 gpuNow = 0;
+	glGetInteger64v(GL_TIMESTAMP, &gpuNow);
+	p.gpuToCpu = glfwGetTime() - gpuNow / 1e9;
+	glQueryCounter(p.query, GL_TIMESTAMP);
+	p.issued = true;
+	p.inputTime = inputTime;
+	p.gazeTime = gazeTime;
+
+	if (gazeTime >= 0.0) {
+		drift.add(fovealDrift, DRIFT_BIN_PIXELS);
+		if (axisDrift > margin) {
+			beyondMargin++;
+		}
+		lastMargin = margin;
+	}
+}
+
+void LatencyMonitor::update() {
+	for (Pending& p : pending) {
+		if (!p.issued) {
+			continue;
+		}
+		GLint available = 0;
+		glGetQueryObjectiv(p.query, GL_QUERY_RESULT_AVAILABLE, &available);
+		if (!available) {
+			continue;
+		}
+		GLuint64 gpuTime = 0;
+		glGetQueryObjectui64v(p.query, GL_QUERY_RESULT, &gpuTime);
+		p.issued = false;
+
+		double finished = gpuTime / 1e9 + p.gpuToCpu;
+		cameraLatency.add((finished - p.inputTime) * 1000.0, LATENCY_BIN_MS);
+		if (p.gazeTime >= 0.0) {
+			foveaLatency.add((finished - p.gazeTime) * 1000.0, LATENCY_BIN_MS);
+		}
+	}
+}
+
+void LatencyMonitor::printSummary() {
+	if (cameraLatency.count == 0) {
+		return;
+	}
+	cameraLatency.print("Camera motion-to-photon latency", "ms", LATENCY_BIN_MS);
+	if (foveaLatency.count > 0) {
+		foveaLatency.print("Fovea motion-to-photon latency", "ms", LATENCY_BIN_MS);
+	}
+	if (drift.count > 0) {
+		drift.print("Fovea movement between drawing the layers and blending", "px", DRIFT_BIN_PIXELS);
+		printf("  beyond the %d px margin on %d of %d frames\n", lastMargin, beyondMargin, drift.count);
+	}
+	if (unmeasured > 0) {
+		printf("  %d frames not measured (every latency query still pending)\n", unmeasured);
+	}
+	cameraLatency = Histogram();
+	foveaLatency = Histogram();
+	drift = Histogram();
+	beyondMargin = 0;
+	unmeasured = 0;
+}
+
+void LatencyMonitor::Histogram::add(double value, double binWidth) {
+	int bin = std::min(std::max((int)(value / binWidth), 0), NUM_BINS - 1);
+	bins[bin]++;
+	max = count == 0 ? value : std::max(max, value);
+	count++;
+}
+
+double LatencyMonitor::Histogram::percentile(double p, double binWidth) const {
+	int target = std::max(1, (int)(p * count + 0.5));
+	int seen = 0;
+	for (int i = 0; i < NUM_BINS; i++) {
+		seen += bins[i];
+		if (seen >= target) {
+			//the overflow bin has no upper edge
+			return i == NUM_BINS - 1 ? max : (i + 1) * binWidth;
+		}
+	}
+	return max;
+}
+
+void LatencyMonitor::Histogram::print(const char* name, const char* unit, double binWidth) const {
+	printf("%s over %d frames: p50 %.1f %s, p95 %.1f %s, p99 %.1f %s, max %.1f %s\n", name, count,
+		percentile(0.5, binWidth), unit, percentile(0.95, binWidth), unit, percentile(0.99, binWidth), unit, max, unit);
+	//only the bins that have anything in them, as [lower, upper): frames
+	printf(" ");
+	for (int i = 0; i < NUM_BINS; i++) {
+		if (bins[i] == 0) {
+			continue;
+		}
+		if (i == NUM_BINS - 1) {
+			printf(" [%g+): %d", i * binWidth, bins[i]);
+		}
+		else {
+			printf(" [%g, %g): %d", i * binWidth, (i + 1) * binWidth, bins[i]);
+		}
+	}
+	printf("\n");
+}
@@ -0,0 +1,53 @@
+#pragma once
+
+//Motion-to-photon latency of the frames drawn, from the timestamps of the input (camera) and gaze samples each frame was drawn with
+//to when the GPU finished the frame. A timestamp query issued straight after the swap marks the finish without stalling, its GPU time
+//is converted to glfwGetTime()'s clock with the offset between the two clocks when it was issued, and it is read back frames later.
+//Histograms are accumulated between printSummary() calls, along with how far the fovea moved between the eccentricity layers being
+//drawn around it and the blend latching it, which is what the layers' margin has to cover. Render thread only
+class LatencyMonitor {
+public:
+	static const int NUM_QUERIES = 8; // frames in flight, frames swapped while every query is still pending aren't measured
+	static const int NUM_BINS = 50; // the last bin of each histogram also counts everything beyond it
+	static constexpr double LATENCY_BIN_MS = 2.0;
+	static constexpr double DRIFT_BIN_PIXELS = 8.0;
+
+	LatencyMonitor();
+	~LatencyMonitor();
+	LatencyMonitor(const LatencyMonitor&) = delete;
+	LatencyMonitor& operator=(const LatencyMonitor&) = delete;
+
+	//call straight after glfwSwapBuffers. gazeTime is when the fovea the blend used was sampled, negative for frames drawn without
+	//one. drift is how far (in pixels) the fovea moved between the layers being drawn and the blend, before clamping to margin.
+	//axisDrift is the larger of its horizontal and vertical components, the margin clamps each axis on its own
+	void frameSwapped(double inputTime, double gazeTime, double drift, double axisDrift, int margin);
+	//once a frame: reads back the queries that have finished
+	void update();
+	//histograms of the frames measured since the last call
+	void printSummary();
+
+private:
+	struct Histogram {
+		int bins[NUM_BINS] = {};
+		int count = 0;
+		double max = 0.0;
+
+		void add(double value, double binWidth);
+		//upper edge of the bin containing the pth percentile
+		double percentile(double p, double binWidth) const;
+		void print(const char* name, const char* unit, double binWidth) const;
+	};
+	struct Pending {
+		unsigned int query = 0;
+		bool issued = false;
+		double inputTime, gazeTime;
+		double gpuToCpu; // seconds added to a GPU timestamp to put it on glfwGetTime()'s clock
+	};
+
+	Pending pending[NUM_QUERIES];
+	int nextQuery = 0;
+	int unmeasured = 0;
+	Histogram cameraLatency, foveaLatency, drift;
+	int beyondMargin = 0; // frames whose fovea moved further than the margin, so the blend was clamped short of it
+	int lastMargin = 0;
+};
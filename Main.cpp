@@ -5,17 +5,49 @@
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/glm.hpp>
 
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstring>
 #include <iostream>
+#include <limits>
+#include <memory>
 #include <string>
+#include <thread>
 #include <vector>
 #include "shader.h"
 #include "FlyCamera.h"
+#include "CameraPath.h"
+#include "FoveationConfig.h"
+#include "FoveationTuner.h"
+#include "FrameCapture.h"
+#include "LatencyMonitor.h"
 #include "Mesh.h"
 #include "Scene.h"
+#include "ShadowMaps.h"
+#include "FrameGraph.h"
+#include "Impostor.h"
+#include "OcclusionQueries.h"
+#include "InstanceTransforms.h"
+#include "StereoView.h"
+#include "StreamBuffer.h"
+#include "SoftwareRasterizer.h"
+#include "TiledBlend.h"
+#include "TripleBuffer.h"
+#include "GLResource.h"
+#include "Profiler.h"
 #include "stb_image.h"
+#include "stb_image_write.h"
 
 //REMEMBER TO CHANGE IN FRAGMENT SHADER TOO WHEN ALTERING NUMBER OF POINT LIGHT SOURCES
 #define NUM_LIGHTS 10
+//attenuation coefficients of every point light
+#define POINT_LIGHT_CONSTANT 1.0f
+#define POINT_LIGHT_LINEAR 0.22f
+#define POINT_LIGHT_QUADRATIC 0.20f
+
+#define SCENE_PATH "Resources\\buildings\\buildings.obj"
 
 //REMEMBER TO ALTER BLENDING FRAGMENT SHADER TOO WHEN ALTERING NUMBER OF LAYERS
 #define NUM_LAYERS 3
@@ -26,26 +58,267 @@
 //THIS SHOULD BE AVOIDED - slows renderer down by syncing GPU and CPU with glFinish() calls, but provides ms/draw call timings
 //#define DRAW_TIMING
 
+//Per pass GPU timings for the foveated path (printed alongside ms/frame) using timer queries, results are read back a few frames
+//late so unlike DRAW_TIMING this doesn't stall the CPU
+#define PASS_TIMING
+
 //MSAA samples, remove definition entirely to disable MSAA
+//(used for the window's framebuffer, the eccentricity layers use the per layer counts in SAMPLE_PRESETS)
 #define SAMPLES 4
 
-bool FOVEATION_ENABLED = true;
+//Resolve the multisampled eccentricity layers inside the blending shader (texelFetch on the multisample textures) rather than
+//blitting each layer into an intermediate framebuffer first, remove definition to go back to blitting. Only used if SAMPLES is defined
+#define FUSED_RESOLVE
+
+//Stream the scene in on background threads instead of blocking until it is loaded, uploading at most UPLOAD_BUDGET bytes of
+//mesh/texture data per frame so loading doesn't cause frame time spikes
+#define ASYNC_LOADING
+#define UPLOAD_BUDGET (4 * 1024 * 1024)
+
+//Rendering method, LEFT_SHIFT cycles between them so that they can be compared on equal terms
+enum class RenderMode {
+	FULL_RESOLUTION, // the whole scene at full resolution straight into the window's framebuffer
+	LAYERED, // nested rectangular eccentricity layers blended together (see build_foveation_graph)
+	LOG_POLAR, // kernel log-polar foveated rendering, shaded once in a log-polar buffer (see build_log_polar_graph)
+	STEREO, // layered foveation for both eyes of a head mounted display, side by side in the window (see build_stereo_graph)
+	NUM_MODES
+};
+RenderMode RENDER_MODE = RenderMode::LAYERED;
+
+//Log-polar mode parameters. The log-polar buffer is WIDTH/LOG_POLAR_SIGMA x HEIGHT/LOG_POLAR_SIGMA, and LOG_POLAR_ALPHA is the
+//exponent of the kernel function K(u) = u^alpha which controls how quickly sample density falls off with eccentricity (1 is a plain
+//log-polar mapping, larger values keep more samples near the fovea). J/K decrease/increase alpha at runtime
+float LOG_POLAR_SIGMA = 1.8f;
+float LOG_POLAR_ALPHA = 4.0f;
 bool UPDATE_PROJECTION = false;
+bool WIREFRAME = false;
+
+#ifdef SAMPLES
+//Per layer MSAA sample counts for the eccentricity framebuffers, index 0 is the base (periphery) layer and the highest index is
+//the fovea. Pressing M cycles between presets at runtime, counts are clamped to what the driver supports when the framebuffers are created
+//REMEMBER TO KEEP THE NUMBER OF ENTRIES IN EACH PRESET THE SAME AS NUM_LAYERS
+#define NUM_SAMPLE_PRESETS 3
+int SAMPLE_PRESETS[NUM_SAMPLE_PRESETS][NUM_LAYERS] = {
+	{ 1, 4, 8 }, // antialiasing cost where the eye can actually see it
+	{ 1, 2, 4 },
+	{ SAMPLES, SAMPLES, SAMPLES }, // uniform, same as using SAMPLES everywhere
+};
+int SAMPLE_PRESET = 0;
+#endif
+
+//Per layer shading level of detail, index 0 is the base (periphery) layer. Peripheral vision can't resolve specular highlights
+//or fine texture detail, so outer layers are drawn with cheaper variants of the main shader (compiled from the same source with
+//different defines, see fragmentShader.gl). Soft shadow edges are just as invisible there, so they also filter their shadow maps
+//less. Pressing L toggles between these and full quality shading in every layer
+//REMEMBER TO KEEP THE NUMBER OF ENTRIES THE SAME AS NUM_LAYERS
+struct LayerShading {
+	int numLights; // only the numLights point lights nearest the camera are shaded (NUM_LIGHTS for all of them)
+	float lightRange; // point lights further than this from a fragment are skipped, 0 to disable range culling
+	bool specular; // false for diffuse only shading
+	float textureLodBias; // added to the mip level used for the diffuse/specular maps
+	int shadowFilter; // radius in texels of the shadow map's percentage closer filter, 2 is full quality
+};
+LayerShading LAYER_SHADING[NUM_LAYERS] = {
+	{ 4, 3.0f, false, 1.0f, 0 },
+	{ NUM_LIGHTS, 4.0f, true, 0.5f, 1 },
+	{ NUM_LIGHTS, 0.0f, true, 0.0f, 2 }, // fovea should always be full quality
+};
+bool SHADING_LOD_ENABLED = true;
+
+//The global light casts shadows in the layered mode, from one shadow map per eccentricity layer fitted to just the part of the view
+//that layer covers (out to SHADOW_DISTANCE), see ShadowMaps. The fovea's small frustum gets a dense map redrawn every frame the
+//view changes, peripheral layers get coarse maps redrawn every few frames (any map out of date is redrawn as soon as the view stops
+//changing). Each layer's map is a separate pass, so PASS_TIMING shows what each costs. H toggles shadows
+//REMEMBER TO KEEP THE NUMBER OF ENTRIES THE SAME AS NUM_LAYERS
+struct LayerShadows {
+	int resolution; // texels per side of the map
+	int interval; // frames between redraws while the view is changing
+};
+LayerShadows LAYER_SHADOWS[NUM_LAYERS] = {
+	{ 512, 4 },
+	{ 1024, 2 },
+	{ 2048, 1 },
+};
+#define SHADOW_DISTANCE 12.0f
+#define SHADOW_CASTER_DEPTH 10.0f // how far towards the light outside the view shadow casters are still drawn
+#define SHADOW_TEXTURE_UNIT 2 // units 0 and 1 are the material's maps (see Mesh::draw)
+bool SHADOWS = true;
+
+//Instances hidden behind others are skipped with hardware occlusion queries (see OcclusionQueries). Once the base layer is drawn,
+//every instance's bounding box is tested against its depth. The inner layers, and the next frame's base layer, then only draw the
+//instances whose box was visible, without the CPU ever reading a result back. Layered mode only, Q toggles it
+bool OCCLUSION_CULLING = true;
+
+//The layered blend is drawn as screen tiles sorted by which layers reach them (see TiledBlend), so most of the screen is a copy of
+//one layer rather than the full blending shader. B toggles back to the single full screen quad for comparison
+bool TILED_BLEND = true;
+static_assert(NUM_LAYERS <= TiledBlend::MAX_LAYERS, "the tiled blend has no room for that many layers");
+
+//Instances further than IMPOSTOR_DISTANCE from the camera, or less than IMPOSTOR_MIN_PIXELS across in the pixels of the eccentricity
+//layer drawing them, are drawn as lit billboards from an atlas baked from the scene once it has loaded (and cached next to the model,
+//see ImpostorAtlas). The size is measured at each layer's own resolution, so the low resolution outer layers switch much sooner than
+//the fovea. Layered mode only, I toggles them
+#define IMPOSTOR_DISTANCE 4.0f
+#define IMPOSTOR_MIN_PIXELS 48.0f
+bool IMPOSTORS = true;
+
+//Textures are mipmapped (and BC1/BC3 compressed if the driver supports S3TC) once, then loaded from a .ktx cache file next to
+//the source image on later runs. Anisotropic filtering is clamped to the driver's maximum, 1 disables it
+bool COOK_TEXTURES = true;
+float TEXTURE_ANISOTROPY = 8.0f;
+
+//Layout of the eccentricity layers (sizes, resolutions and how many of the NUM_LAYERS are used) is read from this file at startup
+//if it exists, otherwise the hand-picked layout in FoveationConfig::defaults() is used. The file is written by the autotuner, run
+//with --tune <camera path> [output config]: every layout in FoveationTuner::candidateGrid is drawn over the recorded camera path in
+//a hidden window and the fastest layout on the Pareto front with an average PSNR (against full resolution) of at least
+//TUNING_MIN_PSNR is deployed
+const char* FOVEATION_CONFIG_PATH = "foveation.cfg";
+#define TUNING_MIN_PSNR 35.0
+
+//C starts recording the camera path (at most one pose every CAMERA_PATH_INTERVAL seconds) and pressing it again writes it to
+//CAMERA_PATH_FILE, for playback by the autotuner
+#define CAMERA_PATH_FILE "camera_path.txt"
+#define CAMERA_PATH_INTERVAL (1.0 / 60.0)
+bool RECORDING_CAMERA_PATH = false;
+CameraPath CAMERA_PATH;
+
+//E toggles quality evaluation: every EVALUATION_INTERVAL frames the render thread also draws the frame at full resolution offscreen
+//and the pair are compared on worker threads (eccentricity weighted PSNR/SSIM, printed with the frame timings). X saves the next
+//frame, its eccentricity layers and its full resolution reference to the captures directory as PNG and EXR. See FrameCapture
+#define EVALUATION_INTERVAL 10
+#define CAPTURE_WORKERS 2
+bool EVALUATE_QUALITY = false;
+int CAPTURE_REQUESTS = 0;
+
+//A frame whose snapshot would draw the same image as the last frame drawn (camera, instances, lights and settings unchanged, nothing
+//newly streamed in) isn't drawn or presented at all, the window keeps showing the last one. When only the shading level of detail
+//changed, eccentricity layers that come out the same either way keep their contents from the last frame and only the blend is redone.
+//R toggles this, off redraws everything every frame for benchmarking
+bool LAZY_REDRAW = true;
 double DELTA_T = 0.0;
 int WIDTH = 0, HEIGHT = 0;
 
-int main();
+//Stereo mode draws the eyes STEREO_IPD (world units) apart, side by side in the window so it can be checked without a headset.
+//Each eye's inner layers are centred on its gaze point, STEREO_GAZE in the eye's normalised device coordinates (the centre of its
+//view until gaze tracking feeds it). With SHARED_PERIPHERY the base layer is drawn once from between the eyes and used by both,
+//at its resolution the disparity between them is barely a texel for anything but the nearest geometry
+#define STEREO_IPD 0.064f
+glm::vec2 STEREO_GAZE[2] = { glm::vec2(0.0f), glm::vec2(0.0f) };
+bool SHARED_PERIPHERY = true;
+
+//Layered mode centres the inner eccentricity layers on the fovea, sampled every simulation tick: the centre of the screen, or with V
+//a simulated scan path of fixations and saccades standing in for a gaze tracker. Layers are drawn around the fovea of the frame's
+//snapshot, but the blend pass latches the newest sample just before it is submitted, so the inner layers are drawn FOVEA_MARGIN pixels
+//larger all round and the blended fovea can be up to that far from where they were drawn ([ and ] change it). Latency from the input
+//and gaze samples to the GPU finishing the frame is printed as histograms with the frame timings (see LatencyMonitor), along with
+//how far the fovea moved in between, to tune the margin against
+int FOVEA_MARGIN = 48;
+#define FOVEA_MARGIN_STEP 16
+#define MAX_FOVEA_MARGIN 256
+bool SIMULATED_GAZE = false;
+#define FIXATION_TIME 0.3 // seconds between simulated saccades
+#define SACCADE_TIME 0.04 // seconds each simulated saccade takes
+
+//--cpu [camera path] draws with the SoftwareRasterizer instead of openGL, for machines without a GPU. Every pose of the camera path
+//(or just the starting camera) is drawn at CPU_WIDTH x CPU_HEIGHT at full resolution and with the foveation layout, the average
+//time and pixels shaded by each are printed and the last frame of both is written to cpu_full.png and cpu_foveated.png
+#define CPU_WIDTH 1920
+#define CPU_HEIGHT 1080
+
+//How often (in seconds) the simulation thread samples input and publishes a new frame snapshot, independent of the frame rate
+#define SIMULATION_INTERVAL 0.001
+
+//Everything the render thread needs to draw a frame that can change from frame to frame, produced by the simulation thread
+//(the globals above are only touched by the main/simulation thread, the render thread only ever reads snapshots)
+struct FrameSnapshot {
+	double inputTime = 0.0; // glfwGetTime() when the input this snapshot is based on was sampled
+	glm::mat4 view = glm::mat4(1.0f);
+	glm::mat4 projection = glm::mat4(1.0f);
+	glm::mat4 VP = glm::mat4(1.0f);
+	glm::mat4 MVP[INSTANCES];
+	glm::vec3 camPos = glm::vec3(0.0f);
+	glm::mat4 eyeVP[2]; // stereo mode's eyes, see computeStereoEyes
+	glm::mat4 centreVP = glm::mat4(1.0f);
+	glm::vec2 gaze[2];
+	glm::vec2 fovea = glm::vec2(0.0f); // layered mode's fovea in normalised device coordinates, the inner layers are drawn around it
+	int foveaMargin = 0;
+	int lightOrder[NUM_LIGHTS] = {}; // point lights sorted by distance to the camera
+
+	RenderMode renderMode = RenderMode::LAYERED;
+	bool wireframe = false;
+	bool shadingLod = true;
+	bool tiledBlend = true;
+	bool impostors = true;
+	bool shadows = true;
+	bool occlusionCulling = true;
+	float logPolarAlpha = 4.0f;
+	int samplePreset = 0;
+	bool evaluateQuality = false;
+	int captureRequests = 0; // a frame is saved whenever this changes
+	bool lazyRedraw = true;
+};
+
+//std140 layout of the FrameData uniform block, which the render thread writes into a StreamBuffer every frame rather than setting
+//the matrices and camera position on every shader with glUniform* calls
+//REMEMBER TO KEEP THIS CONSISTENT WITH THE SHADERS
+struct FrameUniforms {
+	glm::mat4 MVP[INSTANCES];
+	glm::mat4 VP;
+	glm::mat4 eyeVP[2];
+	glm::mat4 centreVP;
+	glm::vec3 camPos;
+	float padding;
+};
+#define FRAME_UNIFORM_BINDING 0
+
+//what the render loop needs to know about each eccentricity layer of the foveation graph
+struct FoveationLayer {
+	int samples; // actually allocated by the driver, see build_foveation_graph
+	int output; // graph resource the layer is blended from, for capturing the layers
+	std::vector<int> passes; // the layer's draw (and resolve) passes, skipped while it can be reused from an earlier frame
+	int shadowPass = -1; // draws the layer's shadow map, skipped unless the map is due to be redrawn
+};
+
+//a gaze sample, published by the simulation thread every tick
+struct GazeSample {
+	glm::vec2 position = glm::vec2(0.0f); // normalised device coordinates
+	double time = 0.0; // glfwGetTime() when it was sampled
+};
+
+//the fovea the layered mode's blend pass actually used, latched from the newest gaze sample right before the pass is submitted
+struct FoveaLatch {
+	TripleBuffer<GazeSample>* samples = NULL; // NULL to always use the snapshot's fovea, eg while autotuning
+	GazeSample latched;
+	float drift = 0.0f; // pixels from the snapshot's fovea to the newest sample, before clamping to the margin
+	float axisDrift = 0.0f; // the larger of its horizontal and vertical pixels, which is what the margin clamps
+};
+
+int main(int argc, char** argv);
+int run_software_renderer(const char* cameraPathFile);
 
 //function declarations
 //void framebuffer_size_callback_function(GLFWwindow*, int, int); - not necessary, using fixed size fullscreen window
 void key_callback(GLFWwindow* window, int key, int scancode, int action, int mods);
 void mouse_callback(GLFWwindow* window, double xpos, double ypos);
-#ifdef SAMPLES
-void generate_multisample_eccentricity_framebuffer(unsigned int* framebuffer, int width, int height, int samples);
-void generate_intermediate_framebuffer(unsigned int* framebuffer, unsigned int* texture, int width, int height);
-#else
-void generate_eccentricity_framebuffer(unsigned int* framebuffer, unsigned int* texture, int width, int height);
-#endif
+void build_foveation_graph(FrameGraph& graph, Scene& scene, Shader& renderingShader, Shader** layerShaders, Shader& blendingShader, TiledBlend& tiledBlend, ImpostorAtlas& impostors, ShadowMaps& shadows, OcclusionQueries& occlusion, int* resolutions, int* sizes, int numLayers, unsigned int quadVAO, const FrameSnapshot& frame, FoveaLatch& latch, FoveationLayer* layers);
+void set_blending_layers(Shader& blendingShader, TiledBlend& tiledBlend, const FoveationLayer* layers, int numLayers);
+ShadowMaps::View shadow_view(const FrameSnapshot& frame, const int* sizes, int layer);
+void set_shadow_layers(ShadowMaps& shadows, int numLayers);
+void draw_reference(Scene& scene, Shader& mainShader, ShadowMaps& shadows, const FrameSnapshot& frame, int numLayers);
+TiledBlend::Layout blending_layout(const int* sizes, int numLayers, glm::vec2 drawnCentre, glm::vec2 fovea, int margin);
+void set_blending_fovea(Shader& blendingShader, const TiledBlend::Layout& layout);
+void add_fovea_margin(const int* sizes, const int* resolutions, int numLayers, int margin, int* drawnSizes, int* drawnResolutions);
+void latch_fovea(FoveaLatch& latch, const FrameSnapshot& frame);
+glm::vec2 simulated_gaze(double time);
+void build_stereo_graph(FrameGraph& graph, Scene& scene, Shader& renderingShader, Shader** layerShaders, Shader& blendingShader, int* resolutions, int* sizes, int numLayers, unsigned int quadVAO, const FrameSnapshot& frame, const int& visibleInstances, FoveationLayer* layers);
+void set_stereo_blending(Shader& blendingShader, const int* sizes, int numLayers);
+int max_layer_samples();
+int layer_slot(int layer, int numLayers);
+bool same_view(const FrameSnapshot& a, const FrameSnapshot& b);
+void build_log_polar_graph(FrameGraph& graph, Scene& scene, Shader& gBufferShader, Shader& logPolarShader, Shader& inverseLogPolarShader, unsigned int quadVAO, const FrameSnapshot& frame);
+bool is_full_shading(const LayerShading& shading);
+std::vector<std::string> shading_defines(const LayerShading& shading);
+void set_point_lights(const Shader& shader, const glm::vec3* pointLightPosCol, const int* lightOrder, int numLights, float constant, float linear, float quadratic);
 
 glm::vec3 getColour(int i) {
 	switch (i%6) {
@@ -74,6 +347,28 @@ glm::vec3 randomColour() {
 	return glm::vec3((float)std::rand() / RAND_MAX, (float)std::rand() / RAND_MAX, (float)std::rand() / RAND_MAX);
 }
 
+//positions (even entries) and colours (odd entries) of the NUM_LIGHTS point lights
+void make_point_lights(glm::vec3* pointLightPosCol) {
+	for (int i = 0; i < NUM_LIGHTS; i++) {
+		//CITYSCAPE (ellipse) POSITIONS:
+		float angle = glm::radians((float)(360 * i) / NUM_LIGHTS);
+		pointLightPosCol[2*i] = glm::vec3(sin(angle) * 2.5f, 1.5f, cos(angle) * 3.5f);
+
+		//colours:
+		//pointLightPosCol[2 * i + 1] = getColour(i);
+		pointLightPosCol[2 * i + 1] = randomColour();
+		//pointLightPosCol[2 * i + 1] = glm::vec3(1.0f);
+	}
+}
+
+void add_scene_instances(InstanceStore& instances) {
+	for (int i = 0; i < INSTANCES; i++) {
+		//FOR CITYSCAPE:
+		glm::mat4 m = glm::mat4(1.0f);
+		instances.add(glm::scale(glm::translate(m, glm::vec3((i % 4 - 2.0f) * 0.5f, 0.0f, (-i + INSTANCES / 2.0f) * 0.3f)), glm::vec3(0.001f)));
+	}
+}
+
 //Default cam
 //FlyCamera cam(glm::vec3(0.0f, 0.0f, 3.0f));
 
@@ -87,11 +382,25 @@ glm::vec3 randomColour() {
 FlyCamera cam(glm::vec3(-3.000140, 1.453398, -2.767532), -670.001526, -20.000036, 31.015045);
 
 
-int main() {
+int main(int argc, char** argv) {
+	//--tune <camera path> [output config] runs the autotuner instead of the interactive renderer
+	const char* tuneCameraPath = NULL;
+	const char* tuneOutputPath = FOVEATION_CONFIG_PATH;
+	if (argc >= 3 && std::string(argv[1]) == "--tune") {
+		tuneCameraPath = argv[2];
+		if (argc >= 4) {
+			tuneOutputPath = argv[3];
+		}
+	}
+
 	// ---------- INITIALISATION  ----------
 	stbi_set_flip_vertically_on_load(true);
 	std::srand(1);
 
+	if (argc >= 2 && std::string(argv[1]) == "--cpu") {
+		return run_software_renderer(argc >= 3 ? argv[2] : NULL);
+	}
+
 	//initalise glfw
 	if (!glfwInit()) {
 		std::cout << "Error initalising glfw" << std::endl;
@@ -117,8 +426,11 @@ int main() {
 	glfwWindowHint(GLFW_BLUE_BITS, mode->blueBits);
 	glfwWindowHint(GLFW_REFRESH_RATE, mode->refreshRate);
 
-	//Create the window and check success
-	GLFWwindow* window = glfwCreateWindow(mode->width, mode->height, "Foveated Rendering", monitors[count - 1], NULL);
+	//Create the window and check success. The autotuner renders at the monitor's resolution too, but in a window that is never shown
+	if (tuneCameraPath) {
+		glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+	}
+	GLFWwindow* window = glfwCreateWindow(mode->width, mode->height, "Foveated Rendering", tuneCameraPath ? NULL : monitors[count - 1], NULL);
 	if (window == NULL) {
 		std::cout << "Error creating glfw window" << std::endl;
 		glfwTerminate();
@@ -143,15 +455,97 @@ int main() {
 		return -1;
 	}
 
+	//linked programs are cached on disk, and every shader below is created before any is used so the driver can compile them
+	//in parallel (see Shader::use)
+	Shader::enableProgramCache("shadercache");
+
 	Shader mainShader("vertexShader.gl", "fragmentShader.gl");
 	Shader lightShader("lightVertexShader.gl", "lightFragmentShader.gl");
+
+	//level of detail variants of mainShader used by the eccentricity layers (layers with full quality shading just use mainShader),
+	//these all need the same uniforms as mainShader so are kept together in litShaders
+	Shader* layerShaders[NUM_LAYERS];
+	std::vector<Shader> shadingVariants;
+	shadingVariants.reserve(NUM_LAYERS); // pointers into this are kept, so it must never reallocate
+	std::vector<Shader*> litShaders = { &mainShader };
+	for (int i = 0; i < NUM_LAYERS; i++) {
+		if (is_full_shading(LAYER_SHADING[i])) {
+			layerShaders[i] = &mainShader;
+		}
+		else {
+			shadingVariants.push_back(Shader("vertexShader.gl", "fragmentShader.gl", shading_defines(LAYER_SHADING[i])));
+			layerShaders[i] = &shadingVariants.back();
+			litShaders.push_back(layerShaders[i]);
+		}
+	}
+
+	//log-polar mode splits mainShader's work between a G-buffer pass (needs the scene/instance uniforms) and a shading pass at
+	//log-polar resolution (needs the lighting uniforms)
+	Shader gBufferShader("vertexShader.gl", "gBufferFragmentShader.gl");
+	Shader logPolarShader("blendingVertexShader.gl", "logPolarFragmentShader.gl");
+	Shader inverseLogPolarShader("blendingVertexShader.gl", "inverseLogPolarFragmentShader.gl");
+#if defined(SAMPLES) && defined(FUSED_RESOLVE)
+	Shader blendingShader("blendingVertexShader.gl", "blendingMultisampleFragmentShader.gl");
+	TiledBlend tiledBlend("blendingMultisampleFragmentShader.gl", true);
+#else
+	Shader blendingShader("blendingVertexShader.gl", "blendingFragmentShader.gl");
+	TiledBlend tiledBlend("blendingFragmentShader.gl", false);
+#endif
+	//stereo variants of the layer shaders, which get the eye matrices rather than MVPs every frame (see vertexShader.gl)
+	Shader stereoShader("vertexShader.gl", "fragmentShader.gl", { "STEREO" });
+	Shader* stereoLayerShaders[NUM_LAYERS];
+	std::vector<Shader> stereoVariants;
+	stereoVariants.reserve(NUM_LAYERS);
+	std::vector<Shader*> stereoShaders = { &stereoShader };
+	for (int i = 0; i < NUM_LAYERS; i++) {
+		if (layerShaders[i] == &mainShader) {
+			stereoLayerShaders[i] = &stereoShader;
+		}
+		else {
+			std::vector<std::string> defines = shading_defines(LAYER_SHADING[i]);
+			defines.push_back("STEREO");
+			stereoVariants.push_back(Shader("vertexShader.gl", "fragmentShader.gl", defines));
+			stereoLayerShaders[i] = &stereoVariants.back();
+			stereoShaders.push_back(stereoLayerShaders[i]);
+		}
+	}
+	Shader stereoBlendingShader("blendingVertexShader.gl", "stereoBlendingFragmentShader.gl");
+	ImpostorAtlas impostors;
+	ShadowMaps shadows(SHADOW_DISTANCE, SHADOW_CASTER_DEPTH);
+	OcclusionQueries occlusion(INSTANCES, 0.1f); // same near plane as every projection here
+
+	std::vector<Shader*> sceneShaders = litShaders;
+	sceneShaders.push_back(&gBufferShader);
+	litShaders.push_back(&logPolarShader);
+	litShaders.insert(litShaders.end(), stereoShaders.begin(), stereoShaders.end());
+	//everything drawing the scene, stereo shaders included
+	std::vector<Shader*> instancedShaders = sceneShaders;
+	instancedShaders.insert(instancedShaders.end(), stereoShaders.begin(), stereoShaders.end());
+	//the billboards are placed and lit like the instances they stand in for
+	litShaders.push_back(&impostors.getShader());
+	instancedShaders.push_back(&impostors.getShader());
+	instancedShaders.push_back(&shadows.getShader());
+	instancedShaders.push_back(&occlusion.getShader());
 	
-	mainShader.use();
-	//binding textures to uniforms, see Mesh::draw()
-	mainShader.setInt("diffuseMap", 0); //GL_TEXTURE0
-	mainShader.setInt("specularMap", 1); //GL_TEXTURE1
+	for (Shader* shader : instancedShaders) {
+		shader->use();
+		//binding textures to uniforms, see Mesh::draw()
+		shader->setInt("diffuseMap", 0); //GL_TEXTURE0
+		shader->setInt("specularMap", 1); //GL_TEXTURE1
+		//never read unless shadows are enabled, but can't share a unit with the material's maps as it is a different sampler type
+		shader->setInt("shadowMap", SHADOW_TEXTURE_UNIT);
+	}
 
-	Scene scene("Resources\\buildings\\buildings.obj");
+#ifdef ASYNC_LOADING
+	//meshes and textures are loaded by background threads and uploaded a little each frame, so rendering starts straight away
+	bool asyncLoading = true;
+#else
+	bool asyncLoading = false;
+#endif
+	if (tuneCameraPath) {
+		asyncLoading = false; // every tuning frame has to be complete
+	}
+	Scene scene(SCENE_PATH, asyncLoading);
 
 	// ----------- LIGHTING -----------
 	//global illumination
@@ -160,95 +554,81 @@ int main() {
 	glm::vec3 globalLightDir(0.0f, -1.0f, 0.5f); // CITYSCAPE lighting
 	glm::vec3 globalLightCol(1.0f, 1.0f, 1.0f);
 	
-	mainShader.setVec3f("globalLight.direction", globalLightDir);
-	//DEFAULT LIGHTING:
-	//mainShader.setVec3f("globalLight.ambient", globalLightCol * 0.2f);
-	//mainShader.setVec3f("globalLight.diffuse", globalLightCol * 0.7f);
-	//mainShader.setVec3f("globalLight.specular", globalLightCol * 1.0f);
-	//CITYSCAPE LIGHTING:
-	mainShader.setVec3f("globalLight.ambient", globalLightCol * 0.0f);
-	mainShader.setVec3f("globalLight.diffuse", globalLightCol * 0.2f);
-	mainShader.setVec3f("globalLight.specular", globalLightCol * 1.0f);
+	for (Shader* shader : litShaders) {
+		shader->use();
+		shader->setVec3f("globalLight.direction", globalLightDir);
+		//DEFAULT LIGHTING:
+		//shader->setVec3f("globalLight.ambient", globalLightCol * 0.2f);
+		//shader->setVec3f("globalLight.diffuse", globalLightCol * 0.7f);
+		//shader->setVec3f("globalLight.specular", globalLightCol * 1.0f);
+		//CITYSCAPE LIGHTING:
+		shader->setVec3f("globalLight.ambient", globalLightCol * 0.0f);
+		shader->setVec3f("globalLight.diffuse", globalLightCol * 0.2f);
+		shader->setVec3f("globalLight.specular", globalLightCol * 1.0f);
+	}
+	shadows.setLightDirection(globalLightDir);
 
 	//point lights
 	glm::vec3 pointLightPosCol[NUM_LIGHTS*2];
-	for (int i = 0; i < NUM_LIGHTS; i++) {
-		//CITYSCAPE (ellipse) POSITIONS:
-		float angle = glm::radians((float)(360 * i) / NUM_LIGHTS);
-		pointLightPosCol[2*i] = glm::vec3(sin(angle) * 2.5f, 1.5f, cos(angle) * 3.5f);
-
-		//colours:
-		//pointLightPosCol[2 * i + 1] = getColour(i);
-		pointLightPosCol[2 * i + 1] = randomColour();
-		//pointLightPosCol[2 * i + 1] = glm::vec3(1.0f);
-	}
+	make_point_lights(pointLightPosCol);
 	//attenuation coefficients
-	float pointLightConstant = 1.0f;
-	float pointLightLinear = 0.22f;
-	float pointLightQuadratic = 0.20f;
+	float pointLightConstant = POINT_LIGHT_CONSTANT;
+	float pointLightLinear = POINT_LIGHT_LINEAR;
+	float pointLightQuadratic = POINT_LIGHT_QUADRATIC;
 
 
+	//shaders shading every light get them all once here, variants only shading the nearest few have theirs set every frame
+	int allLights[NUM_LIGHTS];
 	for (int i = 0; i < NUM_LIGHTS; i++) {
-		mainShader.setVec3f(("lights[" + std::to_string(i) + "].pos").c_str(), pointLightPosCol[2 * i]);
-		mainShader.setVec3f(("lights[" + std::to_string(i) + "].diffuse").c_str(), pointLightPosCol[2*i + 1] * 1.0f);
-		mainShader.setVec3f(("lights[" + std::to_string(i) + "].specular").c_str(), pointLightPosCol[2*i + 1] * 1.0f);
-		mainShader.setFloat(("lights[" + std::to_string(i) + "].constant").c_str(), pointLightConstant);
-		mainShader.setFloat(("lights[" + std::to_string(i) + "].linear").c_str(), pointLightLinear);
-		mainShader.setFloat(("lights[" + std::to_string(i) + "].quadratic").c_str(), pointLightQuadratic);
+		allLights[i] = i;
+	}
+	for (Shader* shader : litShaders) {
+		shader->use();
+		set_point_lights(*shader, pointLightPosCol, allLights, NUM_LIGHTS, pointLightConstant, pointLightLinear, pointLightQuadratic);
 	}
 
-	// setting up buffers and shaders for rendering the light sources as points
-	unsigned int light_vbo, light_vao;
-	glGenBuffers(1, &light_vbo);
-	glGenVertexArrays(1, &light_vao);
-
-	glBindVertexArray(light_vao);
-	glBindBuffer(GL_ARRAY_BUFFER, light_vbo);
-
-	glBufferData(GL_ARRAY_BUFFER, sizeof(pointLightPosCol), pointLightPosCol, GL_STATIC_DRAW);
+	//the per frame uniforms and the light vertices are written straight into this every frame (see uploadFrameUniforms), so moving
+	//lights or instances never means respecifying a buffer
+	StreamBuffer streamBuffer(sizeof(FrameUniforms) + sizeof(pointLightPosCol), 2);
+	for (Shader* shader : instancedShaders) {
+		shader->setUniformBlock("FrameData", FRAME_UNIFORM_BINDING);
+	}
+	for (Shader* shader : litShaders) {
+		shader->setUniformBlock("FrameData", FRAME_UNIFORM_BINDING);
+	}
+	lightShader.setUniformBlock("FrameData", FRAME_UNIFORM_BINDING);
 
-	glVertexAttribPointer(lightShader.getAttributeLocation("pos"), 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void*)0);
-	glEnableVertexAttribArray(lightShader.getAttributeLocation("pos"));
+	// setting up the vertex array for rendering the light sources as points, the attributes point into streamBuffer at wherever
+	// this frame's light vertices were written
+	GLVertexArray light_vao = GLVertexArray::create();
+	int lightPosAttribute = lightShader.getAttributeLocation("pos");
+	int lightColAttribute = lightShader.getAttributeLocation("inCol");
 
-	glVertexAttribPointer(lightShader.getAttributeLocation("inCol"), 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void*)(sizeof(float)*3));
-	glEnableVertexAttribArray(lightShader.getAttributeLocation("inCol"));
+	glBindVertexArray(light_vao.id());
+	glEnableVertexAttribArray(lightPosAttribute);
+	glEnableVertexAttribArray(lightColAttribute);
 
 	// -------- FOVEATION SPECIFIC SETUP --------
 	//Foveated rendering specific setup (framebuffers, textures, single quad vao etc)
-	Shader blendingShader("blendingVertexShader.gl", "blendingFragmentShader.gl");
 
-	//Sizes define how much of the (full resolution) screen the layer covers. The base layer should always cover the full screen (defined in pixels)
-	int sizes[NUM_LAYERS * 2] = {
-		WIDTH, HEIGHT, // BASE LAYER SHOULD ALWAYS COVER FULL SCREEN
-		900, 900,
-		250, 250,
-	};
-	//Resolutions defined using the resolution of the layer (resolution shouldn't be larger than its size, since that would go over the screen's resolution)
-	//
-	int resolutions[NUM_LAYERS * 2] = {
-		WIDTH/3, HEIGHT/3,
-		450, 450,
-		sizes[NUM_LAYERS*2 - 2], sizes[2*NUM_LAYERS - 1] // FOVEA LAYER SHOULD ALWAYS BE AT NATIVE SCREEN RESOLUTION
-	};
-	//THESE SHOULD ALWAYS BE SQUARE (EXCEPT BASE LAYER) DUE TO CIRCULAR BLENDING, OTHERWISE JUST WASTED COMPUTATION
+	//Sizes define how much of the (full resolution) screen each layer covers and resolutions the resolution it is drawn at, both in
+	//pixels as width, height pairs from the base layer inwards. Only the first numLayers entries are used (see FoveationConfig)
+	FoveationConfig foveationConfig = FoveationConfig::defaults();
+	if (foveationConfig.load(FOVEATION_CONFIG_PATH, NUM_LAYERS)) {
+		std::cout << "Using foveation layout from " << FOVEATION_CONFIG_PATH << ": " << foveationConfig.describe() << std::endl;
+	}
+	int numLayers = foveationConfig.numLayers();
+	int sizes[NUM_LAYERS * 2];
+	int resolutions[NUM_LAYERS * 2];
+	foveationConfig.toPixels(WIDTH, HEIGHT, sizes, resolutions);
+	set_shadow_layers(shadows, numLayers);
 
 #ifdef SAMPLES
 	glEnable(GL_MULTISAMPLE);
-	unsigned int multisampleFBs[NUM_LAYERS], intermediateFBs[NUM_LAYERS], intermediateFBtextures[NUM_LAYERS];
-	for (int i = 0; i < NUM_LAYERS; i++) {
-		generate_multisample_eccentricity_framebuffer(&multisampleFBs[i], resolutions[2 * i], resolutions[2 * i + 1], SAMPLES);
-		generate_intermediate_framebuffer(&intermediateFBs[i], &intermediateFBtextures[i], resolutions[2 * i], resolutions[2 * i + 1]);
-	}
-#else
-	unsigned int framebufferIDs[NUM_LAYERS], framebufferTextureIDs[NUM_LAYERS];
-	for (int i = 0; i < NUM_LAYERS; i++) {
-		generate_eccentricity_framebuffer(&framebufferIDs[i], &framebufferTextureIDs[i], resolutions[2 * i], resolutions[2 * i + 1]);
-	}
 #endif
 	
 
 	//now setup buffers for the single quad that the texture will be rendered onto
-	unsigned int quadVAO, quadVBO;
 	float quad[] = {
 		-1.0f,  1.0f,  0.0f, 1.0f,
 		-1.0f, -1.0f,  0.0f, 0.0f,
@@ -258,13 +638,15 @@ int main() {
 		 1.0f, -1.0f,  1.0f, 0.0f,
 		 1.0f,  1.0f,  1.0f, 1.0f
 	};
-	glGenBuffers(1, &quadVBO);
-	glGenVertexArrays(1, &quadVAO);
+	GLBuffer quadVBO = GLBuffer::create();
+	GLVertexArray quadArray = GLVertexArray::create();
+	unsigned int quadVAO = quadArray.id();
 
 	glBindVertexArray(quadVAO);
-	glBindBuffer(GL_ARRAY_BUFFER, quadVBO);
+	glBindBuffer(GL_ARRAY_BUFFER, quadVBO.id());
 
 	glBufferData(GL_ARRAY_BUFFER, sizeof(quad), &quad, GL_STATIC_DRAW);
+	quadVBO.setBytes(GPUMemoryCategory::BUFFERS, sizeof(quad));
 
 	glVertexAttribPointer(blendingShader.getAttributeLocation("inPos"), 2, GL_FLOAT, GL_FALSE, 4 * sizeof(float), (void*)0);
 	glEnableVertexAttribArray(blendingShader.getAttributeLocation("inPos"));
@@ -272,22 +654,54 @@ int main() {
 	glVertexAttribPointer(blendingShader.getAttributeLocation("inTexCoords"), 2, GL_FLOAT, GL_FALSE, 4 * sizeof(float), (void*)(2*sizeof(float)));
 	glEnableVertexAttribArray(blendingShader.getAttributeLocation("inTexCoords"));
 
+	//snapshot being drawn by the render thread, the frame graphs' passes read their per frame settings from it
+	FrameSnapshot frame;
+	frame.shadingLod = SHADING_LOD_ENABLED;
+	frame.tiledBlend = TILED_BLEND;
+	frame.impostors = IMPOSTORS;
+	frame.shadows = SHADOWS;
+	frame.occlusionCulling = OCCLUSION_CULLING;
+	frame.logPolarAlpha = LOG_POLAR_ALPHA;
+#ifdef SAMPLES
+	frame.samplePreset = SAMPLE_PRESET;
+#endif
+	//the autotuner's frames all have the fovea in the centre, so need no margin
+	frame.foveaMargin = tuneCameraPath ? 0 : FOVEA_MARGIN;
+
+	//the eccentricity layer framebuffers and the passes drawing to/reading from them are all owned by the frame graph. The inner
+	//layers are drawn with the fovea margin added, at the same pixel density
+	int drawnSizes[NUM_LAYERS * 2];
+	int drawnResolutions[NUM_LAYERS * 2];
+	add_fovea_margin(sizes, resolutions, numLayers, frame.foveaMargin, drawnSizes, drawnResolutions);
+	FoveaLatch foveaLatch;
+	FrameGraph foveationGraph;
+	FoveationLayer foveationLayers[NUM_LAYERS];
+	build_foveation_graph(foveationGraph, scene, mainShader, layerShaders, blendingShader, tiledBlend, impostors, shadows, occlusion, drawnResolutions, drawnSizes, numLayers, quadVAO, frame, foveaLatch, foveationLayers);
+
+	//same layout per eye, with each eye getting half the window
+	int stereoSizes[NUM_LAYERS * 2];
+	int stereoResolutions[NUM_LAYERS * 2];
+	foveationConfig.toPixels(WIDTH / 2, HEIGHT, stereoSizes, stereoResolutions);
+	int numVisibleInstances = 0; // culled for both eyes at once by the render thread every stereo frame
+	FrameGraph stereoGraph;
+	FoveationLayer stereoLayers[NUM_LAYERS];
+	build_stereo_graph(stereoGraph, scene, stereoShader, stereoLayerShaders, stereoBlendingShader, stereoResolutions, stereoSizes, numLayers, quadVAO, frame, numVisibleInstances, stereoLayers);
+	set_stereo_blending(stereoBlendingShader, stereoSizes, numLayers);
+
+	FrameGraph logPolarGraph;
+	build_log_polar_graph(logPolarGraph, scene, gBufferShader, logPolarShader, inverseLogPolarShader, quadVAO, frame);
+	GPUMemory::printReport();
+#ifdef PASS_TIMING
+	foveationGraph.setTimingEnabled(true);
+	logPolarGraph.setTimingEnabled(true);
+	stereoGraph.setTimingEnabled(true);
+#endif
+
 	blendingShader.use();
 
 	blendingShader.setVec2f("screenSize", glm::vec2(WIDTH, HEIGHT));
 	blendingShader.setInt("textures[0]", 0);
-
-	//skip the base layer, we don't need boundaries for it as it covers the full screen
-	for (int i = 1; i < NUM_LAYERS; i++) {
-		glm::vec4 vec;
-		vec.x = (float)(WIDTH - sizes[2 * i]) / (2 * WIDTH);
-		vec.y = (float)(WIDTH + sizes[2 * i]) / (2 * WIDTH);
-		vec.z = (float)(HEIGHT - sizes[2 * i + 1]) / (2 * HEIGHT);
-		vec.w = (float)(HEIGHT + sizes[2 * i + 1]) / (2 * HEIGHT);
-
-		blendingShader.setVec4f(("boundaries[" + std::to_string(i - 1) + "]").c_str(), vec);
-		blendingShader.setInt(("textures[" + std::to_string(i) + "]").c_str(), i);
-	}
+	set_blending_layers(blendingShader, tiledBlend, foveationLayers, numLayers);
 
 
 	// -------- RENDER LOOP --------
@@ -296,7 +710,8 @@ int main() {
 	glEnable(GL_DEPTH_TEST);
 	glPointSize(10.0f);
 
-	glm::mat4 model[INSTANCES];
+	//model matrices are kept in SIMD friendly layout, the per frame MVPs are worked out from them in batches
+	InstanceStore instances;
 	glm::mat3 normalMatrix[INSTANCES];
 
 	//Default setup for rendering a single instance
@@ -309,119 +724,643 @@ int main() {
 	// For high poly dragon - model is a bit small, so scale up slightly
 	//model[0] = glm::scale(model[0], glm::vec3(2.0f));
 
-	for (int i = 0; i < INSTANCES; i++) {
-		//FOR CITYSCAPE:
-		glm::mat4 m = glm::mat4(1.0f);
-		model[i] = glm::scale(glm::translate(m, glm::vec3((i % 4 - 2.0f) * 0.5f, 0.0f, (-i + INSTANCES / 2.0f) * 0.3f)), glm::vec3(0.001f));
-
-		normalMatrix[i] = glm::mat3(glm::transpose(glm::inverse(model[i])));
-	}
+	add_scene_instances(instances);
+	instances.computeNormalMatrices(normalMatrix);
 	
-	glm::mat4 projection = glm::perspective(glm::radians(cam.fov), (float)WIDTH / HEIGHT, 0.1f, 100.0f);
+	for (Shader* shader : instancedShaders) {
+		shader->use();
+		for (int i = 0; i < INSTANCES; i++) {
+			glm::mat4 model = instances.getModel(i);
+			shader->setMat4f(("model["+std::to_string(i)+"]").c_str(), &model[0][0]);
+			shader->setMat3f(("normalMatrix["+std::to_string(i)+"]").c_str(), &normalMatrix[i][0][0]);
+		}
+	}
 
-	mainShader.use();
+	//the impostor atlas needs the whole scene, so is built by whichever thread owns the context once it has loaded (straight away
+	//unless loading asynchronously). Returns whether it was built by this call
+	glm::mat4 instanceModels[INSTANCES];
 	for (int i = 0; i < INSTANCES; i++) {
-		normalMatrix[i] = glm::mat3(glm::transpose(glm::inverse(model[i])));
-		mainShader.setMat4f(("model["+std::to_string(i)+"]").c_str(), &model[i][0][0]);
-		mainShader.setMat3f(("normalMatrix["+std::to_string(i)+"]").c_str(), &normalMatrix[i][0][0]);
+		instanceModels[i] = instances.getModel(i);
 	}
+	impostors.placeInstances(instanceModels, INSTANCES);
+	bool impostorsBuilt = false;
+	auto buildImpostors = [&]() {
+		if (impostorsBuilt || !scene.isLoaded()) {
+			return false;
+		}
+		impostorsBuilt = true;
+		return impostors.build(scene, SCENE_PATH, std::string(SCENE_PATH) + ".impostor");
+	};
+	buildImpostors();
 	
 
-	// Per frame timing (for delta_t, needed so camera movement speed is not tied to framerate)
-	double previousTime = 0.0;
+	//per frame state derived from a camera, filled in by the simulation loop (and the autotuner) for the render thread
+	int lightOrder[NUM_LIGHTS];
+	for (int i = 0; i < NUM_LIGHTS; i++) {
+		lightOrder[i] = i;
+	}
+	auto prepareSnapshot = [&](FrameSnapshot& next, const glm::mat4& view, const glm::mat4& projection, const glm::vec3& camPos) {
+		next.view = view;
+		next.projection = projection;
+		next.VP = projection * view;
+		instances.computeMVP(next.VP, next.MVP);
+		next.camPos = camPos;
+
+		StereoEyes eyes = computeStereoEyes(view, projection, STEREO_IPD);
+		next.eyeVP[0] = eyes.VP[0];
+		next.eyeVP[1] = eyes.VP[1];
+		next.centreVP = eyes.centreVP;
+		next.gaze[0] = STEREO_GAZE[0];
+		next.gaze[1] = STEREO_GAZE[1];
+
+		//nearest lights to the camera, for the shading variants that only shade a few of them
+		std::sort(lightOrder, lightOrder + NUM_LIGHTS, [&](int a, int b) {
+			return glm::length(pointLightPosCol[2 * a] - camPos) < glm::length(pointLightPosCol[2 * b] - camPos);
+		});
+		std::copy(lightOrder, lightOrder + NUM_LIGHTS, next.lightOrder);
+	};
 
-	#ifdef DRAW_TIMING
-	// Timings to calculate ms/draw call
-	double drawTimer = 0.0;
-	int numFramesDraw = 0;
-	#endif
+	auto uploadFrameUniforms = [&](const FrameSnapshot& frame) {
+		TRACE_SCOPE("uniform upload");
+		//the shading variants that only shade a few lights get the nearest ones to the camera
+		for (int i = 0; i < NUM_LAYERS; i++) {
+			if (layerShaders[i] != &mainShader && LAYER_SHADING[i].numLights < NUM_LIGHTS) {
+				layerShaders[i]->use();
+				set_point_lights(*layerShaders[i], pointLightPosCol, frame.lightOrder, LAYER_SHADING[i].numLights, pointLightConstant, pointLightLinear, pointLightQuadratic);
+			}
+		}
 
-	// Timings to calculate ms/frame
-	double lastTime = 0.0;
-	int numFrames = 0;
+		//the matrices and camera position every shader shares are written once into the stream buffer (which is write combined
+		//memory, so only ever written and in order) and bound as the FrameData block
+		streamBuffer.begin();
+		size_t uniformOffset = 0, lightOffset = 0;
+		FrameUniforms* uniforms = (FrameUniforms*)streamBuffer.allocate(sizeof(FrameUniforms), uniformOffset);
+		if (uniforms) {
+			std::memcpy(uniforms->MVP, frame.MVP, sizeof(frame.MVP));
+			//light positions already defined in world coordinates, so only need view and projection matrices
+			uniforms->VP = frame.VP;
+			uniforms->eyeVP[0] = frame.eyeVP[0];
+			uniforms->eyeVP[1] = frame.eyeVP[1];
+			uniforms->centreVP = frame.centreVP;
+			uniforms->camPos = frame.camPos;
+		}
+		//the light vertices too, so lights could move without respecifying a vertex buffer
+		glm::vec3* lightVertices = (glm::vec3*)streamBuffer.allocate(sizeof(pointLightPosCol), lightOffset);
+		if (lightVertices) {
+			std::memcpy(lightVertices, pointLightPosCol, sizeof(pointLightPosCol));
+		}
+		streamBuffer.end();
 
-	glfwSetTime(0.0);
-	//render loop
-	while (!glfwWindowShouldClose(window)) {
-		//usually want to clear the screen at start of new frame, clearing to set colour in this caese to check everything works AND CLEAR DEPTH BUFFER
-		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+		if (uniforms) {
+			glBindBufferRange(GL_UNIFORM_BUFFER, FRAME_UNIFORM_BINDING, streamBuffer.id(), uniformOffset, sizeof(FrameUniforms));
+		}
+		if (lightVertices) {
+			glBindVertexArray(light_vao.id());
+			glBindBuffer(GL_ARRAY_BUFFER, streamBuffer.id());
+			glVertexAttribPointer(lightPosAttribute, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void*)lightOffset);
+			glVertexAttribPointer(lightColAttribute, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void*)(lightOffset + sizeof(float) * 3));
+			glBindVertexArray(0);
+		}
+	};
 
-		glm::mat4 view = cam.getViewMatrix();
-		if (UPDATE_PROJECTION) {
-			projection = glm::perspective(glm::radians(cam.fov), (float)WIDTH/HEIGHT, 0.1f, 100.0f);
-			UPDATE_PROJECTION = false;
+	//world space boxes of the instances, redone as the scene streams in, and the instances the stereo views can see. Only used by
+	//the render thread
+	glm::vec3 instanceMin[INSTANCES], instanceMax[INSTANCES];
+	bool haveInstanceBounds = false;
+	int visibleInstances[INSTANCES];
+	//shared by the stereo culling and the layered mode's occlusion queries
+	auto updateInstanceBounds = [&](bool sceneChanged) {
+		glm::vec3 localMin, localMax;
+		if ((sceneChanged || !haveInstanceBounds) && scene.getBounds(localMin, localMax)) {
+			instances.computeWorldBounds(localMin, localMax, instanceMin, instanceMax);
+			occlusion.setBounds(instanceMin, instanceMax);
+			haveInstanceBounds = true;
+		}
+	};
+	auto uploadStereoUniforms = [&](const FrameSnapshot& frame, bool sceneChanged) {
+		TRACE_SCOPE("stereo uniform upload");
+		updateInstanceBounds(sceneChanged);
+		//culled once for both eyes, the centre eye's view lies between theirs
+		Frustum frusta[2] = { Frustum(frame.eyeVP[0]), Frustum(frame.eyeVP[1]) };
+		numVisibleInstances = haveInstanceBounds ? cullInstances(frusta, 2, instanceMin, instanceMax, INSTANCES, visibleInstances) : 0;
+
+		for (int i = 0; i < NUM_LAYERS; i++) {
+			if (stereoLayerShaders[i] != &stereoShader && LAYER_SHADING[i].numLights < NUM_LIGHTS) {
+				stereoLayerShaders[i]->use();
+				set_point_lights(*stereoLayerShaders[i], pointLightPosCol, frame.lightOrder, LAYER_SHADING[i].numLights, pointLightConstant, pointLightLinear, pointLightQuadratic);
+			}
+		}
+		//the eye matrices come from the FrameData block
+		for (Shader* shader : stereoShaders) {
+			shader->use();
+			for (int i = 0; i < numVisibleInstances; i++) {
+				shader->setInt(("instanceIds[" + std::to_string(i) + "]").c_str(), visibleInstances[i]);
+			}
 		}
+		stereoBlendingShader.use();
+		stereoBlendingShader.setVec2f("gaze[0]", frame.gaze[0]);
+		stereoBlendingShader.setVec2f("gaze[1]", frame.gaze[1]);
+	};
 
-		mainShader.use();
 
-		glm::mat4 VP = projection * view;
-		glm::mat4 MVP[INSTANCES];
-		for (int i = 0; i < INSTANCES; i++) {
-			MVP[i] = VP * model[i];
-			mainShader.setMat4f(("MVP[" + std::to_string(i) + "]").c_str(), &MVP[i][0][0]);
-		}
-		
-		mainShader.setVec3f("camPos", cam.camPos);
-		
-		//light positions already defined in world coordinates, so only need view and projection matrices
-		lightShader.use();
-		lightShader.setMat4f("VP", &VP[0][0]);
-		
+	// -------- AUTOTUNING --------
+	if (tuneCameraPath) {
+		CameraPath path;
+		if (path.load(tuneCameraPath)) {
+			//shadow maps are redrawn on the LAYER_SHADOWS intervals as they are while the view changes at runtime, counting each pose
+			//as a frame. Which maps are due is decided once per pose, so every timing repeat of it does the same work
+			double tunedPoseTime = -1.0;
+			int tunedPoses = 0;
+			int tuneShadowFrames[NUM_LAYERS];
+			std::fill(tuneShadowFrames, tuneShadowFrames + NUM_LAYERS, std::numeric_limits<int>::min() / 2);
+			bool shadowDue[NUM_LAYERS] = {};
+			FoveationTuner tuner(WIDTH, HEIGHT,
+				[&](const CameraPose& pose, bool reference) {
+					glm::mat4 poseProjection = glm::perspective(glm::radians(pose.fov), (float)WIDTH / HEIGHT, 0.1f, 100.0f);
+					prepareSnapshot(frame, pose.view, poseProjection, pose.position);
+					uploadFrameUniforms(frame);
+					glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+					if (reference) {
+						draw_reference(scene, mainShader, shadows, frame, numLayers);
+					}
+					else {
+						//timed with occlusion culling as the layered mode runs it
+						if (frame.occlusionCulling) {
+							updateInstanceBounds(false);
+						}
+						if (pose.time != tunedPoseTime) {
+							tunedPoseTime = pose.time;
+							for (int i = 0; i < numLayers; i++) {
+								shadowDue[i] = tunedPoses - tuneShadowFrames[i] >= LAYER_SHADOWS[layer_slot(i, numLayers)].interval;
+								if (shadowDue[i]) {
+									tuneShadowFrames[i] = tunedPoses;
+								}
+							}
+							tunedPoses++;
+						}
+						for (int i = 0; i < numLayers; i++) {
+							foveationGraph.setPassSkipped(foveationLayers[i].shadowPass, !(frame.shadows && shadowDue[i]));
+						}
+						foveationGraph.execute();
+					}
+				},
+				[&](const FoveationConfig& config) {
+					foveationGraph.release();
+					numLayers = config.numLayers();
+					config.toPixels(WIDTH, HEIGHT, sizes, resolutions);
+					add_fovea_margin(sizes, resolutions, numLayers, frame.foveaMargin, drawnSizes, drawnResolutions);
+					//candidates can have a different number of layers than the layout the maps were made for. The new maps are all due
+					set_shadow_layers(shadows, numLayers);
+					tunedPoseTime = -1.0;
+					std::fill(tuneShadowFrames, tuneShadowFrames + NUM_LAYERS, std::numeric_limits<int>::min() / 2);
+					build_foveation_graph(foveationGraph, scene, mainShader, layerShaders, blendingShader, tiledBlend, impostors, shadows, occlusion, drawnResolutions, drawnSizes, numLayers, quadVAO, frame, foveaLatch, foveationLayers);
+					set_blending_layers(blendingShader, tiledBlend, foveationLayers, numLayers);
+				});
+			tuner.run(path, FoveationTuner::candidateGrid(NUM_LAYERS, WIDTH, HEIGHT));
+			tuner.printParetoFront();
+			tuner.writeResults("tuning_results.csv");
+
+			const TuningResult* chosen = tuner.choose(TUNING_MIN_PSNR);
+			if (chosen && chosen->config.save(tuneOutputPath)) {
+				printf("Deployed %s (%.3f ms, %.2f dB) to %s\n", chosen->config.describe().c_str(), chosen->gpuMs, chosen->psnr, tuneOutputPath);
+			}
+		}
+
+		foveationGraph.release();
+		logPolarGraph.release();
+		stereoGraph.release();
+		glfwTerminate();
+		return 0;
+	}
+
+
+	// -------- FRAME PIPELINE --------
+	//Input and camera simulation stay on the main thread (GLFW requires event processing there) and produce an immutable snapshot of
+	//everything that changes per frame into a lock-free triple buffer. The render thread owns the GL context and always draws the newest
+	//snapshot, so preparing the next frame overlaps with submitting (and the GPU executing) the current one
+	TripleBuffer<FrameSnapshot> snapshots;
+	//gaze samples are also published on their own every tick, for the blend pass to latch one newer than its snapshot's
+	TripleBuffer<GazeSample> gazeSamples;
+	foveaLatch.samples = &gazeSamples;
+	std::atomic<bool> running(true);
+
+	glfwSetTime(0.0);
+	glfwMakeContextCurrent(NULL);
+	std::thread renderThread([&]() {
+		TRACE_THREAD_NAME("render");
+		glfwMakeContextCurrent(window);
+
+		int appliedSamplePreset = frame.samplePreset;
+		int appliedFoveaMargin = frame.foveaMargin;
+		bool wireframe = false;
+		std::unique_ptr<LatencyMonitor> latency(new LatencyMonitor());
+
+#ifdef SAMPLES
+		std::unique_ptr<FrameCapture> capture(new FrameCapture(WIDTH, HEIGHT, SAMPLES, CAPTURE_WORKERS));
+#else
+		std::unique_ptr<FrameCapture> capture(new FrameCapture(WIDTH, HEIGHT, 0, CAPTURE_WORKERS));
+#endif
+		int appliedCaptureRequests = 0;
+		int frameCount = 0;
+
+		//last snapshot actually drawn and the shader each eccentricity layer was drawn with, to tell what needs redrawing
+		FrameSnapshot drawnFrame;
+		bool haveDrawn = false;
+		const Shader* drawnLayerShaders[NUM_LAYERS] = {};
+		//frame each layer's shadow map was last redrawn on, starting long enough ago that every map is due
+		int shadowFrames[NUM_LAYERS];
+		std::fill(shadowFrames, shadowFrames + NUM_LAYERS, std::numeric_limits<int>::min() / 2);
+		//the base layer was last drawn under occlusion queries issued for an earlier view, so it may be missing instances that the
+		//queries it issued itself would now show (see OcclusionQueries)
+		bool occlusionStale = false;
+		int skippedFrames = 0;
+		int reportedStalls = 0;
+
 		#ifdef DRAW_TIMING
-		glFinish();
-		double startDraw = glfwGetTime();
+		// Timings to calculate ms/draw call
+		double drawTimer = 0.0;
+		int numFramesDraw = 0;
 		#endif
-		if (FOVEATION_ENABLED) {
-			#ifdef SAMPLES
-			scene.drawFoveatedMultisample(mainShader, blendingShader, multisampleFBs, intermediateFBs, intermediateFBtextures, resolutions, sizes, NUM_LAYERS, quadVAO, INSTANCES);
-			#else
-			scene.drawFoveated(mainShader, blendingShader, framebufferIDs, framebufferTextureIDs, resolutions, sizes, NUM_LAYERS, quadVAO, INSTANCES);
+
+		// Timings to calculate ms/frame
+		double lastTime = 0.0;
+		int numFrames = 0;
+
+		//nothing to draw until the simulation has produced its first snapshot
+		while (running && !snapshots.consume()) {
+			std::this_thread::yield();
+		}
+
+		//render loop
+		while (running) {
+			TRACE_SCOPE("frame");
+			//newest snapshot if the simulation has published one since the last frame, otherwise the last one is drawn again
+			snapshots.consume();
+			frame = snapshots.front();
+
+			//anything uploaded or recreated means nothing drawn before can be reused
+			bool invalidated = false;
+			#ifdef ASYNC_LOADING
+			invalidated = scene.update(UPLOAD_BUDGET);
+			#endif
+			if (buildImpostors()) {
+				invalidated = true;
+			}
+
+			if (frame.wireframe != wireframe) {
+				wireframe = frame.wireframe;
+				glPolygonMode(GL_FRONT_AND_BACK, wireframe ? GL_LINE : GL_FILL);
+			}
+
+			if (frame.foveaMargin != appliedFoveaMargin) {
+				//inner layers change size, so their attachments have to be recreated
+				foveationGraph.release();
+				add_fovea_margin(sizes, resolutions, numLayers, frame.foveaMargin, drawnSizes, drawnResolutions);
+				build_foveation_graph(foveationGraph, scene, mainShader, layerShaders, blendingShader, tiledBlend, impostors, shadows, occlusion, drawnResolutions, drawnSizes, numLayers, quadVAO, frame, foveaLatch, foveationLayers);
+				#ifdef PASS_TIMING
+				foveationGraph.setTimingEnabled(true);
+				#endif
+				set_blending_layers(blendingShader, tiledBlend, foveationLayers, numLayers);
+				appliedFoveaMargin = frame.foveaMargin;
+				invalidated = true;
+			}
+
+#ifdef SAMPLES
+			if (frame.samplePreset != appliedSamplePreset) {
+				//sample counts changed, so the layer attachments have to be recreated
+				foveationGraph.release();
+				build_foveation_graph(foveationGraph, scene, mainShader, layerShaders, blendingShader, tiledBlend, impostors, shadows, occlusion, drawnResolutions, drawnSizes, numLayers, quadVAO, frame, foveaLatch, foveationLayers);
+				#ifdef PASS_TIMING
+				foveationGraph.setTimingEnabled(true);
+				#endif
+				set_blending_layers(blendingShader, tiledBlend, foveationLayers, numLayers);
+				stereoGraph.release();
+				build_stereo_graph(stereoGraph, scene, stereoShader, stereoLayerShaders, stereoBlendingShader, stereoResolutions, stereoSizes, numLayers, quadVAO, frame, numVisibleInstances, stereoLayers);
+				#ifdef PASS_TIMING
+				stereoGraph.setTimingEnabled(true);
+				#endif
+				appliedSamplePreset = frame.samplePreset;
+				invalidated = true;
+			}
+#endif
+
+			//readbacks are queued after drawing and picked up by capture->update() frames later, once the GPU has finished them
+			//the stereo image can't be compared against a single full resolution view
+			bool evaluate = frame.evaluateQuality && frame.renderMode != RenderMode::FULL_RESOLUTION && frame.renderMode != RenderMode::STEREO && frameCount % EVALUATION_INTERVAL == 0;
+			bool save = frame.captureRequests != appliedCaptureRequests;
+
+			//shadow maps fitted to a different view than this frame's are out of date (see LAYER_SHADOWS)
+			bool shadowsCurrent[NUM_LAYERS];
+			bool allShadowsCurrent = true;
+			for (int i = 0; i < numLayers; i++) {
+				shadowsCurrent[i] = !frame.shadows || frame.renderMode != RenderMode::LAYERED || shadows.isCurrent(i, shadow_view(frame, drawnSizes, i));
+				allShadowsCurrent = allShadowsCurrent && shadowsCurrent[i];
+			}
+
+			bool sameView = frame.lazyRedraw && haveDrawn && !invalidated && same_view(frame, drawnFrame);
+			if (sameView && allShadowsCurrent && frame.shadingLod == drawnFrame.shadingLod && frame.tiledBlend == drawnFrame.tiledBlend && frame.impostors == drawnFrame.impostors && frame.shadows == drawnFrame.shadows && frame.occlusionCulling == drawnFrame.occlusionCulling && !occlusionStale && frame.logPolarAlpha == drawnFrame.logPolarAlpha && !evaluate && !save) {
+				//the window still shows the last frame drawn, so there is nothing to present either. Readbacks still need polling
+				capture->update();
+				latency->update();
+				skippedFrames++;
+				std::this_thread::sleep_for(std::chrono::milliseconds(1));
+				continue;
+			}
+			bool baseOcclusionStale = occlusionStale;
+			occlusionStale = false;
+			if (frame.renderMode == RenderMode::LAYERED) {
+				for (int i = 0; i < numLayers; i++) {
+					const Shader* shader = frame.shadingLod ? layerShaders[layer_slot(i, numLayers)] : &mainShader;
+					bool reuse = sameView && shader == drawnLayerShaders[i] && frame.impostors == drawnFrame.impostors && frame.shadows == drawnFrame.shadows && frame.occlusionCulling == drawnFrame.occlusionCulling && shadowsCurrent[i] && !(i == 0 && baseOcclusionStale);
+					for (int pass : foveationLayers[i].passes) {
+						foveationGraph.setPassSkipped(pass, reuse);
+					}
+					//the inner layers use the base layer's queries from the same frame, but the base layer used the last frame's, so
+					//once the view stops changing it is drawn once more with results for this view
+					if (i == 0 && frame.occlusionCulling && !reuse && !sameView) {
+						occlusionStale = true;
+					}
+					drawnLayerShaders[i] = shader;
+					//out of date maps are redrawn every interval frames while the view changes, and straight away once it stops
+					bool redrawShadow = !shadowsCurrent[i] && (sameView || frameCount - shadowFrames[i] >= LAYER_SHADOWS[layer_slot(i, numLayers)].interval);
+					foveationGraph.setPassSkipped(foveationLayers[i].shadowPass, !redrawShadow);
+					if (redrawShadow) {
+						shadowFrames[i] = frameCount;
+					}
+				}
+			}
+			drawnFrame = frame;
+			haveDrawn = true;
+
+			//usually want to clear the screen at start of new frame, clearing to set colour in this caese to check everything works AND CLEAR DEPTH BUFFER
+			glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+			uploadFrameUniforms(frame);
+
+			#ifdef DRAW_TIMING
+			glFinish();
+			double startDraw = glfwGetTime();
 			#endif
+			if (frame.renderMode == RenderMode::LAYERED) {
+				if (frame.occlusionCulling) {
+					updateInstanceBounds(invalidated);
+				}
+				foveationGraph.execute();
+			}
+			else if (frame.renderMode == RenderMode::LOG_POLAR) {
+				logPolarGraph.execute();
+			}
+			else if (frame.renderMode == RenderMode::STEREO) {
+				uploadStereoUniforms(frame, invalidated);
+				stereoGraph.execute();
+			}
+			else {
+				scene.draw(mainShader, INSTANCES);
+				//draw the point lights (mainly used as debugging tool/checking lights are in correct positions relative to objects)
+				// can't really get a good sense of the light positions from screenshots as they are rendered as fixed size points, ideally
+				// need to be moving around the scene for this to be useful
+				lightShader.use();
+				glBindVertexArray(light_vao.id());
+				glDrawArrays(GL_POINTS, 0, NUM_LIGHTS);
+			}
+
+			if (evaluate || save) {
+				TRACE_SCOPE("capture");
+				appliedCaptureRequests = frame.captureRequests;
+				float fov = glm::degrees(2.0f * std::atan(1.0f / frame.projection[1][1]));
+				//the layered blend was centred on the fovea latched just before it, not the snapshot's
+				glm::vec2 fovea = frame.renderMode == RenderMode::LAYERED ? foveaLatch.latched.position : frame.fovea;
+				int id = capture->beginFrame(evaluate, save, fov, fovea);
+				capture->captureWindow(id);
+				if (save && frame.renderMode == RenderMode::LAYERED) {
+					for (int i = 0; i < numLayers; i++) {
+						int output = foveationLayers[i].output;
+						const FrameGraphResourceDesc& desc = foveationGraph.getDesc(output);
+						int samples = desc.samples > 0 ? foveationGraph.getSamples(output) : 0;
+						capture->captureLayer(id, i, foveationGraph.getTexture(output), samples, desc.width, desc.height);
+					}
+				}
+				capture->beginReference();
+				draw_reference(scene, mainShader, shadows, frame, numLayers);
+				capture->captureReference(id);
+			}
+			capture->update();
+			frameCount++;
+
+			#ifdef DRAW_TIMING
+			glFinish();
+			double endDraw = glfwGetTime();
+
+			drawTimer += (endDraw - startDraw);
+			numFramesDraw++;
+			if (drawTimer >= 5.0) {
+				printf("%f ms/draw\n", 5000.0 / double(numFramesDraw));
+				numFramesDraw = 0;
+				drawTimer -= 5.0;
+			}
+			#endif
+
+			{
+				TRACE_SCOPE("swap");
+				glfwSwapBuffers(window); //double buffer
+			}
+			//only the layered mode latches the fovea
+			double gazeTime = frame.renderMode == RenderMode::LAYERED ? foveaLatch.latched.time : -1.0;
+			latency->frameSwapped(frame.inputTime, gazeTime, foveaLatch.drift, foveaLatch.axisDrift, frame.foveaMargin);
+			latency->update();
+
+			double currentTime = glfwGetTime();
+			numFrames++;
+			if (currentTime - lastTime >= 5.0) {
+				if (skippedFrames > 0) {
+					//time spent idle isn't part of any frame, so an average frame time would be meaningless
+					printf("%d frames drawn, %d unchanged frames skipped\n", numFrames, skippedFrames);
+				}
+				else {
+					printf("%f ms/frame\n", 5000.0 / double(numFrames));
+				}
+				numFrames = 0;
+				skippedFrames = 0;
+				#ifdef PASS_TIMING
+				if (frame.renderMode == RenderMode::LAYERED) {
+					foveationGraph.printTimings();
+				}
+				else if (frame.renderMode == RenderMode::LOG_POLAR) {
+					logPolarGraph.printTimings();
+				}
+				else if (frame.renderMode == RenderMode::STEREO) {
+					stereoGraph.printTimings();
+				}
+				#endif
+				if (frame.renderMode == RenderMode::LAYERED && frame.tiledBlend) {
+					printf("Blend tiles: %d base copy, %d layer copy, %d ring, %d general\n", tiledBlend.getTileCount(TiledBlend::BASE_COPY),
+						tiledBlend.getTileCount(TiledBlend::LAYER_COPY), tiledBlend.getTileCount(TiledBlend::RING), tiledBlend.getTileCount(TiledBlend::GENERAL));
+				}
+				capture->printSummary();
+				latency->printSummary();
+				if (streamBuffer.getStalls() > reportedStalls) {
+					printf("%d stream buffer stalls (GPU more than %d frames behind)\n", streamBuffer.getStalls() - reportedStalls, StreamBuffer::NUM_REGIONS);
+					reportedStalls = streamBuffer.getStalls();
+				}
+				lastTime += 5.0;
+				//after idling, start a fresh interval rather than printing every frame to catch up
+				if (currentTime - lastTime >= 5.0) {
+					lastTime = currentTime;
+				}
+			}
 		}
-		else {
-			scene.draw(mainShader, INSTANCES);
-			//draw the point lights (mainly used as debugging tool/checking lights are in correct positions relative to objects)
-			// can't really get a good sense of the light positions from screenshots as they are rendered as fixed size points, ideally
-			// need to be moving around the scene for this to be useful
-			lightShader.use();
-			glBindVertexArray(light_vao);
-			glDrawArrays(GL_POINTS, 0, NUM_LIGHTS);
-		}
-        #ifdef DRAW_TIMING
-		glFinish();
-		double endDraw = glfwGetTime();
-
-		drawTimer += (endDraw - startDraw);
-		numFramesDraw++;
-		if (drawTimer >= 5.0) {
-			printf("%f ms/draw\n", 5000.0 / double(numFramesDraw));
-			numFramesDraw = 0;
-			drawTimer -= 5.0;
-		}	
-		#endif
 
-		glfwSwapBuffers(window); //double buffer
-		glfwPollEvents(); //check for event triggers and calls corresponding callback functions
+		//waits for captures still being written, and its GL objects have to go while the context is current
+		capture.reset();
+		latency.reset();
+		glfwMakeContextCurrent(NULL);
+	});
+
+	//simulation loop
+	// Per frame timing (for delta_t, needed so camera movement speed is not tied to framerate)
+	double previousTime = 0.0;
+	glm::mat4 projection = glm::perspective(glm::radians(cam.fov), (float)WIDTH / HEIGHT, 0.1f, 100.0f);
+	double cameraPathStart = 0.0;
+	TRACE_THREAD_NAME("main");
+	while (!glfwWindowShouldClose(window)) {
+		//check for event triggers and calls corresponding callback functions, sleeping until there is one (or the timeout passes) so
+		//input is sampled often without spinning the CPU
+		glfwWaitEventsTimeout(SIMULATION_INTERVAL);
+		TRACE_SCOPE("simulate");
 
 		double currentTime = glfwGetTime();
 		DELTA_T = currentTime - previousTime;
 		previousTime = currentTime;
-		
-		numFrames++;
-		if (currentTime - lastTime >= 5.0) {
-			printf("%f ms/frame\n", 5000.0 / double(numFrames));
-			numFrames = 0;
-			lastTime += 5.0;
-		}
 
 		cam.processKeyboardInput(window, DELTA_T);
+
+		if (UPDATE_PROJECTION) {
+			projection = glm::perspective(glm::radians(cam.fov), (float)WIDTH/HEIGHT, 0.1f, 100.0f);
+			UPDATE_PROJECTION = false;
+		}
+
+		//every field of the snapshot is overwritten, slots are reused
+		FrameSnapshot& next = snapshots.back();
+		next.inputTime = currentTime;
+		prepareSnapshot(next, cam.getViewMatrix(), projection, cam.camPos);
+
+		GazeSample& gaze = gazeSamples.back();
+		gaze.position = SIMULATED_GAZE ? simulated_gaze(currentTime) : glm::vec2(0.0f);
+		gaze.time = currentTime;
+		next.fovea = gaze.position;
+		next.foveaMargin = FOVEA_MARGIN;
+		gazeSamples.publish();
+
+		if (RECORDING_CAMERA_PATH) {
+			if (CAMERA_PATH.size() == 0) {
+				cameraPathStart = currentTime;
+			}
+			double time = currentTime - cameraPathStart;
+			if (CAMERA_PATH.size() == 0 || time - CAMERA_PATH[CAMERA_PATH.size() - 1].time >= CAMERA_PATH_INTERVAL) {
+				CAMERA_PATH.add({ time, cam.camPos, next.view, cam.fov });
+			}
+		}
+
+		next.renderMode = RENDER_MODE;
+		next.wireframe = WIREFRAME;
+		next.shadingLod = SHADING_LOD_ENABLED;
+		next.tiledBlend = TILED_BLEND;
+		next.impostors = IMPOSTORS;
+		next.shadows = SHADOWS;
+		next.occlusionCulling = OCCLUSION_CULLING;
+		next.logPolarAlpha = LOG_POLAR_ALPHA;
+#ifdef SAMPLES
+		next.samplePreset = SAMPLE_PRESET;
+#endif
+		next.evaluateQuality = EVALUATE_QUALITY;
+		next.captureRequests = CAPTURE_REQUESTS;
+		next.lazyRedraw = LAZY_REDRAW;
+
+		snapshots.publish();
 	}
+	running = false;
+	renderThread.join();
+	glfwMakeContextCurrent(window);
 
-	//window instructed to close, so close successfully
+	//window instructed to close, so close successfully (GL objects have to be deleted while the context still exists)
+	foveationGraph.release();
+	logPolarGraph.release();
+	stereoGraph.release();
 	glfwTerminate();
 	return 0;
 }
 
+int run_software_renderer(const char* cameraPathFile) {
+	SoftwareRasterizer rasterizer(std::max(1, (int)std::thread::hardware_concurrency()));
+	if (!rasterizer.load(SCENE_PATH)) {
+		return -1;
+	}
+	InstanceStore instances;
+	add_scene_instances(instances);
+	std::vector<glm::mat4> models;
+	for (int i = 0; i < instances.size(); i++) {
+		models.push_back(instances.getModel(i));
+	}
+	rasterizer.setInstances(models);
+
+	//same lights as the openGL path (the cityscape lighting)
+	glm::vec3 pointLightPosCol[NUM_LIGHTS * 2];
+	make_point_lights(pointLightPosCol);
+	SoftwareLighting lighting;
+	lighting.direction = glm::vec3(0.0f, -1.0f, 0.5f);
+	lighting.ambient = glm::vec3(0.0f);
+	lighting.diffuse = glm::vec3(0.2f);
+	lighting.specular = glm::vec3(1.0f);
+	for (int i = 0; i < NUM_LIGHTS; i++) {
+		lighting.lights.push_back({ pointLightPosCol[2 * i], pointLightPosCol[2 * i + 1], pointLightPosCol[2 * i + 1], POINT_LIGHT_CONSTANT, POINT_LIGHT_LINEAR, POINT_LIGHT_QUADRATIC });
+	}
+	rasterizer.setLighting(lighting);
+
+	FoveationConfig foveationConfig = FoveationConfig::defaults();
+	foveationConfig.load(FOVEATION_CONFIG_PATH, NUM_LAYERS);
+	int sizes[NUM_LAYERS * 2];
+	int resolutions[NUM_LAYERS * 2];
+	foveationConfig.toPixels(CPU_WIDTH, CPU_HEIGHT, sizes, resolutions);
+
+	CameraPath path;
+	if (cameraPathFile) {
+		if (!path.load(cameraPathFile)) {
+			return -1;
+		}
+	}
+	else {
+		path.add({ 0.0, cam.camPos, cam.getViewMatrix(), cam.fov });
+	}
+
+	std::vector<unsigned char> full, foveated;
+	double fullSeconds = 0.0, foveatedSeconds = 0.0;
+	size_t fullPixels = 0, foveatedPixels = 0;
+	for (int i = 0; i < path.size(); i++) {
+		const CameraPose& pose = path[i];
+		glm::mat4 VP = glm::perspective(glm::radians(pose.fov), (float)CPU_WIDTH / CPU_HEIGHT, 0.1f, 100.0f) * pose.view;
+
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		rasterizer.draw(VP, pose.position, CPU_WIDTH, CPU_HEIGHT, full);
+		std::chrono::steady_clock::time_point middle = std::chrono::steady_clock::now();
+		fullPixels += rasterizer.getShadedPixels();
+		rasterizer.drawFoveated(VP, pose.position, CPU_WIDTH, CPU_HEIGHT, sizes, resolutions, foveationConfig.numLayers(), foveated);
+		std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now();
+		foveatedPixels += rasterizer.getShadedPixels();
+
+		fullSeconds += std::chrono::duration<double>(middle - start).count();
+		foveatedSeconds += std::chrono::duration<double>(end - middle).count();
+	}
+
+	int frames = path.size();
+	printf("Full resolution: %.2f ms/frame, %zu pixels shaded\n", 1000.0 * fullSeconds / frames, fullPixels / frames);
+	printf("Foveated (%s): %.2f ms/frame, %zu pixels shaded, %.2fx faster\n", foveationConfig.describe().c_str(), 1000.0 * foveatedSeconds / frames, foveatedPixels / frames, fullSeconds / foveatedSeconds);
+
+	stbi_flip_vertically_on_write(1);
+	stbi_write_png("cpu_full.png", CPU_WIDTH, CPU_HEIGHT, 4, &full[0], CPU_WIDTH * 4);
+	stbi_write_png("cpu_foveated.png", CPU_WIDTH, CPU_HEIGHT, 4, &foveated[0], CPU_WIDTH * 4);
+	return 0;
+}
+
 //callback function to handle user input (toggles, events on key holds - ie camera movements - are done on every render loop iteration), not the callback
 //(done since GLFW_HOLD has a delay before activating, making it not suitable for camera movements)
 void key_callback(GLFWwindow* window, int key, int scancode, int action, int mods) {
@@ -429,18 +1368,13 @@ void key_callback(GLFWwindow* window, int key, int scancode, int action, int mod
 		glfwSetWindowShouldClose(window, true);
 	}
 	else if (key == GLFW_KEY_SPACE && action == GLFW_PRESS) {
-		GLint result[2];
-		glGetIntegerv(GL_POLYGON_MODE, result);
-		if (result[1] == GL_LINE) {
-			glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
-		}
-		else {
-			glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
-		}
+		//the GL context belongs to the render thread, so the polygon mode is changed there when it sees this in the frame snapshot
+		WIREFRAME = !WIREFRAME;
 	}
 	else if (key == GLFW_KEY_LEFT_SHIFT && action == GLFW_PRESS) {
-		FOVEATION_ENABLED = !FOVEATION_ENABLED;
-		std::cout << "Swapped rendering method (disregard next timing result)" << std::endl;
+		RENDER_MODE = (RenderMode)(((int)RENDER_MODE + 1) % (int)RenderMode::NUM_MODES);
+		const char* names[] = { "full resolution", "layered foveation", "log-polar foveation", "stereo layered foveation" };
+		std::cout << "Swapped rendering method to " << names[(int)RENDER_MODE] << " (disregard next timing result)" << std::endl;
 	}
 	else if (key == GLFW_KEY_P && action == GLFW_REPEAT) {
 		cam.fov += 200.0f * DELTA_T;
@@ -459,6 +1393,87 @@ void key_callback(GLFWwindow* window, int key, int scancode, int action, int mod
 	else if (key == GLFW_KEY_1 && action == GLFW_PRESS) {
 		cam.printParameters();
 	}
+	else if (key == GLFW_KEY_K && (action == GLFW_PRESS || action == GLFW_REPEAT)) {
+		LOG_POLAR_ALPHA = std::min(LOG_POLAR_ALPHA + 0.25f, 8.0f);
+		std::cout << "Log-polar kernel alpha: " << LOG_POLAR_ALPHA << std::endl;
+	}
+	else if (key == GLFW_KEY_J && (action == GLFW_PRESS || action == GLFW_REPEAT)) {
+		LOG_POLAR_ALPHA = std::max(LOG_POLAR_ALPHA - 0.25f, 1.0f);
+		std::cout << "Log-polar kernel alpha: " << LOG_POLAR_ALPHA << std::endl;
+	}
+#ifdef ENABLE_TRACING
+	else if (key == GLFW_KEY_T && action == GLFW_PRESS) {
+		//first press starts recording, second writes everything recorded since to trace.json (open in ui.perfetto.dev)
+		if (Profiler::isCapturing()) {
+			Profiler::stopCapture("trace.json");
+		}
+		else {
+			Profiler::startCapture();
+		}
+	}
+#endif
+	else if (key == GLFW_KEY_C && action == GLFW_PRESS) {
+		if (RECORDING_CAMERA_PATH) {
+			CAMERA_PATH.save(CAMERA_PATH_FILE);
+		}
+		else {
+			CAMERA_PATH.clear();
+			std::cout << "Recording camera path (press C again to stop)" << std::endl;
+		}
+		RECORDING_CAMERA_PATH = !RECORDING_CAMERA_PATH;
+	}
+	else if (key == GLFW_KEY_E && action == GLFW_PRESS) {
+		EVALUATE_QUALITY = !EVALUATE_QUALITY;
+		std::cout << "Quality evaluation " << (EVALUATE_QUALITY ? "enabled" : "disabled") << " (disregard timing results while enabled)" << std::endl;
+	}
+	else if (key == GLFW_KEY_X && action == GLFW_PRESS) {
+		CAPTURE_REQUESTS++;
+	}
+	else if (key == GLFW_KEY_R && action == GLFW_PRESS) {
+		LAZY_REDRAW = !LAZY_REDRAW;
+		std::cout << "Lazy redraw " << (LAZY_REDRAW ? "enabled" : "disabled (every frame is redrawn)") << std::endl;
+	}
+	else if (key == GLFW_KEY_G && action == GLFW_PRESS) {
+		//only reads the (atomic) counters, so safe to do from here rather than the render thread
+		GPUMemory::printReport();
+	}
+	else if (key == GLFW_KEY_L && action == GLFW_PRESS) {
+		SHADING_LOD_ENABLED = !SHADING_LOD_ENABLED;
+		std::cout << "Shading level of detail " << (SHADING_LOD_ENABLED ? "enabled" : "disabled") << " (disregard next timing result)" << std::endl;
+	}
+	else if (key == GLFW_KEY_B && action == GLFW_PRESS) {
+		TILED_BLEND = !TILED_BLEND;
+		std::cout << "Tiled blending " << (TILED_BLEND ? "enabled" : "disabled") << " (disregard next timing result)" << std::endl;
+	}
+	else if (key == GLFW_KEY_I && action == GLFW_PRESS) {
+		IMPOSTORS = !IMPOSTORS;
+		std::cout << "Impostors " << (IMPOSTORS ? "enabled" : "disabled") << " (disregard next timing result)" << std::endl;
+	}
+	else if (key == GLFW_KEY_H && action == GLFW_PRESS) {
+		SHADOWS = !SHADOWS;
+		std::cout << "Shadows " << (SHADOWS ? "enabled" : "disabled") << " (disregard next timing result)" << std::endl;
+	}
+	else if (key == GLFW_KEY_Q && action == GLFW_PRESS) {
+		OCCLUSION_CULLING = !OCCLUSION_CULLING;
+		std::cout << "Occlusion culling " << (OCCLUSION_CULLING ? "enabled" : "disabled") << " (disregard next timing result)" << std::endl;
+	}
+	else if (key == GLFW_KEY_V && action == GLFW_PRESS) {
+		SIMULATED_GAZE = !SIMULATED_GAZE;
+		std::cout << "Simulated gaze " << (SIMULATED_GAZE ? "enabled" : "disabled") << std::endl;
+	}
+	else if ((key == GLFW_KEY_LEFT_BRACKET || key == GLFW_KEY_RIGHT_BRACKET) && action == GLFW_PRESS) {
+		//inner layers are recreated by the render thread when it sees the new margin in the frame snapshot
+		int step = key == GLFW_KEY_RIGHT_BRACKET ? FOVEA_MARGIN_STEP : -FOVEA_MARGIN_STEP;
+		FOVEA_MARGIN = std::min(std::max(FOVEA_MARGIN + step, 0), MAX_FOVEA_MARGIN);
+		std::cout << "Fovea margin set to " << FOVEA_MARGIN << " pixels (disregard next timing result)" << std::endl;
+	}
+#ifdef SAMPLES
+	else if (key == GLFW_KEY_M && action == GLFW_PRESS) {
+		//framebuffers are recreated by the render thread when it sees the new preset in the frame snapshot
+		SAMPLE_PRESET = (SAMPLE_PRESET + 1) % NUM_SAMPLE_PRESETS;
+		std::cout << "Swapped MSAA sample preset (disregard next timing result)" << std::endl;
+	}
+#endif
 }
 
 float lastMouseX, lastMouseY;
@@ -478,85 +1493,498 @@ void mouse_callback(GLFWwindow* window, double xpos, double ypos) {
 
 
 
+//declares the eccentricity layer passes (plus a resolve pass per layer when blitting) and the blending pass, then compiles the graph
+//which creates all of the layer attachments. Layer attachments are transient so the graph aliases them wherever lifetimes allow,
+//eg every layer's depth buffer (and, when blitting, every multisample colour buffer) with the same sample count is shared
+void build_foveation_graph(FrameGraph& graph, Scene& scene, Shader& renderingShader, Shader** layerShaders, Shader& blendingShader, TiledBlend& tiledBlend, ImpostorAtlas& impostors, ShadowMaps& shadows, OcclusionQueries& occlusion, int* resolutions, int* sizes, int numLayers, unsigned int quadVAO, const FrameSnapshot& frame, FoveaLatch& latch, FoveationLayer* layers) {
+#ifdef SAMPLES
+	int maxSamples = max_layer_samples();
+#endif
+
+	std::vector<int> layerColours, blendInputs;
+	for (int i = 0; i < numLayers; i++) {
+		layers[i].passes.clear();
+	}
+	//the shadow maps outlive the graph, these only redraw them. The render loop skips them unless a map is due
+	for (int i = 0; i < numLayers; i++) {
+		std::string name = "layer " + std::to_string(i) + " shadow";
+		layers[i].shadowPass = graph.addPass(name.c_str(), {}, {}, -1, [&scene, &shadows, sizes, &frame, i](FrameGraph& g) {
+			shadows.draw(i, scene, shadow_view(frame, sizes, i), INSTANCES);
+		});
+	}
+	for (int i = 0; i < numLayers; i++) {
+		std::string name = "layer " + std::to_string(i);
+		int width = resolutions[2 * i], height = resolutions[2 * i + 1];
+		int slot = layer_slot(i, numLayers);
+
 #ifdef SAMPLES
-void generate_multisample_eccentricity_framebuffer(unsigned int* framebuffer, int width, int height, int samples) {
-	//modification of generate_eccentricity_framebuffer that now attaches multisampled texture and depth attachments
-	//set up framebuffer object
-	glGenFramebuffers(1, framebuffer);
-	glBindFramebuffer(GL_FRAMEBUFFER, *framebuffer); //subsequent read and write framebuffer operations will now affect our newly created framebuffer object
-
-	//generate and attach MULTISAMPLE texture as colour attachment to framebuffer
-	unsigned int texture;
-	glGenTextures(1, &texture);
-	glBindTexture(GL_TEXTURE_2D_MULTISAMPLE, texture);
-	glTexImage2DMultisample(GL_TEXTURE_2D_MULTISAMPLE, samples, GL_RGB, width, height, GL_TRUE);
-	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D_MULTISAMPLE, texture, 0);
-
-	//attach MULTISAMPLE renderbuffer object for depth testing
-	unsigned int renderbuffer;
-	glGenRenderbuffers(1, &renderbuffer);
-	glBindRenderbuffer(GL_RENDERBUFFER, renderbuffer);
-	glRenderbufferStorageMultisample(GL_RENDERBUFFER, samples, GL_DEPTH_COMPONENT24, width, height);
-	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, renderbuffer);
-
-	//check framebuffer is complete
-	if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
-		std::cout << "Framebuffer is not complete!" << std::endl;
+		int samples = std::max(1, std::min(SAMPLE_PRESETS[frame.samplePreset][slot], maxSamples));
+		#ifdef FUSED_RESOLVE
+		bool sampled = true; // read directly by the blending shader
+		#else
+		bool sampled = false; // only ever blitted from
+		#endif
+#else
+		int samples = 0;
+		bool sampled = true;
+#endif
+		int colour = graph.createResource((name + " colour").c_str(), { GL_RGB, width, height, samples, false, sampled });
+		int depth = graph.createResource((name + " depth").c_str(), { GL_DEPTH_COMPONENT24, width, height, samples, true, false });
+		layerColours.push_back(colour);
+
+		int layerPass = graph.addPass(name.c_str(), {}, { colour }, depth, [&scene, &renderingShader, layerShaders, &impostors, &shadows, &occlusion, resolutions, sizes, &frame, i, slot](FrameGraph& g) {
+			Shader& shader = frame.shadingLod ? *layerShaders[slot] : renderingShader;
+			//the base layer covers the whole screen wherever the fovea is
+			glm::vec2 centre = i > 0 ? frame.fovea : glm::vec2(0.0f);
+			shader.use();
+			bool shadowed = frame.shadows && shadows.bind(i, shader, SHADOW_TEXTURE_UNIT);
+			int geometry[INSTANCES], impostorIds[INSTANCES];
+			int numGeometry = INSTANCES, numImpostors = 0;
+			for (int j = 0; j < INSTANCES; j++) {
+				geometry[j] = j;
+			}
+			if (frame.impostors) {
+				//pixels across of something a world unit wide at unit distance, in this layer's pixels
+				float pixelScale = frame.projection[1][1] * HEIGHT * resolutions[2 * i + 1] / (2.0f * sizes[2 * i + 1]);
+				impostors.select(frame.camPos, pixelScale, IMPOSTOR_DISTANCE, IMPOSTOR_MIN_PIXELS, geometry, numGeometry, impostorIds, numImpostors);
+			}
+			scene.beginEccentricityLayer(resolutions, sizes, i, centre);
+			if (frame.occlusionCulling) {
+				occlusion.drawInstances(scene, shader, geometry, numGeometry, frame.camPos);
+			}
+			else if (numImpostors == 0) {
+				scene.draw(shader, INSTANCES);
+			}
+			else {
+				for (int j = 0; j < numGeometry; j++) {
+					shader.setInt(("instanceIds[" + std::to_string(j) + "]").c_str(), geometry[j]);
+				}
+				shader.setBool("remapInstances", true);
+				scene.draw(shader, numGeometry);
+				shader.setBool("remapInstances", false);
+			}
+			//into the viewport the layer was just drawn with
+			impostors.draw(impostorIds, numImpostors);
+			//the base layer's depth decides what the inner layers, and the next frame's base layer, draw. Its boxes cover the whole
+			//view, so every instance gets a result
+			if (frame.occlusionCulling && i == 0) {
+				occlusion.queryBoxes(frame.camPos);
+			}
+			//every other mode draws all of the instances, unshadowed, with the same shaders
+			if (shadowed) {
+				shader.use();
+				shader.setBool("shadowsEnabled", false);
+			}
+		});
+		layers[i].passes.push_back(layerPass);
+
+#if defined(SAMPLES) && !defined(FUSED_RESOLVE)
+		//blit multisample texture to a non-multisample one which is then fed into the blending shader, done straight after the
+		//layer is drawn so the multisample attachments are free to be reused by the next layer
+		int resolved = graph.createResource((name + " resolved").c_str(), { GL_RGB, width, height, 0, false, true });
+		int resolvePass = graph.addPass((name + " resolve").c_str(), { colour }, { resolved }, -1, [layerPass, width, height](FrameGraph& g) {
+			glBindFramebuffer(GL_READ_FRAMEBUFFER, g.getFramebuffer(layerPass));
+			glBlitFramebuffer(0, 0, width, height, 0, 0, width, height, GL_COLOR_BUFFER_BIT, GL_NEAREST);
+		});
+		layers[i].passes.push_back(resolvePass);
+		blendInputs.push_back(resolved);
+#else
+		blendInputs.push_back(colour);
+#endif
+	}
+
+	//no outputs, so draws to the window's framebuffer
+	graph.addPass("blend", blendInputs, {}, -1, [&scene, &blendingShader, &tiledBlend, blendInputs, quadVAO, sizes, numLayers, &frame, &latch](FrameGraph& g) {
+		//the layers were drawn around the snapshot's fovea, but the blend is centred on the newest gaze sample there is now
+		latch_fovea(latch, frame);
+		TiledBlend::Layout layout = blending_layout(sizes, numLayers, frame.fovea, latch.latched.position, frame.foveaMargin);
+		unsigned int textures[NUM_LAYERS];
+		for (int i = 0; i < blendInputs.size(); i++) {
+			textures[i] = g.getTexture(blendInputs[i]);
+		}
+#if defined(SAMPLES) && defined(FUSED_RESOLVE)
+		unsigned int textureTarget = GL_TEXTURE_2D_MULTISAMPLE;
+#else
+		unsigned int textureTarget = GL_TEXTURE_2D;
+#endif
+		if (frame.tiledBlend) {
+			tiledBlend.draw(layout, textureTarget, textures);
+		}
+		else {
+			set_blending_fovea(blendingShader, layout);
+			scene.blendLayers(blendingShader, textureTarget, textures, (int)blendInputs.size(), quadVAO);
+		}
+	});
+
+	graph.compile();
+
+	//the driver is allowed to allocate more samples than asked for, and the fused blending shader needs the real count
+	for (int i = 0; i < numLayers; i++) {
+		layers[i].samples = graph.getSamples(layerColours[i]);
+		layers[i].output = blendInputs[i];
 	}
 }
 
-void generate_intermediate_framebuffer(unsigned int* framebuffer, unsigned int* texture, int width, int height) {
-	//only need a FBO with a colour attachment to blit (resolve) to then read from in blending shader
-	//very similar to generate_eccentricity_framebuffer but without the renderbuffer depth attachment
+//the part of the snapshot's view that layer covers, which its shadow map is fitted to
+ShadowMaps::View shadow_view(const FrameSnapshot& frame, const int* sizes, int layer) {
+	ShadowMaps::View view;
+	view.view = frame.view;
+	view.projection = frame.projection;
+	view.centre = layer > 0 ? frame.fovea : glm::vec2(0.0f);
+	view.halfSize = glm::vec2((float)sizes[2 * layer] / WIDTH, (float)sizes[2 * layer + 1] / HEIGHT);
+	return view;
+}
 
-	//set up framebuffer object
-	glGenFramebuffers(1, framebuffer);
-	glBindFramebuffer(GL_FRAMEBUFFER, *framebuffer); //subsequent read and write framebuffer operations will now affect our newly created framebuffer object
+//(re)creates a shadow map for each of numLayers layers, sized for the LAYER_SHADOWS slot each layer is drawn with, plus one more
+//after them covering the whole view at the finest resolution for the full resolution references (see draw_reference)
+void set_shadow_layers(ShadowMaps& shadows, int numLayers) {
+	int resolutions[NUM_LAYERS + 1];
+	for (int i = 0; i < numLayers; i++) {
+		resolutions[i] = LAYER_SHADOWS[layer_slot(i, numLayers)].resolution;
+	}
+	resolutions[numLayers] = LAYER_SHADOWS[NUM_LAYERS - 1].resolution;
+	shadows.setLayers(resolutions, numLayers + 1);
+}
 
-	//generate and attach texture as colour attachment to framebuffer
-	glGenTextures(1, texture);
-	glBindTexture(GL_TEXTURE_2D, *texture);
-	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, width, height, 0, GL_RGB, GL_UNSIGNED_BYTE, NULL);
-	//need to set these as we sample from the texture
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, *texture, 0);
+//draws the full resolution reference that quality evaluation and the autotuner compare against into the bound framebuffer, with
+//shadows whenever the layers have them so only foveation is measured
+void draw_reference(Scene& scene, Shader& mainShader, ShadowMaps& shadows, const FrameSnapshot& frame, int numLayers) {
+	bool shadowed = false;
+	if (frame.shadows) {
+		ShadowMaps::View view;
+		view.view = frame.view;
+		view.projection = frame.projection;
+		if (!shadows.isCurrent(numLayers, view)) {
+			int framebuffer, viewport[4];
+			glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &framebuffer);
+			glGetIntegerv(GL_VIEWPORT, viewport);
+			shadows.draw(numLayers, scene, view, INSTANCES);
+			glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+			glViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
+		}
+		mainShader.use();
+		shadowed = shadows.bind(numLayers, mainShader, SHADOW_TEXTURE_UNIT);
+	}
+	scene.draw(mainShader, INSTANCES);
+	if (shadowed) {
+		mainShader.use();
+		mainShader.setBool("shadowsEnabled", false);
+	}
+}
+
+//whether two snapshots draw the same image, other than through the per layer shading settings (and excluding the scene itself,
+//which only changes while it is being streamed in)
+bool same_view(const FrameSnapshot& a, const FrameSnapshot& b) {
+	return std::memcmp(&a.view, &b.view, sizeof(a.view)) == 0 && std::memcmp(&a.projection, &b.projection, sizeof(a.projection)) == 0 &&
+		std::memcmp(a.MVP, b.MVP, sizeof(a.MVP)) == 0 && a.camPos == b.camPos &&
+		std::memcmp(a.gaze, b.gaze, sizeof(a.gaze)) == 0 && a.fovea == b.fovea && std::equal(a.lightOrder, a.lightOrder + NUM_LIGHTS, b.lightOrder) &&
+		a.renderMode == b.renderMode && a.wireframe == b.wireframe;
+}
 
-	//check framebuffer is complete
-	if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
-		std::cout << "Framebuffer is not complete!" << std::endl;
+//points the blending shaders at the layers of a layout, where they are on screen is set every frame by set_blending_fovea (or by
+//the tiled blend itself)
+void set_blending_layers(Shader& blendingShader, TiledBlend& tiledBlend, const FoveationLayer* layers, int numLayers) {
+	blendingShader.use();
+#if defined(SAMPLES) && defined(FUSED_RESOLVE)
+	//sample counts can differ per layer, so the blending shader needs to know how many samples to resolve in each
+	int samples[NUM_LAYERS];
+	for (int i = 0; i < numLayers; i++) {
+		blendingShader.setInt(("samples[" + std::to_string(i) + "]").c_str(), layers[i].samples);
+		samples[i] = layers[i].samples;
 	}
+	tiledBlend.setSamples(samples, numLayers);
+#endif
 
+	for (int i = 1; i < NUM_LAYERS; i++) {
+		blendingShader.setInt(("textures[" + std::to_string(i) + "]").c_str(), i);
+	}
 }
+
+//where the inner layers were drawn (sizes as drawn, margin included, around drawnCentre) and the fovea they are blended in around,
+//which has to be within margin pixels of drawnCentre. Centres are in normalised device coordinates. Boundaries of the layers a
+//layout doesn't use are zeroed, which the blending shaders never treat as containing a fragment
+TiledBlend::Layout blending_layout(const int* sizes, int numLayers, glm::vec2 drawnCentre, glm::vec2 fovea, int margin) {
+	TiledBlend::Layout layout;
+	layout.numLayers = numLayers;
+	//same centre pixel as Scene::drawEccentricityLayer works out
+	float centreX = (int)(WIDTH * (1.0f + drawnCentre.x)) / 2.0f;
+	float centreY = (int)(HEIGHT * (1.0f + drawnCentre.y)) / 2.0f;
+	//skip the base layer, we don't need boundaries for it as it covers the full screen
+	for (int i = 1; i < numLayers; i++) {
+		glm::vec4& vec = layout.boundaries[i - 1];
+		vec.x = (centreX - sizes[2 * i] / 2.0f) / WIDTH;
+		vec.y = (centreX + sizes[2 * i] / 2.0f) / WIDTH;
+		vec.z = (centreY - sizes[2 * i + 1] / 2.0f) / HEIGHT;
+		vec.w = (centreY + sizes[2 * i + 1] / 2.0f) / HEIGHT;
+	}
+	layout.foveaCentre = fovea * 0.5f + 0.5f;
+	layout.margin = (float)margin;
+	layout.screenSize = glm::vec2(WIDTH, HEIGHT);
+	return layout;
+}
+
+//points the full screen blending shader's inner layers at a layout
+void set_blending_fovea(Shader& blendingShader, const TiledBlend::Layout& layout) {
+	blendingShader.use();
+	for (int i = 1; i < NUM_LAYERS; i++) {
+		blendingShader.setVec4f(("boundaries[" + std::to_string(i - 1) + "]").c_str(), layout.boundaries[i - 1]);
+	}
+	blendingShader.setVec2f("foveaCentre", layout.foveaCentre);
+	blendingShader.setFloat("margin", layout.margin);
+}
+
+//inner layers grown by margin pixels all round at the same pixel density, the base layer always covers exactly the screen
+void add_fovea_margin(const int* sizes, const int* resolutions, int numLayers, int margin, int* drawnSizes, int* drawnResolutions) {
+	for (int i = 0; i < 2 * numLayers; i++) {
+		int grown = i < 2 ? sizes[i] : sizes[i] + 2 * margin;
+		drawnSizes[i] = grown;
+		drawnResolutions[i] = sizes[i] > 0 ? (int)((long long)resolutions[i] * grown / sizes[i]) : resolutions[i];
+	}
+}
+
+//takes the newest gaze sample, clamped to within the margin of the snapshot's fovea so the blend never reaches past what the
+//inner layers were drawn for
+void latch_fovea(FoveaLatch& latch, const FrameSnapshot& frame) {
+	GazeSample sample;
+	sample.position = frame.fovea;
+	sample.time = frame.inputTime;
+	if (latch.samples) {
+		latch.samples->consume();
+		if (latch.samples->front().time > sample.time) {
+			sample = latch.samples->front();
+		}
+	}
+	glm::vec2 halfScreen(WIDTH * 0.5f, HEIGHT * 0.5f);
+	glm::vec2 offset = (sample.position - frame.fovea) * halfScreen; // in pixels
+	latch.drift = glm::length(offset);
+	latch.axisDrift = std::max(std::fabs(offset.x), std::fabs(offset.y));
+	float margin = (float)frame.foveaMargin;
+	offset = glm::clamp(offset, -margin, margin);
+	latch.latched.position = frame.fovea + offset / halfScreen;
+	latch.latched.time = sample.time;
+}
+
+//stand in for a gaze tracker: fixations FIXATION_TIME long at pseudo-random points in the middle of the screen, joined by
+//saccades SACCADE_TIME long
+glm::vec2 simulated_gaze(double time) {
+	auto fixation = [](long long n) {
+		unsigned int hash = (unsigned int)(n * 2654435761u);
+		hash ^= hash >> 13;
+		hash *= 0x5bd1e995u;
+		hash ^= hash >> 15;
+		return glm::vec2((hash & 0xFFFF) / 65535.0f - 0.5f, (hash >> 16) / 65535.0f - 0.5f) * 1.2f;
+	};
+	long long n = (long long)(time / FIXATION_TIME);
+	double t = time - n * FIXATION_TIME;
+	if (t >= SACCADE_TIME) {
+		return fixation(n);
+	}
+	//saccades accelerate then decelerate, smoothstep is close enough
+	float s = (float)(t / SACCADE_TIME);
+	return glm::mix(fixation(n - 1), fixation(n), s * s * (3.0f - 2.0f * s));
+}
+
+//stereo counterpart of build_foveation_graph, with sizes and resolutions per eye. Every layer texture holds both eyes side by side
+//and is drawn by a single pass replicating each visible instance per eye (see vertexShader.gl), apart from the base layer when
+//SHARED_PERIPHERY is set, which is one centre eye view. Multisample layers are always blitted, the fused resolve blending shader
+//only knows the mono layout
+void build_stereo_graph(FrameGraph& graph, Scene& scene, Shader& renderingShader, Shader** layerShaders, Shader& blendingShader, int* resolutions, int* sizes, int numLayers, unsigned int quadVAO, const FrameSnapshot& frame, const int& visibleInstances, FoveationLayer* layers) {
+#ifdef SAMPLES
+	int maxSamples = max_layer_samples();
+#endif
+
+	std::vector<int> layerColours, blendInputs;
+	for (int i = 0; i < numLayers; i++) {
+		layers[i].passes.clear();
+		std::string name = "stereo layer " + std::to_string(i);
+		bool shared = i == 0 && SHARED_PERIPHERY;
+		int width = resolutions[2 * i] * (shared ? 1 : 2), height = resolutions[2 * i + 1];
+		int slot = layer_slot(i, numLayers);
+
+#ifdef SAMPLES
+		int samples = std::max(1, std::min(SAMPLE_PRESETS[frame.samplePreset][slot], maxSamples));
 #else
-void generate_eccentricity_framebuffer(unsigned int* framebuffer, unsigned int* texture, int width, int height) {
-	//set up framebuffer object
-	glGenFramebuffers(1, framebuffer);
-	glBindFramebuffer(GL_FRAMEBUFFER, *framebuffer); //subsequent read and write framebuffer operations will now affect our newly created framebuffer object
-
-	//generate and attach texture as colour attachment to framebuffer
-	glGenTextures(1, texture);
-	glBindTexture(GL_TEXTURE_2D, *texture);
-	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, width, height, 0, GL_RGB, GL_UNSIGNED_BYTE, NULL);
-	//need to set these as we sample from the texture
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, *texture, 0);
-
-	//attach renderbuffer object for depth testing
-	unsigned int renderbuffer;
-	glGenRenderbuffers(1, &renderbuffer);
-	glBindRenderbuffer(GL_RENDERBUFFER, renderbuffer);
-	glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, width, height);
-	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, renderbuffer);
-
-	//check framebuffer is complete
-	if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
-		std::cout << "Framebuffer is not complete!" << std::endl;
+		int samples = 0;
+#endif
+		int colour = graph.createResource((name + " colour").c_str(), { GL_RGB, width, height, samples, false, samples == 0 });
+		int depth = graph.createResource((name + " depth").c_str(), { GL_DEPTH_COMPONENT24, width, height, samples, true, false });
+		layerColours.push_back(colour);
+
+		//magnification of the layer relative to the eye's whole view, 1 for the base layer
+		glm::vec2 scale((float)(WIDTH / 2) / sizes[2 * i], (float)HEIGHT / sizes[2 * i + 1]);
+		int layerPass = graph.addPass(name.c_str(), {}, { colour }, depth, [&scene, &renderingShader, layerShaders, &frame, &visibleInstances, i, slot, shared, scale, width, height](FrameGraph& g) {
+			Shader& shader = frame.shadingLod ? *layerShaders[slot] : renderingShader;
+			shader.use();
+			shader.setBool("sharedLayer", shared);
+			shader.setVec2f("layerScale", scale);
+			for (int eye = 0; eye < 2; eye++) {
+				//the base layer covers the whole view wherever the eye is looking
+				shader.setVec2f(("layerCentre[" + std::to_string(eye) + "]").c_str(), i == 0 ? glm::vec2(0.0f) : frame.gaze[eye]);
+			}
+			glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+			glViewport(0, 0, width, height);
+			glEnable(GL_CLIP_DISTANCE0);
+			scene.draw(shader, visibleInstances * (shared ? 1 : 2));
+			glDisable(GL_CLIP_DISTANCE0);
+		});
+		layers[i].passes.push_back(layerPass);
+
+		if (samples > 0) {
+			int resolved = graph.createResource((name + " resolved").c_str(), { GL_RGB, width, height, 0, false, true });
+			int resolvePass = graph.addPass((name + " resolve").c_str(), { colour }, { resolved }, -1, [layerPass, width, height](FrameGraph& g) {
+				glBindFramebuffer(GL_READ_FRAMEBUFFER, g.getFramebuffer(layerPass));
+				glBlitFramebuffer(0, 0, width, height, 0, 0, width, height, GL_COLOR_BUFFER_BIT, GL_NEAREST);
+			});
+			layers[i].passes.push_back(resolvePass);
+			blendInputs.push_back(resolved);
+		}
+		else {
+			blendInputs.push_back(colour);
+		}
+	}
+
+	graph.addPass("stereo blend", blendInputs, {}, -1, [&scene, &blendingShader, blendInputs, quadVAO](FrameGraph& g) {
+		unsigned int textures[NUM_LAYERS];
+		for (int i = 0; i < blendInputs.size(); i++) {
+			textures[i] = g.getTexture(blendInputs[i]);
+		}
+		scene.blendLayers(blendingShader, GL_TEXTURE_2D, textures, (int)blendInputs.size(), quadVAO);
+	});
+
+	graph.compile();
+
+	for (int i = 0; i < numLayers; i++) {
+		layers[i].samples = graph.getSamples(layerColours[i]);
+		layers[i].output = blendInputs[i];
+	}
+}
+
+//sets up the stereo blending shader for a layout, sizes per eye. Extents of the layers a layout doesn't use are zeroed, which the
+//blending shader never treats as containing a fragment
+void set_stereo_blending(Shader& blendingShader, const int* sizes, int numLayers) {
+	int eyeWidth = WIDTH / 2;
+	blendingShader.use();
+	blendingShader.setVec2f("eyeSize", glm::vec2(eyeWidth, HEIGHT));
+	blendingShader.setBool("sharedBase", SHARED_PERIPHERY);
+	blendingShader.setInt("textures[0]", 0);
+	for (int i = 1; i < NUM_LAYERS; i++) {
+		glm::vec2 extent(0.0f);
+		if (i < numLayers) {
+			extent = glm::vec2((float)sizes[2 * i] / eyeWidth, (float)sizes[2 * i + 1] / HEIGHT);
+		}
+		blendingShader.setVec2f(("extents[" + std::to_string(i - 1) + "]").c_str(), extent);
+		blendingShader.setInt(("textures[" + std::to_string(i) + "]").c_str(), i);
+	}
+}
+
+//most samples a layer can have, its colour attachment is a multisample texture and depth is a multisample renderbuffer so both
+//limits apply
+int max_layer_samples() {
+	GLint maxTextureSamples, maxRenderbufferSamples;
+	glGetIntegerv(GL_MAX_COLOR_TEXTURE_SAMPLES, &maxTextureSamples);
+	glGetIntegerv(GL_MAX_SAMPLES, &maxRenderbufferSamples);
+	return std::min(maxTextureSamples, maxRenderbufferSamples);
+}
+
+//the per layer settings (LAYER_SHADING, SAMPLE_PRESETS) have an entry for each of the NUM_LAYERS with the fovea last, layouts using
+//fewer layers take their outer layers' settings from the base layer inwards and their fovea's from the fovea entry
+int layer_slot(int layer, int numLayers) {
+	return layer == numLayers - 1 ? NUM_LAYERS - 1 : layer;
+}
+
+//declares the passes of the log-polar (kernel foveated rendering) mode: the scene is rasterised once at full resolution into a
+//G-buffer, shaded at the reduced resolution of the log-polar buffer, then transformed back into screen space
+void build_log_polar_graph(FrameGraph& graph, Scene& scene, Shader& gBufferShader, Shader& logPolarShader, Shader& inverseLogPolarShader, unsigned int quadVAO, const FrameSnapshot& frame) {
+	int logPolarWidth = (int)(WIDTH / LOG_POLAR_SIGMA), logPolarHeight = (int)(HEIGHT / LOG_POLAR_SIGMA);
+
+	int gPosition = graph.createResource("g-buffer position", { GL_RGBA16F, WIDTH, HEIGHT, 0, false, true });
+	int gNormal = graph.createResource("g-buffer normal", { GL_RGBA16F, WIDTH, HEIGHT, 0, false, true });
+	int gAlbedo = graph.createResource("g-buffer albedo", { GL_RGBA8, WIDTH, HEIGHT, 0, false, true });
+	int gSpecular = graph.createResource("g-buffer specular", { GL_RGBA8, WIDTH, HEIGHT, 0, false, true });
+	int depth = graph.createResource("g-buffer depth", { GL_DEPTH_COMPONENT24, WIDTH, HEIGHT, 0, true, false });
+	int logPolar = graph.createResource("log-polar buffer", { GL_RGB, logPolarWidth, logPolarHeight, 0, false, true });
+
+	graph.addPass("g-buffer", {}, { gPosition, gNormal, gAlbedo, gSpecular }, depth, [&scene, &gBufferShader](FrameGraph& g) {
+		glViewport(0, 0, WIDTH, HEIGHT);
+		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+		scene.draw(gBufferShader, INSTANCES);
+	});
+
+	//log of the distance from the fovea (centre of the screen) to the furthest corner, so the log-polar buffer covers the whole screen
+	float maxLogRadius = std::log(glm::length(glm::vec2(WIDTH, HEIGHT) * 0.5f));
+
+	graph.addPass("log-polar shading", { gPosition, gNormal, gAlbedo, gSpecular }, { logPolar }, -1,
+		[&logPolarShader, gPosition, gNormal, gAlbedo, gSpecular, logPolarWidth, logPolarHeight, maxLogRadius, quadVAO, &frame](FrameGraph& g) {
+		logPolarShader.use();
+		logPolarShader.setVec2f("foveaCentre", glm::vec2(WIDTH, HEIGHT) * 0.5f);
+		logPolarShader.setFloat("maxLogRadius", maxLogRadius);
+		logPolarShader.setFloat("alpha", frame.logPolarAlpha);
+
+		int gBuffer[] = { gPosition, gNormal, gAlbedo, gSpecular };
+		const char* names[] = { "gPosition", "gNormal", "gAlbedo", "gSpecular" };
+		for (int i = 0; i < 4; i++) {
+			logPolarShader.setInt(names[i], i);
+			glActiveTexture(GL_TEXTURE0 + i);
+			glBindTexture(GL_TEXTURE_2D, g.getTexture(gBuffer[i]));
+		}
+
+		glViewport(0, 0, logPolarWidth, logPolarHeight);
+		glBindVertexArray(quadVAO);
+		glDrawArrays(GL_TRIANGLES, 0, 6);
+	});
+
+	//no outputs, so draws to the window's framebuffer (replaces the blending pass of the layered mode)
+	graph.addPass("inverse log-polar", { logPolar }, {}, -1, [&inverseLogPolarShader, logPolar, maxLogRadius, quadVAO, &frame](FrameGraph& g) {
+		inverseLogPolarShader.use();
+		inverseLogPolarShader.setVec2f("screenSize", glm::vec2(WIDTH, HEIGHT));
+		inverseLogPolarShader.setVec2f("foveaCentre", glm::vec2(WIDTH, HEIGHT) * 0.5f);
+		inverseLogPolarShader.setFloat("maxLogRadius", maxLogRadius);
+		inverseLogPolarShader.setFloat("alpha", frame.logPolarAlpha);
+		inverseLogPolarShader.setInt("logPolarBuffer", 0);
+
+		glActiveTexture(GL_TEXTURE0);
+		glBindTexture(GL_TEXTURE_2D, g.getTexture(logPolar));
+		glViewport(0, 0, WIDTH, HEIGHT);
+		glBindVertexArray(quadVAO);
+		glDrawArrays(GL_TRIANGLES, 0, 6);
+	});
+
+	graph.compile();
+
+	//the angle axis wraps around, so repeat along it to avoid a seam where the angle goes from 1 back to 0
+	glBindTexture(GL_TEXTURE_2D, graph.getTexture(logPolar));
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+}
+
+bool is_full_shading(const LayerShading& shading) {
+	return shading.numLights >= NUM_LIGHTS && shading.lightRange <= 0.0f && shading.specular && shading.textureLodBias == 0.0f && shading.shadowFilter == 2;
+}
+
+//defines for compiling a variant of the main shader matching the shading level of detail, see the top of fragmentShader.gl
+std::vector<std::string> shading_defines(const LayerShading& shading) {
+	std::vector<std::string> defines;
+	defines.push_back("NUM_LIGHTS " + std::to_string(std::max(1, std::min(shading.numLights, NUM_LIGHTS))));
+	if (shading.lightRange > 0.0f) {
+		defines.push_back("LIGHT_RANGE " + std::to_string(shading.lightRange));
+	}
+	if (!shading.specular) {
+		defines.push_back("SPECULAR 0");
 	}
+	defines.push_back("TEXTURE_LOD_BIAS " + std::to_string(shading.textureLodBias));
+	defines.push_back("SHADOW_PCF " + std::to_string(std::max(0, shading.shadowFilter)));
+	return defines;
 }
-#endif
\ No newline at end of file
+
+//sets the first numLights entries of the shader's lights array to the point lights in lightOrder (so when sorted by distance
+//to the camera a shader with fewer lights gets the nearest ones), shader must be in use
+void set_point_lights(const Shader& shader, const glm::vec3* pointLightPosCol, const int* lightOrder, int numLights, float constant, float linear, float quadratic) {
+	for (int i = 0; i < numLights; i++) {
+		int light = lightOrder[i];
+		shader.setVec3f(("lights[" + std::to_string(i) + "].pos").c_str(), pointLightPosCol[2 * light]);
+		shader.setVec3f(("lights[" + std::to_string(i) + "].diffuse").c_str(), pointLightPosCol[2 * light + 1] * 1.0f);
+		shader.setVec3f(("lights[" + std::to_string(i) + "].specular").c_str(), pointLightPosCol[2 * light + 1] * 1.0f);
+		shader.setFloat(("lights[" + std::to_string(i) + "].constant").c_str(), constant);
+		shader.setFloat(("lights[" + std::to_string(i) + "].linear").c_str(), linear);
+		shader.setFloat(("lights[" + std::to_string(i) + "].quadratic").c_str(), quadratic);
+	}
+}
\ No newline at end of file
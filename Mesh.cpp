@@ -2,30 +2,33 @@
 
 #include "Mesh.h"
 #include "shader.h"
+#include "Profiler.h"
 
-Mesh::Mesh(std::vector<Vertex> vertices, std::vector<unsigned int> indices, Material material) {
-	this->vertices = vertices;
-	this->indices = indices;
+Mesh::Mesh(const std::vector<Vertex>& vertices, const std::vector<unsigned int>& indices, Material material) {
+	numVertices = vertices.size();
+	numIndices = indices.size();
 	this->material = material;
 
 	// ----- BUFFERS -------
 
 	//create the openGL objects (vertex buffer, vertex array and element buffer)
-	glGenBuffers(1, &vbo);
-	glGenVertexArrays(1, &vao);
-	glGenBuffers(1, &ebo);
+	vbo = GLBuffer::create();
+	vao = GLVertexArray::create();
+	ebo = GLBuffer::create();
 
 	//bind the vertex array first
-	glBindVertexArray(vao);
+	glBindVertexArray(vao.id());
 	//then bind vertex buffer object (vbo) to vertex buffer type target (GL_ARRAY_BUFFER), so now any calls on that configures the currently bound buffer
-	glBindBuffer(GL_ARRAY_BUFFER, vbo);
+	glBindBuffer(GL_ARRAY_BUFFER, vbo.id());
 
 	//copy vertex data into the buffer
-	glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(Vertex), &vertices[0], GL_STATIC_DRAW);
+	glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(Vertex), vertices.data(), GL_STATIC_DRAW);
 	//GL_STATIC_DRAW as the data is set only once
+	vbo.setBytes(GPUMemoryCategory::BUFFERS, vertices.size() * sizeof(Vertex));
 
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ebo);
-	glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int), &indices[0], GL_STATIC_DRAW);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ebo.id());
+	glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int), indices.data(), GL_STATIC_DRAW);
+	ebo.setBytes(GPUMemoryCategory::BUFFERS, indices.size() * sizeof(unsigned int));
 
 	//tell OpenGL how to interpret the vertex data (per vertex attribute) and enable each attribute
 	//arguments to glVertexAttribPointer are (index, size, type, normalised, stride, offset)
@@ -41,6 +44,7 @@ Mesh::Mesh(std::vector<Vertex> vertices, std::vector<unsigned int> indices, Mate
 }
 
 void Mesh::draw(Shader &shader, int instances) {
+	TRACE_SCOPE_DETAIL("Mesh::draw");
 	//convention here is to always bind diffuse texture to GL_TEXTURE0 and specular to GL_TEXTURE1
 	glActiveTexture(GL_TEXTURE0);
 	glBindTexture(GL_TEXTURE_2D, material.diffuseMapID);
@@ -52,11 +56,11 @@ void Mesh::draw(Shader &shader, int instances) {
 	shader.setFloat("shininess", material.shininess);
 	shader.setVec3f("objectColour", material.colour);
 
-	glBindVertexArray(vao);
-	glDrawElementsInstanced(GL_TRIANGLES, indices.size(), GL_UNSIGNED_INT, 0, instances);
+	glBindVertexArray(vao.id());
+	glDrawElementsInstanced(GL_TRIANGLES, numIndices, GL_UNSIGNED_INT, 0, instances);
 }
 
 int Mesh::getNumVertices() {
-	return vertices.size();
+	return numVertices;
 }
 
@@ -3,6 +3,7 @@
 #include <vector>
 #include <glm/glm.hpp>
 #include "shader.h"
+#include "GLResource.h"
 
 struct Vertex {
 	glm::vec3 position;
@@ -22,20 +23,23 @@ struct Material {
 	float shininess;
 };
 
+//Move-only, owns its openGL buffers. Vertex and index data only live on the GPU once the constructor has uploaded them
 class Mesh {
 public:
-	Mesh(std::vector<Vertex> vertices, std::vector<unsigned int> indices, Material material);
+	Mesh(const std::vector<Vertex>& vertices, const std::vector<unsigned int>& indices, Material material);
 
 	void draw(Shader& shader, int instances);
 
 	int getNumVertices();
 
 private:
-	std::vector<Vertex> vertices;
-	std::vector<unsigned int> indices;
+	int numVertices;
+	int numIndices;
+	//texture ids are not owned by the mesh, the Scene that loaded them shares them between meshes
 	Material material;
 
-	//OpenGL buffer object ids
-	unsigned int vao, vbo, ebo;
+	//OpenGL buffer objects
+	GLVertexArray vao;
+	GLBuffer vbo, ebo;
 
 };
\ No newline at end of file
@@ -0,0 +1,115 @@
+#include <glad/glad.h>
+
+#include "OcclusionQueries.h"
+#include "Scene.h"
+#include "Profiler.h"
+
+#include <string>
+
+//unit cube as 12 triangles, stretched over each box in the vertex shader
+static const float CUBE_CORNERS[] = {
+	0, 0, 0,  1, 0, 0,  1, 1, 0,   0, 0, 0,  1, 1, 0,  0, 1, 0,
+	0, 0, 1,  1, 1, 1,  1, 0, 1,   0, 0, 1,  0, 1, 1,  1, 1, 1,
+	0, 0, 0,  0, 1, 0,  0, 1, 1,   0, 0, 0,  0, 1, 1,  0, 0, 1,
+	1, 0, 0,  1, 0, 1,  1, 1, 1,   1, 0, 0,  1, 1, 1,  1, 1, 0,
+	0, 0, 0,  0, 0, 1,  1, 0, 1,   0, 0, 0,  1, 0, 1,  1, 0, 0,
+	0, 1, 0,  1, 1, 0,  1, 1, 1,   0, 1, 0,  1, 1, 1,  0, 1, 1
+};
+
+OcclusionQueries::OcclusionQueries(int count, float nearPlane) :
+	shader("occlusionBoxVertexShader.gl", "occlusionBoxFragmentShader.gl"),
+	vao(GLVertexArray::create()),
+	cubeBuffer(GLBuffer::create()),
+	issued(count, false),
+	boxMin(count),
+	boxMax(count),
+	nearPlane(nearPlane) {
+	for (int i = 0; i < count; i++) {
+		queries.push_back(GLQuery::create());
+	}
+	glBindVertexArray(vao.id());
+	glBindBuffer(GL_ARRAY_BUFFER, cubeBuffer.id());
+	glBufferData(GL_ARRAY_BUFFER, sizeof(CUBE_CORNERS), CUBE_CORNERS, GL_STATIC_DRAW);
+	cubeBuffer.setBytes(GPUMemoryCategory::BUFFERS, sizeof(CUBE_CORNERS));
+	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void*)0);
+	glEnableVertexAttribArray(0);
+	glBindVertexArray(0);
+}
+
+void OcclusionQueries::setBounds(const glm::vec3* instanceMin, const glm::vec3* instanceMax) {
+	boxMin.assign(instanceMin, instanceMin + boxMin.size());
+	boxMax.assign(instanceMax, instanceMax + boxMax.size());
+	haveBounds = true;
+}
+
+void OcclusionQueries::drawInstances(Scene& scene, Shader& shader, const int* instances, int count, const glm::vec3& camPos) {
+	TRACE_FUNCTION();
+	shader.use();
+	shader.setBool("remapInstances", true);
+	//everything that can't be culled goes in one instanced draw, as it would without queries
+	int numUnconditional = 0;
+	for (int i = 0; i < count; i++) {
+		int instance = instances[i];
+		if (!issued[instance] || isInside(instance, camPos)) {
+			shader.setInt(("instanceIds[" + std::to_string(numUnconditional++) + "]").c_str(), instance);
+		}
+	}
+	if (numUnconditional > 0) {
+		scene.draw(shader, numUnconditional);
+	}
+	//the rest are drawn one at a time, conditional render covers a whole draw
+	for (int i = 0; i < count; i++) {
+		int instance = instances[i];
+		if (!issued[instance] || isInside(instance, camPos)) {
+			continue;
+		}
+		shader.setInt("instanceIds[0]", instance);
+		glBeginConditionalRender(queries[instance].id(), GL_QUERY_NO_WAIT);
+		scene.draw(shader, 1);
+		glEndConditionalRender();
+	}
+	shader.setBool("remapInstances", false);
+}
+
+void OcclusionQueries::queryBoxes(const glm::vec3& camPos) {
+	TRACE_FUNCTION();
+	if (!haveBounds) {
+		return;
+	}
+	//tested against the depth buffer but leaving it, and the colour, as they are
+	glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+	glDepthMask(GL_FALSE);
+	shader.use();
+	glBindVertexArray(vao.id());
+	for (int i = 0; i < (int)queries.size(); i++) {
+		//drawn unconditionally anyway, so not worth a query. Its old result is dropped too, it may be long out of date by the time
+		//the camera leaves the box
+		if (isInside(i, camPos)) {
+			issued[i] = false;
+			continue;
+		}
+		shader.setVec3f("boxMin", boxMin[i]);
+		shader.setVec3f("boxMax", boxMax[i]);
+		glBeginQuery(GL_ANY_SAMPLES_PASSED, queries[i].id());
+		glDrawArrays(GL_TRIANGLES, 0, 36);
+		glEndQuery(GL_ANY_SAMPLES_PASSED);
+		issued[i] = true;
+	}
+	glBindVertexArray(0);
+	glDepthMask(GL_TRUE);
+	glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+}
+
+bool OcclusionQueries::isInside(int instance, const glm::vec3& camPos) const {
+	//the near plane's corners are further from the camera than the plane itself, twice as far covers any sensible field of view
+	if (!haveBounds) {
+		return false;
+	}
+	float margin = 2.0f * nearPlane;
+	for (int i = 0; i < 3; i++) {
+		if (camPos[i] < boxMin[instance][i] - margin || camPos[i] > boxMax[instance][i] + margin) {
+			return false;
+		}
+	}
+	return true;
+}
@@ -0,0 +1,48 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include <vector>
+#include "GLResource.h"
+#include "shader.h"
+
+class Scene;
+
+//Hardware occlusion culling of whole instances. After the base layer is drawn, each instance's world space bounding box is drawn
+//against its depth buffer (without writing anything) inside its own occlusion query. The inner layers and the next frame's base layer
+//then draw each instance under conditional rendering on its query, so hidden instances are skipped by the GPU without the CPU ever
+//waiting for a result: with GL_QUERY_NO_WAIT an instance whose query hasn't finished is simply drawn. Using the last frame's results
+//for the base layer hides the query latency, at the cost of a newly revealed instance appearing a frame late
+class OcclusionQueries {
+public:
+	//nearPlane is the camera's near plane distance, boxes the camera is about that close to would be clipped and are never culled
+	OcclusionQueries(int count, float nearPlane);
+	OcclusionQueries(const OcclusionQueries&) = delete;
+	OcclusionQueries& operator=(const OcclusionQueries&) = delete;
+
+	//depth tested box shader, which needs the FrameData block like the main shader
+	Shader& getShader() {
+		return shader;
+	}
+	//world space boxes of the instances, the queries aren't issued until these are set
+	void setBounds(const glm::vec3* instanceMin, const glm::vec3* instanceMax);
+
+	//draws the listed instances of the scene with shader (which needs instanceIds/remapInstances). Those with a query are drawn one
+	//at a time, each conditional on the last query of its box. Instances never queried yet, or whose box the camera is inside, are
+	//always drawn, together in a single instanced draw
+	void drawInstances(Scene& scene, Shader& shader, const int* instances, int count, const glm::vec3& camPos);
+	//issues a query for every instance's box against the bound framebuffer's depth buffer, in the current viewport
+	void queryBoxes(const glm::vec3& camPos);
+
+private:
+	Shader shader;
+	GLVertexArray vao;
+	GLBuffer cubeBuffer;
+	std::vector<GLQuery> queries;
+	std::vector<bool> issued; // whether each query has a recent result to draw conditionally on, a query only exists once begun
+	std::vector<glm::vec3> boxMin, boxMax;
+	float nearPlane;
+	bool haveBounds = false;
+
+	//whether camPos is close enough to the instance's box that its box could be clipped by the near plane
+	bool isInside(int instance, const glm::vec3& camPos) const;
+};
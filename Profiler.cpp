@@ -0,0 +1,161 @@
+#include "Profiler.h"
+
+#ifdef ENABLE_TRACING
+
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <vector>
+
+namespace {
+	struct TraceEvent {
+		const char* name;
+		int64_t start;
+		int64_t duration;
+		bool gpu;
+	};
+
+	//events past this per thread per capture are dropped (and counted), 8MB per thread that records anything
+	const size_t EVENTS_PER_THREAD = 1 << 18;
+
+	//only ever written by the thread it belongs to. count is published with release ordering after the event is written, so the
+	//exporting thread can read every event below it without locking
+	struct ThreadBuffer {
+		int threadIndex = 0;
+		std::atomic<const char*> name{ NULL };
+		std::atomic<int> captureId{ -1 };
+		std::atomic<size_t> count{ 0 };
+		std::atomic<size_t> dropped{ 0 };
+		std::unique_ptr<TraceEvent[]> events;
+	};
+
+	//buffers are never freed, so a thread that exits mid capture still has its events exported
+	std::mutex registryMutex;
+	std::vector<std::unique_ptr<ThreadBuffer>> buffers;
+	thread_local ThreadBuffer* localBuffer = NULL;
+
+	std::mutex internMutex;
+	std::set<std::string> internedNames;
+
+	int64_t captureStart = 0;
+
+	ThreadBuffer& threadBuffer() {
+		if (!localBuffer) {
+			std::lock_guard<std::mutex> lock(registryMutex);
+			buffers.emplace_back(new ThreadBuffer());
+			localBuffer = buffers.back().get();
+			localBuffer->threadIndex = (int)buffers.size();
+		}
+		return *localBuffer;
+	}
+
+	void appendEvent(int id, const TraceEvent& e) {
+		ThreadBuffer& buffer = threadBuffer();
+		if (buffer.captureId.load(std::memory_order_relaxed) != id) {
+			if (!buffer.events) {
+				buffer.events.reset(new TraceEvent[EVENTS_PER_THREAD]);
+			}
+			buffer.count.store(0, std::memory_order_relaxed);
+			buffer.dropped.store(0, std::memory_order_relaxed);
+			buffer.captureId.store(id, std::memory_order_release);
+		}
+
+		size_t i = buffer.count.load(std::memory_order_relaxed);
+		if (i >= EVENTS_PER_THREAD) {
+			buffer.dropped.fetch_add(1, std::memory_order_relaxed);
+			return;
+		}
+		buffer.events[i] = e;
+		buffer.count.store(i + 1, std::memory_order_release);
+	}
+
+	void writeEscaped(std::ofstream& file, const char* s) {
+		for (; *s; s++) {
+			if (*s == '"' || *s == '\\') {
+				file << '\\';
+			}
+			file << *s;
+		}
+	}
+}
+
+std::atomic<bool> Profiler::capturing(false);
+std::atomic<int> Profiler::captureId(0);
+
+int64_t Profiler::now() {
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void Profiler::startCapture() {
+	//threads clear their own buffers the first time they record into the new capture
+	captureStart = now();
+	captureId.fetch_add(1, std::memory_order_release);
+	capturing.store(true, std::memory_order_release);
+	std::cout << "Trace capture started" << std::endl;
+}
+
+void Profiler::stopCapture(const char* path) {
+	capturing.store(false, std::memory_order_release);
+	int id = captureId.load(std::memory_order_acquire);
+
+	std::ofstream file(path);
+	if (!file) {
+		std::cout << "Failed to write trace: " << path << std::endl;
+		return;
+	}
+
+	file << "{\"traceEvents\":[\n";
+	file << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":0,\"args\":{\"name\":\"GPU\"}}";
+	size_t numEvents = 0, numDropped = 0;
+	std::lock_guard<std::mutex> lock(registryMutex);
+	for (const std::unique_ptr<ThreadBuffer>& buffer : buffers) {
+		const char* name = buffer->name.load(std::memory_order_acquire);
+		file << ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << buffer->threadIndex << ",\"args\":{\"name\":\"";
+		writeEscaped(file, name ? name : "thread");
+		file << "\"}}";
+
+		if (buffer->captureId.load(std::memory_order_acquire) != id) {
+			continue; // recorded nothing this capture
+		}
+		size_t count = buffer->count.load(std::memory_order_acquire);
+		for (size_t i = 0; i < count; i++) {
+			const TraceEvent& e = buffer->events[i];
+			//timestamps in microseconds
+			file << ",\n{\"name\":\"";
+			writeEscaped(file, e.name);
+			file << "\",\"ph\":\"X\",\"pid\":1,\"tid\":" << (e.gpu ? 0 : buffer->threadIndex)
+				<< ",\"ts\":" << (e.start - captureStart) / 1000.0 << ",\"dur\":" << e.duration / 1000.0 << "}";
+		}
+		numEvents += count;
+		numDropped += buffer->dropped.load(std::memory_order_relaxed);
+	}
+	file << "\n]}\n";
+
+	std::cout << "Trace written to " << path << " (" << numEvents << " events";
+	if (numDropped > 0) {
+		std::cout << ", " << numDropped << " dropped as buffers were full";
+	}
+	std::cout << ")" << std::endl;
+}
+
+void Profiler::record(const char* name, int64_t start, int64_t duration) {
+	appendEvent(captureId.load(std::memory_order_acquire), { name, start, duration, false });
+}
+
+void Profiler::recordGpu(const char* name, int64_t start, int64_t duration) {
+	appendEvent(captureId.load(std::memory_order_acquire), { name, start, duration, true });
+}
+
+void Profiler::setThreadName(const char* name) {
+	threadBuffer().name.store(name, std::memory_order_release);
+}
+
+const char* Profiler::intern(const std::string& name) {
+	std::lock_guard<std::mutex> lock(internMutex);
+	return internedNames.insert(name).first->c_str();
+}
+
+#endif
\ No newline at end of file
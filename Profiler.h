@@ -0,0 +1,74 @@
+#pragma once
+
+//CPU instrumentation exported as a Chrome trace (chrome://tracing or ui.perfetto.dev). Compiled out entirely unless
+//ENABLE_TRACING is defined, TRACE_DETAIL additionally times very frequent calls (shader setters, individual mesh draws)
+//#define ENABLE_TRACING
+//#define TRACE_DETAIL
+
+#ifdef ENABLE_TRACING
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+
+//Events are only recorded between startCapture() and stopCapture(). Every thread writes to its own fixed size buffer without
+//locking, the buffers are read when the capture is written out
+class Profiler {
+public:
+	//nanoseconds on the clock every event uses
+	static int64_t now();
+
+	static void startCapture();
+	//stops recording and writes everything recorded to path as Chrome trace event JSON
+	static void stopCapture(const char* path);
+	static bool isCapturing() {
+		return capturing.load(std::memory_order_relaxed);
+	}
+
+	//name must stay valid until the capture is written out (string literals, or strings returned by intern())
+	static void record(const char* name, int64_t start, int64_t duration);
+	//GPU work goes on its own track, start must already be converted to the CPU clock
+	static void recordGpu(const char* name, int64_t start, int64_t duration);
+	static void setThreadName(const char* name);
+	//copy of name that lives as long as the program, for event names that aren't string literals
+	static const char* intern(const std::string& name);
+
+private:
+	static std::atomic<bool> capturing;
+	static std::atomic<int> captureId;
+};
+
+//times the enclosing scope
+class ProfileScope {
+public:
+	ProfileScope(const char* name) : name(name), start(Profiler::isCapturing() ? Profiler::now() : -1) {}
+	~ProfileScope() {
+		if (start >= 0) {
+			Profiler::record(name, start, Profiler::now() - start);
+		}
+	}
+private:
+	const char* name;
+	int64_t start;
+};
+
+#define TRACE_CONCAT_INNER(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_INNER(a, b)
+#define TRACE_SCOPE(name) ProfileScope TRACE_CONCAT(traceScope, __LINE__)(name)
+#define TRACE_FUNCTION() TRACE_SCOPE(__FUNCTION__)
+#define TRACE_THREAD_NAME(name) Profiler::setThreadName(name)
+
+#ifdef TRACE_DETAIL
+#define TRACE_SCOPE_DETAIL(name) TRACE_SCOPE(name)
+#else
+#define TRACE_SCOPE_DETAIL(name)
+#endif
+
+#else
+
+#define TRACE_SCOPE(name)
+#define TRACE_FUNCTION()
+#define TRACE_THREAD_NAME(name)
+#define TRACE_SCOPE_DETAIL(name)
+
+#endif
\ No newline at end of file
@@ -6,171 +6,363 @@
 
 #include "Scene.h"
 #include "Mesh.h"
+#include "ThreadPool.h"
+#include "Profiler.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
 #include <iostream>
+#include <thread>
 
 extern int WIDTH, HEIGHT;
+extern bool COOK_TEXTURES;
+extern float TEXTURE_ANISOTROPY;
 
-Scene::Scene(const char* path) {
+//post processing options
+static const unsigned int IMPORT_FLAGS =
+	aiProcess_Triangulate | // transform all model primitives into traingles if they aren't already
+	aiProcess_FlipUVs | // flip texture coordinates on y-axis (openGL is funny)
+	aiProcess_GenNormals | // creates normal vectors for each vertex if the model does not already have them
+	aiProcess_OptimizeMeshes; // attempts to join multiple meshes into larger meshes to reduce number of drawing calls
+
+Scene::Scene(const char* path, bool async) : pendingTasks(0) {
 	//directory needed for texture loading, assumes texture image files are stored in the same directory as the obj (as well at mtl files)
 	std::string pathString(path);
 	directory = pathString.substr(0, pathString.find_last_of('\\'));
 
+	//queried here as the loading threads can't make GL calls
+	compressTextures = COOK_TEXTURES && textureCompressionSupported();
+	if (COOK_TEXTURES && !compressTextures) {
+		std::cout << "S3TC texture compression not supported, caching uncompressed mip chains" << std::endl;
+	}
+
+	if (async) {
+		//main and render threads are already busy, leave them a core each
+		int numThreads = std::max(1, (int)std::thread::hardware_concurrency() - 2);
+		loadingPool.reset(new ThreadPool(numThreads));
+		loadAsync(pathString);
+		return;
+	}
+
 	//load .obj model file into Assimp's scene object, from which we then extract the necessary data we need
 	Assimp::Importer importer;
-	const aiScene* aScene = importer.ReadFile(path,
-		//post processing options
-		aiProcess_Triangulate | // transform all model primitives into traingles if they aren't already
-		aiProcess_FlipUVs | // flip texture coordinates on y-axis (openGL is funny)
-		aiProcess_GenNormals | // creates normal vectors for each vertex if the model does not already have them
-		aiProcess_OptimizeMeshes); // attempts to join multiple meshes into larger meshes to reduce number of drawing calls
+	const aiScene* aScene = importer.ReadFile(path, IMPORT_FLAGS);
 	if (!aScene || aScene->mFlags && AI_SCENE_FLAGS_INCOMPLETE || !aScene->mRootNode) {
 		std::cout << "Error loading scene: " << importer.GetErrorString() << std::endl;
 		return;
 	}
+	importStats.readFinished();
 
 	//Usually model loader would retain the parent-child relationship between meshes, but since we are rendering the objects statically
-	//this is not required, so we can just iterate over the scene's meshes and load them directly
-	int numVertices = 0;
-	int numVerticesAlt = 0;
-	for (int i = 0; i < aScene->mNumMeshes; i++) {
-		aiMesh* aMesh = aScene->mMeshes[i];
-		meshes.push_back(processMesh(aMesh, aScene));
-		numVertices += meshes.back().getNumVertices();
-		numVerticesAlt += aMesh->mNumVertices;
+	//this is not required, so we can just convert the scene's meshes (in parallel) and upload them in order
+	std::vector<MeshData> converted;
+	int threads = convertMeshes(aScene, converted, importStats);
+	for (MeshData& data : converted) {
+		meshes.push_back(processMesh(data));
 	}
+	importStats.print(threads);
+}
 
-	std::cout << "Vertices: " << numVertices << std::endl;
-	std::cout << "Vertices: " << numVertices << std::endl;
-
+Scene::~Scene() {
+	//stop the loading threads before the queues they write to go away, then free anything decoded but never uploaded
+	//(openGL objects are left to the context, which is already destroyed by the time the scene goes out of scope in main)
+	loadingPool.reset();
+	for (TextureData& texture : readyTextures) {
+		stbi_image_free(texture.data);
+	}
 }
 
 void Scene::draw(Shader& shader, int instances) {
+	TRACE_FUNCTION();
 	shader.use();
 	for (int i = 0; i < meshes.size(); i++) {
 		meshes[i].draw(shader, instances);
 	}
 }
 
-void Scene::drawFoveated(
-	Shader& renderingShader,
-	Shader& blendingShader,
-	unsigned int* framebufferIDs,
-	unsigned int* framebufferTextureIDs,
-	int* resolutions,
-	int* sizes,
-	int numLayers,
-	unsigned int quadVAO,
-	int instances)
-{
-	//render various size and resolution images to the framebuffers
-	for (int i = 0; i < numLayers; i++) {
-		glBindFramebuffer(GL_FRAMEBUFFER, framebufferIDs[i]);
-		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-		glViewport(
-			-((WIDTH - sizes[2 * i]) * resolutions[2 * i] / (2 * sizes[2 * i])),
-			-((HEIGHT - sizes[2 * i + 1]) * resolutions[2 * i + 1] / (2 * sizes[2 * i + 1])),
-			(WIDTH * resolutions[2 * i]) / sizes[2 * i],
-			(HEIGHT * resolutions[2 * i + 1]) / sizes[2 * i + 1]
-		);
-		this->draw(renderingShader, instances);
-	}
-	
-	//now render to default (window's) framebuffer by rebinding and using the blending shader that uses the newly drawn texture
+void Scene::drawEccentricityLayer(Shader& shader, int* resolutions, int* sizes, int layer, int instances, glm::vec2 centre) {
+	TRACE_FUNCTION();
+	beginEccentricityLayer(resolutions, sizes, layer, centre);
+	this->draw(shader, instances);
+}
+
+void Scene::beginEccentricityLayer(int* resolutions, int* sizes, int layer, glm::vec2 centre) {
+	int i = layer;
+	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+	//twice the pixel the layer is centred on, the screen's centre (WIDTH, HEIGHT) when centre is the origin
+	int centreX = (int)(WIDTH * (1.0f + centre.x));
+	int centreY = (int)(HEIGHT * (1.0f + centre.y));
+	glViewport(
+		-((centreX - sizes[2 * i]) * resolutions[2 * i] / (2 * sizes[2 * i])),
+		-((centreY - sizes[2 * i + 1]) * resolutions[2 * i + 1] / (2 * sizes[2 * i + 1])),
+		(WIDTH * resolutions[2 * i]) / sizes[2 * i],
+		(HEIGHT * resolutions[2 * i + 1]) / sizes[2 * i + 1]
+	);
+}
+
+void Scene::blendLayers(Shader& blendingShader, unsigned int textureTarget, unsigned int* textures, int numLayers, unsigned int quadVAO) {
+	TRACE_FUNCTION();
+	//render to whatever framebuffer is bound (the window's) using the blending shader that reads the newly drawn layer textures
 	blendingShader.use();
 	glViewport(0, 0, WIDTH, HEIGHT);
-	glBindFramebuffer(GL_FRAMEBUFFER, 0);
 	glBindVertexArray(quadVAO);
 	for (int i = 0; i < numLayers; i++) {
 		glActiveTexture(GL_TEXTURE0 + i);
-		glBindTexture(GL_TEXTURE_2D, framebufferTextureIDs[i]);
+		glBindTexture(textureTarget, textures[i]);
 	}
 	glDrawArrays(GL_TRIANGLES, 0, 6);
 }
 
-//more or less the same as drawFoveated, but blits textures from multisample eccentricity framebuffers into intermediate framebuffers
-// to read from
-void Scene::drawFoveatedMultisample(
-	Shader& renderingShader,
-	Shader& blendingShader,
-	unsigned int* multisampleFBs,
-	unsigned int* intermediateFBs,
-	unsigned int* intermediateFBtextures,
-	int* resolutions,
-	int* sizes,
-	int numLayers,
-	unsigned int quadVAO,
-	int instances)
-{
-	//render various size and resolution images to the framebuffers
-	for (int i = 0; i < numLayers; i++) {
-		glBindFramebuffer(GL_FRAMEBUFFER, multisampleFBs[i]);
-		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-		glViewport(
-			-((WIDTH - sizes[2 * i]) * resolutions[2 * i] / (2 * sizes[2 * i])),
-			-((HEIGHT - sizes[2 * i + 1]) * resolutions[2 * i + 1] / (2 * sizes[2 * i + 1])),
-			(WIDTH * resolutions[2 * i]) / sizes[2 * i],
-			(HEIGHT * resolutions[2 * i + 1]) / sizes[2 * i + 1]
-		);
-		this->draw(renderingShader, instances);
-	}
-
-	//blit multisample FB textures to intermediate (non-multisample) FBO which are then fed into blending shader
-	for (int i = 0; i < numLayers; i++) {
-		glBindFramebuffer(GL_READ_FRAMEBUFFER, multisampleFBs[i]);
-		glBindFramebuffer(GL_DRAW_FRAMEBUFFER, intermediateFBs[i]);
-		glBlitFramebuffer(0, 0, resolutions[2 * i], resolutions[2 * i + 1], 0, 0, resolutions[2 * i], resolutions[2 * i + 1], GL_COLOR_BUFFER_BIT, GL_NEAREST);
+Mesh Scene::processMesh(MeshData& data) {
+	if (!data.diffusePath.empty()) {
+		data.material.diffuseMapID = loadTexture(data.diffusePath.c_str(), directory);
 	}
+	if (!data.specularPath.empty()) {
+		data.material.specularMapID = loadTexture(data.specularPath.c_str(), directory);
+	}
+	includeInBounds(data.vertices);
+	return Mesh(data.vertices, data.indices, data.material);
+}
 
-	//now render to default (window's) framebuffer by rebinding and using the blending shader that uses the newly drawn texture
-	blendingShader.use();
-	glViewport(0, 0, WIDTH, HEIGHT);
-	glBindFramebuffer(GL_FRAMEBUFFER, 0);
-	glBindVertexArray(quadVAO);
-	for (int i = 0; i < numLayers; i++) {
-		glActiveTexture(GL_TEXTURE0 + i);
-		glBindTexture(GL_TEXTURE_2D, intermediateFBtextures[i]);
+void Scene::includeInBounds(const std::vector<Vertex>& vertices) {
+	for (const Vertex& vertex : vertices) {
+		if (!hasBounds) {
+			boundsMin = boundsMax = vertex.position;
+			hasBounds = true;
+		}
+		boundsMin = glm::min(boundsMin, vertex.position);
+		boundsMax = glm::max(boundsMax, vertex.position);
 	}
-	glDrawArrays(GL_TRIANGLES, 0, 6);
 }
 
-Mesh Scene::processMesh(aiMesh* mesh, const aiScene* scene) {
-	//need to extract from the assimp mesh everything we need for our Mesh object
-	std::vector<Vertex> vertices;
-	std::vector<unsigned int> indices;
-	Material mat;
+bool Scene::getBounds(glm::vec3& min, glm::vec3& max) const {
+	min = boundsMin;
+	max = boundsMax;
+	return hasBounds;
+}
 
-	bool texCoordsDefined = false;
-	
-	//Vertices
-	for (int i = 0; i < mesh->mNumVertices; i++) {
-		Vertex v;
+bool Scene::importMeshData(const char* path, std::vector<MeshData>& meshes, std::string& directory) {
+	std::string pathString(path);
+	directory = pathString.substr(0, pathString.find_last_of('\\'));
 
-		//position
-		aiVector3D assimpVec = mesh->mVertices[i];
-		v.position = glm::vec3(assimpVec.x, assimpVec.y, assimpVec.z);
+	ImportStats stats;
+	Assimp::Importer importer;
+	const aiScene* aScene = importer.ReadFile(path, IMPORT_FLAGS);
+	if (!aScene || aScene->mFlags & AI_SCENE_FLAGS_INCOMPLETE || !aScene->mRootNode) {
+		std::cout << "Error loading scene: " << importer.GetErrorString() << std::endl;
+		return false;
+	}
+	stats.readFinished();
+	int threads = convertMeshes(aScene, meshes, stats);
+	stats.print(threads);
+	return true;
+}
 
-		//normal
-		assimpVec = mesh->mNormals[i];
-		v.normal = glm::vec3(assimpVec.x, assimpVec.y, assimpVec.z);
+int Scene::convertMeshes(const aiScene* scene, std::vector<MeshData>& meshes, ImportStats& stats) {
+	TRACE_FUNCTION();
+	//every mesh gets its own slot up front, so the threads never touch the vector itself
+	meshes.clear();
+	meshes.resize(scene->mNumMeshes);
+	ThreadPool pool(std::max(0, (int)std::thread::hardware_concurrency() - 1));
+	pool.parallelFor(scene->mNumMeshes, 1, [&](int begin, int end) {
+		for (int i = begin; i < end; i++) {
+			meshes[i] = convertMesh(scene->mMeshes[i], scene, stats);
+		}
+	});
+	return pool.getNumThreads() + 1;
+}
 
-		//texCoords
-		if (mesh->mTextureCoords[0]) //Only care about fist set of texture coordinates (if they even exist)
-		{
-			assimpVec = mesh->mTextureCoords[0][i];
-			v.texCoords = glm::vec2(assimpVec.x, assimpVec.y);
-			texCoordsDefined = true;
+void ImportStats::readFinished() {
+	readMicroseconds = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count();
+}
+
+void ImportStats::meshConverted(size_t meshSourceVertices, size_t meshVertices) {
+	meshes++;
+	sourceVertices += meshSourceVertices;
+	vertices += meshVertices;
+	long long elapsed = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count();
+	long long latest = convertedMicroseconds.load();
+	while (elapsed > latest && !convertedMicroseconds.compare_exchange_weak(latest, elapsed)) {
+	}
+}
+
+void ImportStats::print(int threads) const {
+	double readMs = readMicroseconds / 1000.0;
+	double convertMs = std::max(0LL, convertedMicroseconds - readMicroseconds) / 1000.0;
+	double totalMs = readMs + convertMs;
+	double welded = sourceVertices > 0 ? 100.0 * (1.0 - (double)vertices / sourceVertices) : 0.0;
+	printf("Imported %d meshes in %.1f ms (assimp %.1f ms, converting %.1f ms on %d threads): %lld vertices, %lld after welding (%.1f%% fewer)\n",
+		meshes.load(), totalMs, readMs, convertMs, threads, sourceVertices.load(), vertices.load(), welded);
+	if (totalMs > 0.0) {
+		printf("Import throughput: %.2f million vertices/s overall, %.2f million vertices/s converting\n",
+			sourceVertices / (totalMs * 1000.0), convertMs > 0.0 ? sourceVertices / (convertMs * 1000.0) : 0.0);
+	}
+	if (repairedAttributes > 0 || droppedFaces > 0) {
+		printf("Repaired %lld invalid normals/texture coordinates, dropped %lld faces that weren't triangles\n", repairedAttributes.load(), droppedFaces.load());
+	}
+}
+
+static_assert(sizeof(Vertex) == 8 * sizeof(float), "welding compares and hashes vertices as raw bytes, so Vertex can't have padding");
+
+static inline bool isFinite(const glm::vec3& v) {
+	return std::isfinite(v.x) && std::isfinite(v.y) && std::isfinite(v.z);
+}
+
+static inline uint32_t hashVertex(const Vertex& vertex) {
+	uint32_t words[8];
+	std::memcpy(words, &vertex, sizeof(words));
+	uint32_t hash = 2166136261u;
+	for (uint32_t word : words) {
+		hash = (hash ^ word) * 16777619u;
+	}
+	return hash ^ (hash >> 15);
+}
+
+//merges bitwise identical vertices (assimp emits one per face corner for most .obj files) and remaps the indices to match,
+//in place. Uses an open addressing hash table of vertex index + 1 (0 for an empty slot) at most half full
+static void weldVertices(std::vector<Vertex>& vertices, std::vector<unsigned int>& indices) {
+	//per thread so every mesh a thread converts reuses the same allocations
+	thread_local std::vector<unsigned int> table, remap;
+	size_t capacity = 16;
+	while (capacity < vertices.size() * 2) {
+		capacity *= 2;
+	}
+	table.assign(capacity, 0);
+	remap.resize(vertices.size());
+
+	unsigned int count = 0;
+	for (size_t i = 0; i < vertices.size(); i++) {
+		size_t slot = hashVertex(vertices[i]) & (capacity - 1);
+		while (true) {
+			unsigned int entry = table[slot];
+			if (entry == 0) {
+				//unique vertices are compacted towards the front, never past i so nothing unread is overwritten
+				table[slot] = count + 1;
+				vertices[count] = vertices[i];
+				remap[i] = count++;
+				break;
+			}
+			if (std::memcmp(&vertices[entry - 1], &vertices[i], sizeof(Vertex)) == 0) {
+				remap[i] = entry - 1;
+				break;
+			}
+			slot = (slot + 1) & (capacity - 1);
 		}
+	}
+	for (unsigned int& index : indices) {
+		index = remap[index];
+	}
+	vertices.resize(count);
+}
 
-		vertices.push_back(v);			
+//no openGL calls in here, it is also run on the loading threads
+MeshData Scene::convertMesh(aiMesh* mesh, const aiScene* scene, ImportStats& stats) {
+	TRACE_FUNCTION();
+	//need to extract from the assimp mesh everything we need for our Mesh object
+	MeshData data;
+	std::vector<Vertex>& vertices = data.vertices;
+	std::vector<unsigned int>& indices = data.indices;
+	Material& mat = data.material;
+	mat.diffuseMapID = 0;
+	mat.diffuseEnabled = true;
+	mat.specularMapID = 0;
+	mat.specularEnabled = true;
+
+	//Only care about fist set of texture coordinates (if they even exist)
+	const aiVector3D* assimpTexCoords = mesh->mTextureCoords[0];
+	bool texCoordsDefined = assimpTexCoords != NULL;
+
+	//Vertices, written straight into storage sized up front. Adding 0.0f turns any -0.0f into +0.0f so that welding (which
+	//compares bits) treats them as equal
+	size_t numVertices = mesh->mNumVertices;
+	vertices.resize(numVertices);
+	std::vector<char> badNormal;
+	long long repaired = 0;
+	for (size_t i = 0; i < numVertices; i++) {
+		Vertex& v = vertices[i];
+
+		//position
+		const aiVector3D& position = mesh->mVertices[i];
+		v.position = glm::vec3(position.x + 0.0f, position.y + 0.0f, position.z + 0.0f);
+
+		//normal, missing for point and line meshes (aiProcess_GenNormals only handles faces)
+		v.normal = glm::vec3(0.0f);
+		if (mesh->mNormals) {
+			const aiVector3D& normal = mesh->mNormals[i];
+			v.normal = glm::vec3(normal.x, normal.y, normal.z);
+		}
+		float length = glm::length(v.normal);
+		if (!std::isfinite(length) || length < 1e-6f) {
+			//rebuilt from the faces below
+			if (badNormal.empty()) {
+				badNormal.resize(numVertices, 0);
+			}
+			badNormal[i] = 1;
+			v.normal = glm::vec3(0.0f);
+		}
+		else {
+			v.normal = v.normal / length + glm::vec3(0.0f);
+		}
+
+		//texCoords
+		v.texCoords = glm::vec2(0.0f);
+		if (texCoordsDefined) {
+			const aiVector3D& texCoords = assimpTexCoords[i];
+			if (std::isfinite(texCoords.x) && std::isfinite(texCoords.y)) {
+				v.texCoords = glm::vec2(texCoords.x + 0.0f, texCoords.y + 0.0f);
+			}
+			else {
+				repaired++;
+			}
+		}
 	}
 
-	//Indices
+	//Indices, only triangles as everything is drawn with GL_TRIANGLES
+	indices.resize((size_t)mesh->mNumFaces * 3);
+	size_t numIndices = 0;
+	long long dropped = 0;
 	for (unsigned int i = 0; i < mesh->mNumFaces; i++) {
-		aiFace face = mesh->mFaces[i];
-		for (unsigned int j = 0; j < face.mNumIndices; j++) {
-			indices.push_back(face.mIndices[j]);
+		const aiFace& face = mesh->mFaces[i];
+		if (face.mNumIndices != 3) {
+			dropped++;
+			continue;
 		}
+		indices[numIndices++] = face.mIndices[0];
+		indices[numIndices++] = face.mIndices[1];
+		indices[numIndices++] = face.mIndices[2];
 	}
+	indices.resize(numIndices);
+
+	//invalid normals are replaced by the area weighted average of the faces around the vertex
+	if (!badNormal.empty()) {
+		for (size_t i = 0; i < numIndices; i += 3) {
+			const glm::vec3& a = vertices[indices[i]].position;
+			glm::vec3 faceNormal = glm::cross(vertices[indices[i + 1]].position - a, vertices[indices[i + 2]].position - a);
+			if (!isFinite(faceNormal)) {
+				continue;
+			}
+			for (int corner = 0; corner < 3; corner++) {
+				if (badNormal[indices[i + corner]]) {
+					vertices[indices[i + corner]].normal += faceNormal;
+				}
+			}
+		}
+		for (size_t i = 0; i < numVertices; i++) {
+			if (!badNormal[i]) {
+				continue;
+			}
+			float length = glm::length(vertices[i].normal);
+			vertices[i].normal = length > 1e-12f ? vertices[i].normal / length + glm::vec3(0.0f) : glm::vec3(0.0f, 1.0f, 0.0f);
+			repaired++;
+		}
+	}
+
+	weldVertices(vertices, indices);
+	stats.repairedAttributes += repaired;
+	stats.droppedFaces += dropped;
+	stats.meshConverted(numVertices, vertices.size());
 
 	//Material properties (diffuse and specular maps, and plain colour if diffuse is missing)
 	aiMaterial* aMat = scene->mMaterials[mesh->mMaterialIndex];
@@ -179,7 +371,7 @@ Mesh Scene::processMesh(aiMesh* mesh, const aiScene* scene) {
 	if (texCoordsDefined && aMat->GetTextureCount(aiTextureType_DIFFUSE) > 0) {
 		aiString path;
 		aMat->GetTexture(aiTextureType_DIFFUSE, 0, &path);
-		mat.diffuseMapID = loadTexture(path.C_Str(), directory);
+		data.diffusePath = path.C_Str();
 	}
 	else {
 		mat.diffuseEnabled = false;
@@ -188,7 +380,7 @@ Mesh Scene::processMesh(aiMesh* mesh, const aiScene* scene) {
 	if (texCoordsDefined && aMat->GetTextureCount(aiTextureType_SPECULAR) > 0) {
 		aiString path;
 		aMat->GetTexture(aiTextureType_SPECULAR, 0, &path);
-		mat.specularMapID = loadTexture(path.C_Str(), directory);
+		data.specularPath = path.C_Str();
 	}
 	else {
 		mat.specularEnabled = false;
@@ -217,23 +409,45 @@ Mesh Scene::processMesh(aiMesh* mesh, const aiScene* scene) {
 	//mat.shininess = 32.0f;
 	//mat.colour = glm::vec3(0.75f, 0.1f, 0.75f);
 
-	return Mesh(vertices, indices, mat);
+	return data;
 }
 
 unsigned int Scene::loadTexture(const char* path, std::string directory) {
+	TRACE_FUNCTION();
 	//First check texture hasn't already been loaded - if so just return the openGL texture ID
 	for (int i = 0; i < loadedTextures.size(); i++) {
-		if (std::strcmp(loadedTextures[i].path, path) == 0) {
-			return loadedTextures[i].id;
+		if (loadedTextures[i].path == path) {
+			return loadedTextures[i].texture.id();
 		}
 	}
 
-	//otherwise texture is being loaded for the first time
-	unsigned int textureID;
-	glGenTextures(1, &textureID);
+	//otherwise texture is being loaded for the first time. It is kept even if loading fails, so the (empty) texture object
+	//meshes are given is still owned by something and the failure isn't repeated for every mesh using it
+	loadedTextures.push_back(Texture());
+	Texture& t = loadedTextures.back();
+	t.texture = GLTexture::create();
+	t.path = path;
+	t.resident = false;
+	unsigned int textureID = t.texture.id();
 
-	int width, height, nrChannels;
 	std::string fullPath = directory + "\\" + path;
+	if (COOK_TEXTURES) {
+		//mip chain comes precomputed (and compressed) from the cache, no decoding or glGenerateMipmap
+		CookedTexture cooked;
+		if (loadCookedTexture(fullPath, compressTextures, cooked)) {
+			glBindTexture(GL_TEXTURE_2D, textureID);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+			setTextureSampling(TEXTURE_ANISOTROPY);
+			uploadCookedTexture(cooked);
+
+			t.texture.setBytes(GPUMemoryCategory::TEXTURES, cooked.sizeInBytes());
+			t.resident = true;
+		}
+		return textureID;
+	}
+
+	int width, height, nrChannels;
 	unsigned char* data = stbi_load(fullPath.c_str(), &width, &height, &nrChannels, 0);
 	if (!data) {
 		std::cout << "Failed to load texture: " << path << std::endl;
@@ -256,24 +470,265 @@ unsigned int Scene::loadTexture(const char* path, std::string directory) {
 		//set texture wrapping and filtering options
 		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
 		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-		//TODO: should this be GL_LINEAR_MIPMAP_LINEAR? - check docs
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+		//trilinear (mipmaps are generated below, GL_LINEAR alone would never use them) plus anisotropic filtering
+		setTextureSampling(TEXTURE_ANISOTROPY);
 		//generate texture using glTexImage2D
 		glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format, GL_UNSIGNED_BYTE, data);
 		//and automatically generate the mipmaps for the currently bound texture
 		glGenerateMipmap(GL_TEXTURE_2D);
 
 		stbi_image_free(data);
-		
-		Texture t;
-		t.id = textureID;
-		t.path = path;
-		loadedTextures.push_back(t);
+
+		//full mip chain adds a third on top of the base level
+		t.texture.setBytes(GPUMemoryCategory::TEXTURES, (size_t)width * height * nrChannels * 4 / 3);
+		t.resident = true;
+	}
+
+	return textureID;
+}
+
+void Scene::loadAsync(std::string path) {
+	pendingTasks++;
+	loadingPool->submit([this, path]() {
+		//the importer owns the aiScene, so it is kept alive until the last mesh has been converted
+		TRACE_SCOPE("import scene");
+		std::shared_ptr<Assimp::Importer> importer = std::make_shared<Assimp::Importer>();
+		const aiScene* aScene = importer->ReadFile(path.c_str(), IMPORT_FLAGS);
+		if (!aScene || aScene->mFlags & AI_SCENE_FLAGS_INCOMPLETE || !aScene->mRootNode) {
+			std::cout << "Error loading scene: " << importer->GetErrorString() << std::endl;
+			pendingTasks--;
+			return;
+		}
+		importStats.readFinished();
+
+		//each mesh is converted as its own task so they appear one at a time (and in parallel), textures are decoded as soon as
+		//the first mesh using them is converted
+		for (unsigned int i = 0; i < aScene->mNumMeshes; i++) {
+			pendingTasks++;
+			loadingPool->submit([this, importer, aScene, i]() {
+				MeshData data = convertMesh(aScene->mMeshes[i], aScene, importStats);
+				requestTexture(data.diffusePath);
+				requestTexture(data.specularPath);
+				{
+					std::lock_guard<std::mutex> lock(readyMutex);
+					readyMeshes.push_back(std::move(data));
+				}
+				pendingTasks--;
+			});
+		}
+		pendingTasks--;
+	});
+}
+
+void Scene::requestTexture(const std::string& path) {
+	if (path.empty()) {
+		return;
+	}
+	{
+		std::lock_guard<std::mutex> lock(readyMutex);
+		if (std::find(requestedTextures.begin(), requestedTextures.end(), path) != requestedTextures.end()) {
+			return;
+		}
+		requestedTextures.push_back(path);
+	}
+
+	pendingTasks++;
+	loadingPool->submit([this, path]() {
+		TRACE_SCOPE("load texture");
+		TextureData texture;
+		texture.path = path;
+		std::string fullPath = directory + "\\" + path;
+		if (COOK_TEXTURES) {
+			texture.data = NULL;
+			if (loadCookedTexture(fullPath, compressTextures, texture.cooked)) {
+				std::lock_guard<std::mutex> lock(readyMutex);
+				readyTextures.push_back(std::move(texture));
+			}
+			pendingTasks--;
+			return;
+		}
+		texture.data = stbi_load(fullPath.c_str(), &texture.width, &texture.height, &texture.channels, 0);
+		if (!texture.data) {
+			//meshes using it keep the placeholder
+			std::cout << "Failed to load texture: " << path << std::endl;
+		}
+		else if (texture.channels != 3 && texture.channels != 4) {
+			std::cout << "Unsupported number of channels (" << texture.channels << ") in texture: " << path << std::endl;
+			stbi_image_free(texture.data);
+		}
+		else {
+			std::lock_guard<std::mutex> lock(readyMutex);
+			readyTextures.push_back(texture);
+		}
+		pendingTasks--;
+	});
+}
+
+bool Scene::update(size_t uploadBudget) {
+	if (!loadingPool) {
+		return false;
+	}
+	TRACE_FUNCTION();
+
+	size_t uploaded = 0;
+	bool any = false;
+	while (!any || uploaded < uploadBudget) {
+		//geometry first, a mesh with placeholder materials is more useful than a texture with nothing to put it on
+		MeshData data;
+		TextureData texture;
+		bool haveMesh = false, haveTexture = false;
+		{
+			std::lock_guard<std::mutex> lock(readyMutex);
+			if (!readyMeshes.empty()) {
+				size_t bytes = readyMeshes.front().vertices.size() * sizeof(Vertex) + readyMeshes.front().indices.size() * sizeof(unsigned int);
+				if (any && uploaded + bytes > uploadBudget) {
+					break;
+				}
+				data = std::move(readyMeshes.front());
+				readyMeshes.pop_front();
+				uploaded += bytes;
+				haveMesh = true;
+			}
+			else if (!readyTextures.empty()) {
+				size_t bytes = readyTextures.front().sizeInBytes();
+				if (any && uploaded + bytes > uploadBudget) {
+					break;
+				}
+				texture = std::move(readyTextures.front());
+				readyTextures.pop_front();
+				uploaded += bytes;
+				haveTexture = true;
+			}
+		}
+
+		if (haveMesh) {
+			//textures not uploaded yet are drawn as a single texel of the material's colour, with no specular highlights
+			if (!data.diffusePath.empty()) {
+				data.material.diffuseMapID = textureSlot(data.diffusePath, data.material.colour);
+			}
+			if (!data.specularPath.empty()) {
+				data.material.specularMapID = textureSlot(data.specularPath, glm::vec3(0.0f));
+			}
+			includeInBounds(data.vertices);
+			meshes.push_back(Mesh(std::move(data.vertices), std::move(data.indices), data.material));
+		}
+		else if (haveTexture) {
+			uploadTexture(texture);
+		}
+		else {
+			break;
+		}
+		any = true;
+	}
+
+	if (!loadReported && isLoaded()) {
+		int numVertices = 0;
+		for (Mesh& mesh : meshes) {
+			numVertices += mesh.getNumVertices();
+		}
+		std::cout << "Scene loaded, vertices: " << numVertices << std::endl;
+		importStats.print(loadingPool->getNumThreads());
+		GPUMemory::printReport();
+		loadReported = true;
+	}
+	return any;
+}
+
+bool Scene::isLoaded() const {
+	if (!loadingPool) {
+		return true;
+	}
+	std::lock_guard<std::mutex> lock(readyMutex);
+	return pendingTasks == 0 && readyMeshes.empty() && readyTextures.empty();
+}
+
+unsigned int Scene::textureSlot(const std::string& path, glm::vec3 placeholder) {
+	for (int i = 0; i < loadedTextures.size(); i++) {
+		if (loadedTextures[i].path == path) {
+			return loadedTextures[i].texture.id();
+		}
 	}
 
+	unsigned char texel[3] = {
+		(unsigned char)(glm::clamp(placeholder.x, 0.0f, 1.0f) * 255.0f),
+		(unsigned char)(glm::clamp(placeholder.y, 0.0f, 1.0f) * 255.0f),
+		(unsigned char)(glm::clamp(placeholder.z, 0.0f, 1.0f) * 255.0f)
+	};
+	Texture t;
+	t.texture = GLTexture::create();
+	glBindTexture(GL_TEXTURE_2D, t.texture.id());
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, 1, 1, 0, GL_RGB, GL_UNSIGNED_BYTE, texel);
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+	t.texture.setBytes(GPUMemoryCategory::TEXTURES, 3);
+	t.path = path;
+	t.resident = false;
+	unsigned int textureID = t.texture.id();
+	loadedTextures.push_back(std::move(t));
 	return textureID;
 }
 
+void Scene::uploadTexture(TextureData& texture) {
+	TRACE_FUNCTION();
+	//placeholder's texture object is redefined in place, so meshes already drawing with it pick up the real image automatically
+	unsigned int textureID = textureSlot(texture.path, glm::vec3(0.5f));
+	size_t bytes = texture.sizeInBytes();
+	Texture* slot = NULL;
+	for (Texture& t : loadedTextures) {
+		if (t.texture.id() == textureID) {
+			slot = &t;
+		}
+	}
+	slot->resident = true;
+	slot->texture.setBytes(GPUMemoryCategory::TEXTURES, texture.data ? bytes * 4 / 3 : bytes);
+
+	//copy into a pixel unpack buffer so glTexImage2D returns without waiting for the driver to take its own copy of the image,
+	//the buffer is orphaned every upload so a transfer still in flight is never written to
+	if (!uploadPBO) {
+		uploadPBO = GLBuffer::create();
+	}
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, uploadPBO.id());
+	glBufferData(GL_PIXEL_UNPACK_BUFFER, bytes, NULL, GL_STREAM_DRAW);
+	uploadPBO.setBytes(GPUMemoryCategory::BUFFERS, bytes);
+	unsigned char* staging = (unsigned char*)glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, bytes, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+	if (staging && !texture.data) {
+		//cooked levels are packed one after another, uploadCookedTexture reads them back at the same offsets
+		for (const std::vector<unsigned char>& level : texture.cooked.levels) {
+			std::memcpy(staging, level.data(), level.size());
+			staging += level.size();
+		}
+		glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+
+		glBindTexture(GL_TEXTURE_2D, textureID);
+		setTextureSampling(TEXTURE_ANISOTROPY);
+		uploadCookedTexture(texture.cooked, true, 0);
+	}
+	else if (staging) {
+		std::memcpy(staging, texture.data, bytes);
+		glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+
+		GLenum format = texture.channels == 4 ? GL_RGBA : GL_RGB;
+		glBindTexture(GL_TEXTURE_2D, textureID);
+		glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+		//data argument is an offset into the bound unpack buffer
+		glTexImage2D(GL_TEXTURE_2D, 0, format, texture.width, texture.height, 0, format, GL_UNSIGNED_BYTE, (void*)0);
+		glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+		glGenerateMipmap(GL_TEXTURE_2D);
+		setTextureSampling(TEXTURE_ANISOTROPY);
+	}
+	else {
+		std::cout << "Failed to map texture upload buffer for: " << texture.path << std::endl;
+	}
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+	if (texture.data) {
+		stbi_image_free(texture.data);
+	}
+}
+
 //C++ shouts at me if I don't define the static member here
-std::vector<Texture> Scene::loadedTextures;
\ No newline at end of file
+std::vector<Texture> Scene::loadedTextures;
+bool Scene::compressTextures = false;
\ No newline at end of file
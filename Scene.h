@@ -6,49 +6,132 @@
 
 #include "shader.h"
 #include "Mesh.h"
+#include "TextureCooker.h"
 
+#include <atomic>
+#include <chrono>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
 #include <vector>
 
+class ThreadPool;
+
 struct Texture {
-	unsigned int id;
-	const char* path;
+	GLTexture texture;
+	std::string path;
+	bool resident; // false while a placeholder texel is standing in for the image (asynchronous loading only)
+};
+
+//CPU side result of converting an assimp mesh, produced by the loading threads and turned into a Mesh by the render thread
+struct MeshData {
+	std::vector<Vertex> vertices;
+	std::vector<unsigned int> indices;
+	Material material;
+	//texture files the material uses, empty if the corresponding map is disabled
+	std::string diffusePath;
+	std::string specularPath;
+};
+
+//decoded texture image waiting to be uploaded, data is owned by stb_image. When textures are cooked data is NULL and the
+//levels are in cooked instead
+struct TextureData {
+	std::string path;
+	unsigned char* data;
+	int width, height, channels;
+	CookedTexture cooked;
+
+	size_t sizeInBytes() const {
+		return data ? (size_t)width * height * channels : cooked.sizeInBytes();
+	}
+};
+
+//How long importing a scene took and what converting its meshes did to them, added to by every thread converting meshes
+struct ImportStats {
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	std::atomic<long long> readMicroseconds{ 0 }; // spent in assimp's ReadFile
+	std::atomic<long long> convertedMicroseconds{ 0 }; // from start until the last mesh finished converting
+	std::atomic<int> meshes{ 0 };
+	std::atomic<long long> sourceVertices{ 0 }; // as imported by assimp
+	std::atomic<long long> vertices{ 0 }; // left after welding
+	std::atomic<long long> repairedAttributes{ 0 }; // invalid normals and texture coordinates replaced
+	std::atomic<long long> droppedFaces{ 0 }; // points and lines, which can't be drawn as triangles
+
+	void readFinished();
+	void meshConverted(size_t sourceVertices, size_t vertices);
+	void print(int threads) const;
 };
 
 class Scene {
+	//benchmarks/LoaderBenchmark.cpp times the conversion, upload and texture lookup steps on their own
+	friend class LoaderBenchmark;
 public:
-	Scene(const char* path);
+	//with async set, importing and converting meshes and decoding textures happen on background threads and the constructor
+	//returns immediately. Nothing is drawn until update() has uploaded it
+	Scene(const char* path, bool async = false);
+	~Scene();
+
+	//uploads meshes and textures finished by the loading threads, stopping once uploadBudget bytes have been sent this call (at
+	//least one item is always uploaded so large ones still make progress). Must be called from the thread owning the GL context.
+	//Returns whether anything was uploaded, ie whether the scene now draws differently
+	bool update(size_t uploadBudget);
+	bool isLoaded() const;
+	//model space bounding box of everything uploaded so far, false if nothing has been
+	bool getBounds(glm::vec3& min, glm::vec3& max) const;
 
 	void draw(Shader &shader, int instances);
-	void drawFoveated(
-		Shader& renderingShader,
-		Shader& blendingShader,
-		unsigned int* framebufferIDs,
-		unsigned int* framebufferTextureIDs,
-		int* resolutions,
-		int* sizes,
-		int numLayers,
-		unsigned int quadVAO,
-		int instances);
-
-	void drawFoveatedMultisample(
-		Shader& renderingShader,
-		Shader& blendingShader,
-		unsigned int* multisampleFBs,
-		unsigned int* intermediateFBs,
-		unsigned int* intermediateFBtextures,
-		int* resolutions,
-		int* sizes,
-		int numLayers,
-		unsigned int quadVAO,
-		int instances);
+	//draws the scene into the currently bound eccentricity layer framebuffer, setting the viewport so that the layer covers
+	//sizes[2*layer] x sizes[2*layer+1] pixels around centre (in normalised device coordinates, the fovea) at a resolution of
+	//resolutions[2*layer] x resolutions[2*layer+1]
+	void drawEccentricityLayer(Shader& shader, int* resolutions, int* sizes, int layer, int instances, glm::vec2 centre = glm::vec2(0.0f));
+	//clears the bound layer framebuffer and sets the same viewport as drawEccentricityLayer, for layers drawn in more than one call
+	void beginEccentricityLayer(int* resolutions, int* sizes, int layer, glm::vec2 centre = glm::vec2(0.0f));
+	//draws the full screen quad that the eccentricity layers are blended on, textures are bound to units 0..numLayers-1 using
+	//textureTarget (GL_TEXTURE_2D, or GL_TEXTURE_2D_MULTISAMPLE when the blending shader resolves them itself)
+	void blendLayers(Shader& blendingShader, unsigned int textureTarget, unsigned int* textures, int numLayers, unsigned int quadVAO);
 
 	//loads the texture from the path and returns the id of the openGL texture object created for it, will check though the
 	//loaded textures beforehand to avoid reloading the same texture multiple times
 	static unsigned int loadTexture(const char* path, std::string directory);
+	//imports the meshes of a model file without uploading anything, so it works without an openGL context (eg for the software
+	//rasterizer). directory is set to where the model's textures are
+	static bool importMeshData(const char* path, std::vector<MeshData>& meshes, std::string& directory);
 private:
 	std::vector<Mesh> meshes;
-	Mesh processMesh(aiMesh* mesh, const aiScene* scene);
+	glm::vec3 boundsMin = glm::vec3(0.0f), boundsMax = glm::vec3(0.0f);
+	bool hasBounds = false;
+	//grows the bounds to cover a mesh before it is uploaded, meshes keep no CPU copy of their vertices afterwards
+	void includeInBounds(const std::vector<Vertex>& vertices);
+	ImportStats importStats;
+	//loads the mesh's textures and uploads it
+	Mesh processMesh(MeshData& data);
+	//converts every mesh of the scene on a temporary pool using every core, returning how many threads were used
+	static int convertMeshes(const aiScene* scene, std::vector<MeshData>& meshes, ImportStats& stats);
+	static MeshData convertMesh(aiMesh* mesh, const aiScene* scene, ImportStats& stats);
 
 	static std::vector<Texture> loadedTextures;
+	//whether cooked textures are BC compressed, decided once the GL context is available
+	static bool compressTextures;
 	std::string directory;
+
+	// ----- ASYNCHRONOUS LOADING -----
+	void loadAsync(std::string path);
+	void requestTexture(const std::string& path);
+	//id of the texture for path, creating it with a single placeholder texel of the given colour if it isn't loaded yet
+	unsigned int textureSlot(const std::string& path, glm::vec3 placeholder);
+	void uploadTexture(TextureData& texture);
+
+	//filled by the loading threads, drained by update()
+	mutable std::mutex readyMutex;
+	std::deque<MeshData> readyMeshes;
+	std::deque<TextureData> readyTextures;
+	std::vector<std::string> requestedTextures;
+	//loading tasks submitted but not finished, so isLoaded() can tell an empty queue from a finished load
+	std::atomic<int> pendingTasks;
+	GLBuffer uploadPBO;
+	bool loadReported = false;
+
+	//declared last so it is destroyed (joining the loading threads) before anything they write to
+	std::unique_ptr<ThreadPool> loadingPool;
 };
\ No newline at end of file
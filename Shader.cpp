@@ -1,14 +1,46 @@
 #include "shader.h"
 
 #include <glad/glad.h> // include glad to get all the required OpenGL headers
+#include <GLFW/glfw3.h>
+#include "Profiler.h"
 
+#include <cstdint>
+#include <cstdio>
 #include <string>
 #include <fstream>
 #include <iostream>
 #include <sstream>
+#ifdef _WIN32
+#include <direct.h>
+#else
+#include <sys/stat.h>
+#endif
 
 using namespace std;
 
+//program binaries are core from 4.1 and parallel compilation is an extension, so their enums and functions are looked up here
+//rather than relying on the glad loader having been generated with them
+#define PROGRAM_BINARY_RETRIEVABLE_HINT 0x8257
+#define PROGRAM_BINARY_LENGTH 0x8741
+#define NUM_PROGRAM_BINARY_FORMATS 0x87FE
+#define MAX_SHADER_COMPILER_THREADS 0x91B0
+
+typedef void (APIENTRYP GetProgramBinaryProc)(GLuint program, GLsizei bufSize, GLsizei* length, GLenum* binaryFormat, void* binary);
+typedef void (APIENTRYP ProgramBinaryProc)(GLuint program, GLenum binaryFormat, const void* binary, GLsizei length);
+typedef void (APIENTRYP ProgramParameteriProc)(GLuint program, GLenum pname, GLint value);
+typedef void (APIENTRYP MaxShaderCompilerThreadsProc)(GLuint count);
+
+static struct {
+	bool enabled = false;
+	string directory;
+	string driver; // vendor, renderer and version, binaries from any other driver are useless
+	GetProgramBinaryProc getProgramBinary = NULL;
+	ProgramBinaryProc programBinary = NULL;
+	ProgramParameteriProc programParameteri = NULL;
+} programCache;
+
+static const uint32_t PROGRAM_CACHE_MAGIC = 0x4E494250; // "PBIN"
+
 enum class check {
 	VERTEX,
 	FRAGMENT,
@@ -57,72 +89,219 @@ void logSuccess(unsigned int objectID, check type) {
 	}
 }
 
-Shader::Shader(const char* vertexPath, const char* fragmentPath) {
-	string vertexString = readFile(vertexPath);
-	string fragmentString = readFile(fragmentPath);
+//#version has to be the first thing in a shader, so defines go on the line after it
+string insertDefines(const string& source, const vector<string>& defines) {
+	if (defines.empty()) {
+		return source;
+	}
+	string defineBlock;
+	for (const string& define : defines) {
+		defineBlock += "#define " + define + "\n";
+	}
+	size_t versionLine = source.find("#version");
+	if (versionLine == string::npos) {
+		return defineBlock + source;
+	}
+	size_t insertAt = source.find('\n', versionLine);
+	if (insertAt == string::npos) {
+		return source + "\n" + defineBlock;
+	}
+	return source.substr(0, insertAt + 1) + defineBlock + source.substr(insertAt + 1);
+}
+
+//64 bit FNV-1a
+static uint64_t hashString(const string& s, uint64_t hash = 14695981039346656037ULL) {
+	for (unsigned char c : s) {
+		hash ^= c;
+		hash *= 1099511628211ULL;
+	}
+	return hash;
+}
+
+static string cachePath(uint64_t key) {
+	char name[32];
+	snprintf(name, sizeof(name), "%016llx.bin", (unsigned long long)key);
+	return programCache.directory + "/" + name;
+}
+
+void Shader::enableProgramCache(const char* directory) {
+	GLint numFormats = 0;
+	glGetIntegerv(NUM_PROGRAM_BINARY_FORMATS, &numFormats);
+	programCache.getProgramBinary = (GetProgramBinaryProc)glfwGetProcAddress("glGetProgramBinary");
+	programCache.programBinary = (ProgramBinaryProc)glfwGetProcAddress("glProgramBinary");
+	programCache.programParameteri = (ProgramParameteriProc)glfwGetProcAddress("glProgramParameteri");
+	if (numFormats == 0 || !programCache.getProgramBinary || !programCache.programBinary || !programCache.programParameteri) {
+		cout << "Program binaries not supported by the driver, shaders will be compiled every run" << endl;
+	}
+	else {
+		programCache.enabled = true;
+		programCache.directory = directory;
+		programCache.driver = string((const char*)glGetString(GL_VENDOR)) + "|" + (const char*)glGetString(GL_RENDERER) + "|" + (const char*)glGetString(GL_VERSION);
+#ifdef _WIN32
+		_mkdir(directory);
+#else
+		mkdir(directory, 0755);
+#endif
+	}
+
+	//let the driver use as many threads as it likes for compiling and linking programs in the background
+	MaxShaderCompilerThreadsProc maxThreads = (MaxShaderCompilerThreadsProc)glfwGetProcAddress("glMaxShaderCompilerThreadsKHR");
+	if (!maxThreads) {
+		maxThreads = (MaxShaderCompilerThreadsProc)glfwGetProcAddress("glMaxShaderCompilerThreadsARB");
+	}
+	if (maxThreads) {
+		maxThreads(0xFFFFFFFF);
+	}
+}
+
+Shader::Shader(const char* vertexPath, const char* fragmentPath, const vector<string>& defines) {
+	TRACE_FUNCTION();
+	string vertexString = insertDefines(readFile(vertexPath), defines);
+	string fragmentString = insertDefines(readFile(fragmentPath), defines);
 	const char* vertexShaderCode = vertexString.c_str();
 	const char* fragmentShaderCode = fragmentString.c_str();
 
+	shaderProgram = GLProgram::create();
+
+	if (programCache.enabled) {
+		//defines are already part of the sources
+		cacheKey = hashString(programCache.driver, hashString(fragmentString + '\0', hashString(vertexString + '\0')));
+		ifstream file(cachePath(cacheKey), ios::binary);
+		uint32_t magic = 0, format = 0;
+		uint64_t key = 0;
+		file.read((char*)&magic, sizeof(magic));
+		file.read((char*)&format, sizeof(format));
+		file.read((char*)&key, sizeof(key));
+		if (file && magic == PROGRAM_CACHE_MAGIC && key == cacheKey) {
+			vector<char> binary((istreambuf_iterator<char>(file)), istreambuf_iterator<char>());
+			programCache.programBinary(shaderProgram.id(), format, binary.data(), (GLsizei)binary.size());
+			//drivers reject binaries after updates (or for any other reason they like), in which case just compile as normal
+			int success = 0;
+			glGetProgramiv(shaderProgram.id(), GL_LINK_STATUS, &success);
+			if (success) {
+				fromCache = true;
+				linkChecked = true;
+				return;
+			}
+		}
+	}
+
 	//Compile shaders
-	unsigned int vertexShader = glCreateShader(GL_VERTEX_SHADER);
+	vertexShader = glCreateShader(GL_VERTEX_SHADER);
 	glShaderSource(vertexShader, 1, &vertexShaderCode, NULL);
 	glCompileShader(vertexShader);
-	logSuccess(vertexShader, check::VERTEX);
 
-	unsigned int fragmentShader = glCreateShader(GL_FRAGMENT_SHADER);
+	fragmentShader = glCreateShader(GL_FRAGMENT_SHADER);
 	glShaderSource(fragmentShader, 1, &fragmentShaderCode, NULL);
 	glCompileShader(fragmentShader);
-	logSuccess(fragmentShader, check::FRAGMENT);
 
 	//link shaders with shader program
-	shaderProgram = glCreateProgram();
-	glAttachShader(shaderProgram, vertexShader);
-	glAttachShader(shaderProgram, fragmentShader);
-	glLinkProgram(shaderProgram);
-	logSuccess(shaderProgram, check::SHADER);
+	glAttachShader(shaderProgram.id(), vertexShader);
+	glAttachShader(shaderProgram.id(), fragmentShader);
+	if (programCache.enabled) {
+		programCache.programParameteri(shaderProgram.id(), PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+	}
+	glLinkProgram(shaderProgram.id());
 
+	//only flagged for deletion while still attached, so they (and their info logs) stay around until the program is deleted
 	glDeleteShader(vertexShader);
 	glDeleteShader(fragmentShader);
 }
 
+void Shader::finishLinking() const {
+	TRACE_FUNCTION();
+	linkChecked = true;
+
+	int success;
+	glGetProgramiv(shaderProgram.id(), GL_LINK_STATUS, &success);
+	if (!success) {
+		logSuccess(vertexShader, check::VERTEX);
+		logSuccess(fragmentShader, check::FRAGMENT);
+		logSuccess(shaderProgram.id(), check::SHADER);
+		return;
+	}
+
+	if (programCache.enabled && !fromCache) {
+		GLint length = 0;
+		glGetProgramiv(shaderProgram.id(), PROGRAM_BINARY_LENGTH, &length);
+		if (length > 0) {
+			vector<char> binary(length);
+			GLenum format;
+			programCache.getProgramBinary(shaderProgram.id(), length, &length, &format, binary.data());
+
+			ofstream file(cachePath(cacheKey), ios::binary);
+			uint32_t magic = PROGRAM_CACHE_MAGIC, format32 = format;
+			uint64_t key = cacheKey;
+			file.write((const char*)&magic, sizeof(magic));
+			file.write((const char*)&format32, sizeof(format32));
+			file.write((const char*)&key, sizeof(key));
+			file.write(binary.data(), length);
+			if (!file) {
+				cout << "Failed to write program cache file: " << cachePath(cacheKey) << endl;
+			}
+		}
+	}
+}
+
 void Shader::use() const {
-	glUseProgram(shaderProgram);
+	if (!linkChecked) {
+		finishLinking();
+	}
+	glUseProgram(shaderProgram.id());
 }
 
 int Shader::getAttributeLocation(const char* attribute) const {
-	return glGetAttribLocation(shaderProgram, attribute);
+	if (!linkChecked) {
+		finishLinking();
+	}
+	return glGetAttribLocation(shaderProgram.id(), attribute);
 }
 
 void Shader::setFloat(const char* name, float value) const {
-	glUniform1f(glGetUniformLocation(shaderProgram, name), value);
+	TRACE_SCOPE_DETAIL("Shader::setFloat");
+	glUniform1f(glGetUniformLocation(shaderProgram.id(), name), value);
 }
 
 void Shader::setInt(const char* name, int value) const {
-	glUniform1i(glGetUniformLocation(shaderProgram, name), value);
+	TRACE_SCOPE_DETAIL("Shader::setInt");
+	glUniform1i(glGetUniformLocation(shaderProgram.id(), name), value);
 }
 
 void Shader::setMat4f(const char* name, const float* value) const {
-	glUniformMatrix4fv(glGetUniformLocation(shaderProgram, name), 1, GL_FALSE, value);
+	TRACE_SCOPE_DETAIL("Shader::setMat4f");
+	glUniformMatrix4fv(glGetUniformLocation(shaderProgram.id(), name), 1, GL_FALSE, value);
 }
 
 void Shader::setMat3f(const char* name, const float* value) const {
-	glUniformMatrix3fv(glGetUniformLocation(shaderProgram, name), 1, GL_FALSE, value);
+	TRACE_SCOPE_DETAIL("Shader::setMat3f");
+	glUniformMatrix3fv(glGetUniformLocation(shaderProgram.id(), name), 1, GL_FALSE, value);
 }
 
 void Shader::setVec2f(const char* name, const glm::vec2& value) const {
-	glUniform2fv(glGetUniformLocation(shaderProgram, name), 1, &value[0]);
+	TRACE_SCOPE_DETAIL("Shader::setVec2f");
+	glUniform2fv(glGetUniformLocation(shaderProgram.id(), name), 1, &value[0]);
 }
 
 void Shader::setVec3f(const char* name, const glm::vec3& value) const {
-	glUniform3fv(glGetUniformLocation(shaderProgram, name), 1, &value[0]);
+	TRACE_SCOPE_DETAIL("Shader::setVec3f");
+	glUniform3fv(glGetUniformLocation(shaderProgram.id(), name), 1, &value[0]);
 }
 
 void Shader::setVec4f(const char* name, const glm::vec4& value) const {
-	glUniform4fv(glGetUniformLocation(shaderProgram, name), 1, &value[0]);
+	TRACE_SCOPE_DETAIL("Shader::setVec4f");
+	glUniform4fv(glGetUniformLocation(shaderProgram.id(), name), 1, &value[0]);
 }
 
 void Shader::setBool(const char* name, bool value) const {
+	TRACE_SCOPE_DETAIL("Shader::setBool");
 	//no glUniform1b, so set as an int - in this case zeros are converted to false and non-zeroes to true
 	//this means using C++'s casting of bools to ints will work fine
-	glUniform1i(glGetUniformLocation(shaderProgram, name), value);
+	glUniform1i(glGetUniformLocation(shaderProgram.id(), name), value);
+}
+
+void Shader::setUniformBlock(const char* name, unsigned int binding) const {
+	GLuint index = glGetUniformBlockIndex(shaderProgram.id(), name);
+	if (index != GL_INVALID_INDEX) {
+		glUniformBlockBinding(shaderProgram.id(), index, binding);
+	}
 }
\ No newline at end of file
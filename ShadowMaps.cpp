@@ -0,0 +1,149 @@
+#include <glad/glad.h>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "ShadowMaps.h"
+#include "Scene.h"
+#include "Profiler.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+
+bool ShadowMaps::View::operator==(const View& other) const {
+	return std::memcmp(&view, &other.view, sizeof(view)) == 0 && std::memcmp(&projection, &other.projection, sizeof(projection)) == 0 &&
+		centre == other.centre && halfSize == other.halfSize;
+}
+
+ShadowMaps::ShadowMaps(float maxDistance, float casterDepth) :
+	shader("shadowVertexShader.gl", "shadowFragmentShader.gl"),
+	maxDistance(maxDistance),
+	casterDepth(casterDepth) {
+}
+
+void ShadowMaps::setLightDirection(const glm::vec3& direction) {
+	lightDirection = glm::normalize(direction);
+	for (Map& map : maps) {
+		map.drawn = false;
+	}
+}
+
+void ShadowMaps::setLayers(const int* resolutions, int numLayers) {
+	maps.clear();
+	maps.resize(numLayers);
+	for (int i = 0; i < numLayers; i++) {
+		Map& map = maps[i];
+		map.resolution = resolutions[i];
+		map.texture = GLTexture::create();
+		glBindTexture(GL_TEXTURE_2D, map.texture.id());
+		glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH_COMPONENT24, map.resolution, map.resolution, 0, GL_DEPTH_COMPONENT, GL_FLOAT, NULL);
+		//compared in hardware, so even a single tap is filtered over 2x2 texels
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_COMPARE_MODE, GL_COMPARE_REF_TO_TEXTURE);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_COMPARE_FUNC, GL_LEQUAL);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+		//anything outside the map is lit
+		float border[] = { 1.0f, 1.0f, 1.0f, 1.0f };
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_BORDER);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_BORDER);
+		glTexParameterfv(GL_TEXTURE_2D, GL_TEXTURE_BORDER_COLOR, border);
+		map.texture.setBytes(GPUMemoryCategory::RENDER_TARGETS, (size_t)map.resolution * map.resolution * 4);
+
+		map.framebuffer = GLFramebuffer::create();
+		glBindFramebuffer(GL_FRAMEBUFFER, map.framebuffer.id());
+		glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, map.texture.id(), 0);
+		glDrawBuffer(GL_NONE);
+		glReadBuffer(GL_NONE);
+		if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+			std::cout << "Shadow map framebuffer " << i << " is incomplete" << std::endl;
+		}
+	}
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+}
+
+void ShadowMaps::draw(int layer, Scene& scene, const View& view, int instances) {
+	TRACE_FUNCTION();
+	if (layer >= (int)maps.size()) {
+		std::cout << "No shadow map for layer " << layer << ", only " << maps.size() << " were created" << std::endl;
+		return;
+	}
+	Map& map = maps[layer];
+	map.lightViewProjection = fit(view, map.resolution);
+	map.fittedTo = view;
+	map.drawn = true;
+
+	glBindFramebuffer(GL_FRAMEBUFFER, map.framebuffer.id());
+	glViewport(0, 0, map.resolution, map.resolution);
+	glClear(GL_DEPTH_BUFFER_BIT);
+	//slope scaled offset rather than a bias in the shaders, so coarser maps get a proportionally larger one
+	glEnable(GL_POLYGON_OFFSET_FILL);
+	glPolygonOffset(2.0f, 4.0f);
+	shader.use();
+	shader.setMat4f("lightViewProjection", &map.lightViewProjection[0][0]);
+	scene.draw(shader, instances);
+	glDisable(GL_POLYGON_OFFSET_FILL);
+}
+
+bool ShadowMaps::isCurrent(int layer, const View& view) const {
+	return layer < (int)maps.size() && maps[layer].drawn && maps[layer].fittedTo == view;
+}
+
+bool ShadowMaps::bind(int layer, const Shader& target, int textureUnit) const {
+	if (layer >= (int)maps.size() || !maps[layer].drawn) {
+		target.setBool("shadowsEnabled", false);
+		return false;
+	}
+	const Map& map = maps[layer];
+	glActiveTexture(GL_TEXTURE0 + textureUnit);
+	glBindTexture(GL_TEXTURE_2D, map.texture.id());
+	//from world space to the map's texture coordinates and depth
+	glm::mat4 toTexture = glm::scale(glm::translate(glm::mat4(1.0f), glm::vec3(0.5f)), glm::vec3(0.5f));
+	glm::mat4 shadowMatrix = toTexture * map.lightViewProjection;
+	target.setInt("shadowMap", textureUnit);
+	target.setMat4f("shadowMatrix", &shadowMatrix[0][0]);
+	target.setBool("shadowsEnabled", true);
+	return true;
+}
+
+glm::mat4 ShadowMaps::fit(const View& view, int resolution) const {
+	//corners of the part of the view frustum the layer covers, out to maxDistance
+	glm::mat4 inverseProjection = glm::inverse(view.projection);
+	glm::mat4 inverseView = glm::inverse(view.view);
+	float x[2] = { std::max(-1.0f, view.centre.x - view.halfSize.x), std::min(1.0f, view.centre.x + view.halfSize.x) };
+	float y[2] = { std::max(-1.0f, view.centre.y - view.halfSize.y), std::min(1.0f, view.centre.y + view.halfSize.y) };
+	glm::vec3 corners[8];
+	int numCorners = 0;
+	for (int i = 0; i < 2; i++) {
+		for (int j = 0; j < 2; j++) {
+			glm::vec4 nearPoint = inverseProjection * glm::vec4(x[i], y[j], -1.0f, 1.0f);
+			glm::vec4 farPoint = inverseProjection * glm::vec4(x[i], y[j], 1.0f, 1.0f);
+			glm::vec3 a = glm::vec3(nearPoint) / nearPoint.w, b = glm::vec3(farPoint) / farPoint.w;
+			//depth is linear along the ray, so the far corner is moved in to maxDistance
+			float t = std::min(1.0f, (maxDistance + a.z) / (a.z - b.z));
+			corners[numCorners++] = glm::vec3(inverseView * glm::vec4(a, 1.0f));
+			corners[numCorners++] = glm::vec3(inverseView * glm::vec4(a + (b - a) * t, 1.0f));
+		}
+	}
+
+	//a bounding sphere keeps the map the same size however the view turns
+	glm::vec3 centre(0.0f);
+	for (const glm::vec3& corner : corners) {
+		centre += corner;
+	}
+	centre *= 1.0f / numCorners;
+	float radius = 0.0f;
+	for (const glm::vec3& corner : corners) {
+		radius = std::max(radius, glm::length(corner - centre));
+	}
+
+	glm::vec3 up = std::fabs(lightDirection.y) > 0.99f ? glm::vec3(0.0f, 0.0f, 1.0f) : glm::vec3(0.0f, 1.0f, 0.0f);
+	glm::mat4 lightView = glm::lookAt(glm::vec3(0.0f), lightDirection, up);
+	glm::vec3 lightCentre = glm::vec3(lightView * glm::vec4(centre, 1.0f));
+	//only ever moved by whole texels, so the texels covering static geometry stay the same
+	float texel = 2.0f * radius / resolution;
+	lightCentre.x = std::floor(lightCentre.x / texel) * texel;
+	lightCentre.y = std::floor(lightCentre.y / texel) * texel;
+	glm::mat4 projection = glm::ortho(lightCentre.x - radius, lightCentre.x + radius, lightCentre.y - radius, lightCentre.y + radius,
+		-lightCentre.z - radius - casterDepth, -lightCentre.z + radius);
+	return projection * lightView;
+}
@@ -0,0 +1,68 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include <vector>
+#include "GLResource.h"
+#include "shader.h"
+
+class Scene;
+
+//Shadow maps for the global (directional) light, one per eccentricity layer. Each map is fitted only to the part of the view its
+//layer covers, out to a maximum distance, so the small fovea layer gets a map whose texels are much denser than one map for the
+//whole view could afford while peripheral layers get coarse ones. Maps are fitted to a bounding sphere of that part of the view,
+//snapped to whole texels, so they don't shimmer as the camera turns. When a map is redrawn (and how it is filtered) is left to the
+//caller, the layers sample whatever was last drawn
+class ShadowMaps {
+public:
+	//the part of a camera's view that a layer covers, which its map is fitted to
+	struct View {
+		glm::mat4 view = glm::mat4(1.0f);
+		glm::mat4 projection = glm::mat4(1.0f);
+		glm::vec2 centre = glm::vec2(0.0f); // normalised device coordinates
+		glm::vec2 halfSize = glm::vec2(1.0f); // normalised device coordinates
+
+		bool operator==(const View& other) const;
+	};
+
+	//maxDistance is how far from the camera shadows are drawn, casterDepth how far towards the light outside the view geometry
+	//can still cast a shadow into it
+	ShadowMaps(float maxDistance, float casterDepth);
+	ShadowMaps(const ShadowMaps&) = delete;
+	ShadowMaps& operator=(const ShadowMaps&) = delete;
+
+	//depth only shader the maps are drawn with, which needs the model matrices like the main shader
+	Shader& getShader() {
+		return shader;
+	}
+	//direction the light shines in, world space
+	void setLightDirection(const glm::vec3& direction);
+	//(re)creates a map of resolutions[i] x resolutions[i] texels for each layer, none of which is drawn yet
+	void setLayers(const int* resolutions, int numLayers);
+
+	//draws the layer's map, fitted to view, into its own framebuffer (which is left bound). Does nothing for a layer setLayers()
+	//didn't create a map for
+	void draw(int layer, Scene& scene, const View& view, int instances);
+	//whether the layer's map has been drawn, fitted to exactly this view
+	bool isCurrent(int layer, const View& view) const;
+	//binds the layer's map to textureUnit and sets shadowMap, shadowMatrix and shadowsEnabled on the shader (which must be in
+	//use), returning false and disabling shadows if it hasn't been drawn yet
+	bool bind(int layer, const Shader& target, int textureUnit) const;
+
+private:
+	struct Map {
+		GLTexture texture;
+		GLFramebuffer framebuffer;
+		int resolution = 0;
+		bool drawn = false;
+		View fittedTo;
+		glm::mat4 lightViewProjection = glm::mat4(1.0f);
+	};
+
+	Shader shader;
+	std::vector<Map> maps;
+	glm::vec3 lightDirection = glm::vec3(0.0f, -1.0f, 0.0f);
+	float maxDistance, casterDepth;
+
+	//light view-projection covering view with whole texels of a map resolution texels across
+	glm::mat4 fit(const View& view, int resolution) const;
+};
@@ -0,0 +1,78 @@
+#pragma once
+
+#include <cmath>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#endif
+
+//One SIMD register of floats, picked at compile time from the instruction sets the build targets (8 lanes with AVX2, 4 with SSE,
+//otherwise a single float). Kernels are written once against this and process Lanes::WIDTH elements per step
+#if defined(__AVX2__)
+struct Lanes {
+	static const int WIDTH = 8;
+	__m256 v;
+	static Lanes load(const float* p) { return { _mm256_loadu_ps(p) }; }
+	static Lanes set(float x) { return { _mm256_set1_ps(x) }; }
+	void store(float* p) const { _mm256_storeu_ps(p, v); }
+};
+inline Lanes operator+(Lanes a, Lanes b) { return { _mm256_add_ps(a.v, b.v) }; }
+inline Lanes operator-(Lanes a, Lanes b) { return { _mm256_sub_ps(a.v, b.v) }; }
+inline Lanes operator*(Lanes a, Lanes b) { return { _mm256_mul_ps(a.v, b.v) }; }
+inline Lanes operator/(Lanes a, Lanes b) { return { _mm256_div_ps(a.v, b.v) }; }
+//a * b + c
+inline Lanes madd(Lanes a, Lanes b, Lanes c) {
+#ifdef __FMA__
+	return { _mm256_fmadd_ps(a.v, b.v, c.v) };
+#else
+	return a * b + c;
+#endif
+}
+inline Lanes abs(Lanes a) { return { _mm256_andnot_ps(_mm256_set1_ps(-0.0f), a.v) }; }
+inline Lanes min(Lanes a, Lanes b) { return { _mm256_min_ps(a.v, b.v) }; }
+//sum of every lane
+inline float hsum(Lanes a) {
+	__m128 s = _mm_add_ps(_mm256_castps256_ps128(a.v), _mm256_extractf128_ps(a.v, 1));
+	s = _mm_add_ps(s, _mm_movehl_ps(s, s));
+	s = _mm_add_ss(s, _mm_shuffle_ps(s, s, 1));
+	return _mm_cvtss_f32(s);
+}
+#elif defined(__SSE2__) || defined(_M_X64)
+struct Lanes {
+	static const int WIDTH = 4;
+	__m128 v;
+	static Lanes load(const float* p) { return { _mm_loadu_ps(p) }; }
+	static Lanes set(float x) { return { _mm_set1_ps(x) }; }
+	void store(float* p) const { _mm_storeu_ps(p, v); }
+};
+inline Lanes operator+(Lanes a, Lanes b) { return { _mm_add_ps(a.v, b.v) }; }
+inline Lanes operator-(Lanes a, Lanes b) { return { _mm_sub_ps(a.v, b.v) }; }
+inline Lanes operator*(Lanes a, Lanes b) { return { _mm_mul_ps(a.v, b.v) }; }
+inline Lanes operator/(Lanes a, Lanes b) { return { _mm_div_ps(a.v, b.v) }; }
+inline Lanes madd(Lanes a, Lanes b, Lanes c) { return a * b + c; }
+inline Lanes abs(Lanes a) { return { _mm_andnot_ps(_mm_set1_ps(-0.0f), a.v) }; }
+inline Lanes min(Lanes a, Lanes b) { return { _mm_min_ps(a.v, b.v) }; }
+inline float hsum(Lanes a) {
+	__m128 s = _mm_add_ps(a.v, _mm_movehl_ps(a.v, a.v));
+	s = _mm_add_ss(s, _mm_shuffle_ps(s, s, 1));
+	return _mm_cvtss_f32(s);
+}
+#else
+struct Lanes {
+	static const int WIDTH = 1;
+	float v;
+	static Lanes load(const float* p) { return { *p }; }
+	static Lanes set(float x) { return { x }; }
+	void store(float* p) const { *p = v; }
+};
+inline Lanes operator+(Lanes a, Lanes b) { return { a.v + b.v }; }
+inline Lanes operator-(Lanes a, Lanes b) { return { a.v - b.v }; }
+inline Lanes operator*(Lanes a, Lanes b) { return { a.v * b.v }; }
+inline Lanes operator/(Lanes a, Lanes b) { return { a.v / b.v }; }
+inline Lanes madd(Lanes a, Lanes b, Lanes c) { return { a.v * b.v + c.v }; }
+inline Lanes abs(Lanes a) { return { std::fabs(a.v) }; }
+inline Lanes min(Lanes a, Lanes b) { return { a.v < b.v ? a.v : b.v }; }
+inline float hsum(Lanes a) { return a.v; }
+#endif
\ No newline at end of file
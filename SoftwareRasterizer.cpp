@@ -0,0 +1,438 @@
+#include "SoftwareRasterizer.h"
+#include "Scene.h"
+#include "SimdLanes.h"
+#include "Profiler.h"
+#include "stb_image.h"
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+
+namespace {
+	//pixel centres of one SIMD step, relative to its first pixel
+	const float LANE_OFFSETS[8] = { 0.5f, 1.5f, 2.5f, 3.5f, 4.5f, 5.5f, 6.5f, 7.5f };
+	const float BLENDING_CUTOFF = 0.6f; // as in blendingFragmentShader.gl
+	const int VERTEX_GRAIN = 16384;
+
+	float smoothstep(float edge0, float edge1, float x) {
+		float t = std::min(1.0f, std::max(0.0f, (x - edge0) / (edge1 - edge0)));
+		return t * t * (3.0f - 2.0f * t);
+	}
+
+	//bilinear and clamped to the edge, like the sampler of the layer textures
+	glm::vec3 sampleBilinear(const std::vector<unsigned char>& rgba, int width, int height, glm::vec2 uv) {
+		float fx = uv.x * width - 0.5f, fy = uv.y * height - 0.5f;
+		int x0 = (int)std::floor(fx), y0 = (int)std::floor(fy);
+		float tx = fx - x0, ty = fy - y0;
+		glm::vec3 texels[4];
+		for (int i = 0; i < 4; i++) {
+			int x = std::min(width - 1, std::max(0, x0 + (i & 1)));
+			int y = std::min(height - 1, std::max(0, y0 + (i >> 1)));
+			const unsigned char* p = &rgba[4 * ((size_t)y * width + x)];
+			texels[i] = glm::vec3(p[0], p[1], p[2]);
+		}
+		glm::vec3 bottom = texels[0] * (1.0f - tx) + texels[1] * tx;
+		glm::vec3 top = texels[2] * (1.0f - tx) + texels[3] * tx;
+		return (bottom * (1.0f - ty) + top * ty) / 255.0f;
+	}
+
+	void writePixel(unsigned char* out, const glm::vec3& colour) {
+		for (int c = 0; c < 3; c++) {
+			out[c] = (unsigned char)(std::min(1.0f, std::max(0.0f, colour[c])) * 255.0f + 0.5f);
+		}
+		out[3] = 255;
+	}
+}
+
+//the calling thread works through parallel loops too
+SoftwareRasterizer::SoftwareRasterizer(int numThreads) : pool(std::max(0, numThreads - 1)) {
+}
+
+bool SoftwareRasterizer::load(const char* scenePath) {
+	std::vector<MeshData> meshes;
+	if (!Scene::importMeshData(scenePath, meshes, directory)) {
+		return false;
+	}
+	positions.clear();
+	normals.clear();
+	texCoords.clear();
+	indices.clear();
+	triangleMeshes.clear();
+	materials.clear();
+	textures.clear();
+	texturePaths.clear();
+
+	//every mesh goes into one vertex array, so a triangle's vertices can be found from its index alone
+	for (int m = 0; m < meshes.size(); m++) {
+		const MeshData& mesh = meshes[m];
+		unsigned int firstVertex = (unsigned int)positions.size();
+		for (const Vertex& vertex : mesh.vertices) {
+			positions.push_back(vertex.position);
+			normals.push_back(vertex.normal);
+			texCoords.push_back(vertex.texCoords);
+		}
+		for (size_t i = 0; i + 2 < mesh.indices.size(); i += 3) {
+			for (int k = 0; k < 3; k++) {
+				indices.push_back(firstVertex + mesh.indices[i + k]);
+			}
+			triangleMeshes.push_back(m);
+		}
+
+		MeshMaterial material = { mesh.material.colour, mesh.material.shininess, -1, -1 };
+		if (mesh.material.diffuseEnabled && !mesh.diffusePath.empty()) {
+			material.diffuseTexture = addTexture(mesh.diffusePath);
+		}
+		if (mesh.material.specularEnabled && !mesh.specularPath.empty()) {
+			material.specularTexture = addTexture(mesh.specularPath);
+		}
+		materials.push_back(material);
+	}
+	std::cout << "Software rasterizer: " << triangleMeshes.size() << " triangles, " << textures.size() << " textures" << std::endl;
+	return true;
+}
+
+int SoftwareRasterizer::addTexture(const std::string& path) {
+	for (int i = 0; i < texturePaths.size(); i++) {
+		if (texturePaths[i] == path) {
+			return i;
+		}
+	}
+	std::string fullPath = directory + "\\" + path;
+	Texture texture;
+	unsigned char* data = stbi_load(fullPath.c_str(), &texture.width, &texture.height, &texture.channels, 0);
+	if (!data) {
+		//drawn in the material's colour instead
+		std::cout << "Failed to load texture at path: " << fullPath << std::endl;
+		return -1;
+	}
+	texture.pixels.assign(data, data + (size_t)texture.width * texture.height * texture.channels);
+	stbi_image_free(data);
+	textures.push_back(std::move(texture));
+	texturePaths.push_back(path);
+	return (int)textures.size() - 1;
+}
+
+void SoftwareRasterizer::setInstances(const std::vector<glm::mat4>& instanceModels) {
+	models = instanceModels;
+	normalMatrices.clear();
+	for (const glm::mat4& model : models) {
+		normalMatrices.push_back(glm::transpose(glm::inverse(glm::mat3(model))));
+	}
+}
+
+void SoftwareRasterizer::setLighting(const SoftwareLighting& newLighting) {
+	lighting = newLighting;
+}
+
+void SoftwareRasterizer::draw(const glm::mat4& VP, const glm::vec3& camPos, int width, int height, std::vector<unsigned char>& image) {
+	layers.resize(1);
+	layers[0].width = width;
+	layers[0].height = height;
+	layers[0].scale = glm::vec2(1.0f);
+	render(VP, camPos);
+	image = layers[0].colour;
+}
+
+void SoftwareRasterizer::drawFoveated(const glm::mat4& VP, const glm::vec3& camPos, int width, int height, const int* sizes, const int* resolutions, int numLayers, std::vector<unsigned char>& image) {
+	layers.resize(numLayers);
+	for (int i = 0; i < numLayers; i++) {
+		layers[i].width = resolutions[2 * i];
+		layers[i].height = resolutions[2 * i + 1];
+		//same magnification as the viewport Scene::drawEccentricityLayer sets
+		layers[i].scale = glm::vec2((float)width / sizes[2 * i], (float)height / sizes[2 * i + 1]);
+	}
+	render(VP, camPos);
+
+	//port of blendingFragmentShader.gl, with the boundaries set_blending_layers gives it
+	TRACE_SCOPE("blend");
+	image.resize((size_t)width * height * 4);
+	pool.parallelFor(height, 16, [&](int begin, int end) {
+		for (int y = begin; y < end; y++) {
+			for (int x = 0; x < width; x++) {
+				glm::vec2 uv((x + 0.5f) / width, (y + 0.5f) / height);
+				glm::vec3 colour = sampleBilinear(layers[0].colour, layers[0].width, layers[0].height, uv);
+				float r = glm::length(glm::vec2((uv.x - 0.5f) * width, (uv.y - 0.5f) * height));
+				for (int i = 1; i < numLayers; i++) {
+					glm::vec2 lower((float)(width - sizes[2 * i]) / (2 * width), (float)(height - sizes[2 * i + 1]) / (2 * height));
+					glm::vec2 upper((float)(width + sizes[2 * i]) / (2 * width), (float)(height + sizes[2 * i + 1]) / (2 * height));
+					float r_i = std::min((upper.x - 0.5f) * width, (upper.y - 0.5f) * height);
+					if (r < r_i) {
+						glm::vec2 layerUv((uv.x - lower.x) / (upper.x - lower.x), (uv.y - lower.y) / (upper.y - lower.y));
+						glm::vec3 layerColour = sampleBilinear(layers[i].colour, layers[i].width, layers[i].height, layerUv);
+						float t = smoothstep(BLENDING_CUTOFF, 1.0f, r / r_i);
+						colour = layerColour * (1.0f - t) + colour * t;
+					}
+				}
+				writePixel(&image[4 * ((size_t)y * width + x)], colour);
+			}
+		}
+	});
+}
+
+void SoftwareRasterizer::render(const glm::mat4& VP, const glm::vec3& camPos) {
+	TRACE_FUNCTION();
+	shadedPixels = 0;
+	transformVertices(VP);
+
+	int numTriangles = (int)(models.size() * triangleMeshes.size());
+	int numChunks = (numTriangles + SETUP_CHUNK - 1) / SETUP_CHUNK;
+	for (Layer& layer : layers) {
+		layer.tilesX = (layer.width + TILE_SIZE - 1) / TILE_SIZE;
+		layer.tilesY = (layer.height + TILE_SIZE - 1) / TILE_SIZE;
+		layer.colour.resize((size_t)layer.width * layer.height * 4);
+		layer.prims.resize(numChunks);
+		layer.bins.resize(numChunks);
+		for (std::vector<std::vector<unsigned int>>& chunkBins : layer.bins) {
+			chunkBins.resize(layer.tilesX * layer.tilesY);
+		}
+	}
+
+	{
+		TRACE_SCOPE("setup");
+		pool.parallelFor(numTriangles, SETUP_CHUNK, [this](int begin, int end) {
+			setupTriangles(begin / SETUP_CHUNK, begin, end);
+		});
+	}
+
+	//every tile of every layer is its own job, so smaller layers simply mean fewer jobs
+	std::vector<std::pair<int, int>> jobs;
+	for (int l = 0; l < layers.size(); l++) {
+		for (int tile = 0; tile < layers[l].tilesX * layers[l].tilesY; tile++) {
+			jobs.push_back(std::make_pair(l, tile));
+		}
+	}
+	{
+		TRACE_SCOPE("rasterise");
+		pool.parallelFor((int)jobs.size(), 1, [&](int begin, int end) {
+			for (int j = begin; j < end; j++) {
+				rasteriseTile(layers[jobs[j].first], jobs[j].second, camPos);
+			}
+		});
+	}
+}
+
+void SoftwareRasterizer::transformVertices(const glm::mat4& VP) {
+	TRACE_FUNCTION();
+	int verticesPerInstance = (int)positions.size();
+	int count = (int)(models.size() * verticesPerInstance);
+	clipPositions.resize(count);
+	worldPositions.resize(count);
+	worldNormals.resize(count);
+	pool.parallelFor(count, VERTEX_GRAIN, [&](int begin, int end) {
+		for (int i = begin; i < end; i++) {
+			int instance = i / verticesPerInstance, vertex = i % verticesPerInstance;
+			glm::vec4 world = models[instance] * glm::vec4(positions[vertex], 1.0f);
+			worldPositions[i] = glm::vec3(world.x, world.y, world.z);
+			clipPositions[i] = VP * world;
+			worldNormals[i] = normalMatrices[instance] * normals[vertex];
+		}
+	});
+}
+
+void SoftwareRasterizer::setupTriangles(int chunk, int begin, int end) {
+	for (Layer& layer : layers) {
+		layer.prims[chunk].clear();
+		for (std::vector<unsigned int>& bin : layer.bins[chunk]) {
+			bin.clear();
+		}
+	}
+
+	const glm::vec3 corners[3] = { glm::vec3(1.0f, 0.0f, 0.0f), glm::vec3(0.0f, 1.0f, 0.0f), glm::vec3(0.0f, 0.0f, 1.0f) };
+	int trianglesPerInstance = (int)triangleMeshes.size();
+	unsigned int verticesPerInstance = (unsigned int)positions.size();
+	for (int t = begin; t < end; t++) {
+		int instance = t / trianglesPerInstance, triangle = t % trianglesPerInstance;
+		unsigned int ids[3];
+		glm::vec4 clip[3];
+		for (int k = 0; k < 3; k++) {
+			ids[k] = instance * verticesPerInstance + indices[3 * triangle + k];
+			clip[k] = clipPositions[ids[k]];
+		}
+
+		//clipped against the near plane (z >= -w) only, which leaves a triangle or a quad. The other planes are handled by
+		//clamping each triangle's bounding box to the layer
+		glm::vec4 polygon[4];
+		glm::vec3 weights[4];
+		int n = 0;
+		for (int k = 0; k < 3; k++) {
+			int next = (k + 1) % 3;
+			float d0 = clip[k].z + clip[k].w, d1 = clip[next].z + clip[next].w;
+			if (d0 >= 0.0f) {
+				polygon[n] = clip[k];
+				weights[n++] = corners[k];
+			}
+			if ((d0 >= 0.0f) != (d1 >= 0.0f)) {
+				float s = d0 / (d0 - d1);
+				polygon[n] = clip[k] + (clip[next] - clip[k]) * s;
+				weights[n++] = corners[k] + (corners[next] - corners[k]) * s;
+			}
+		}
+		if (n < 3) {
+			continue;
+		}
+
+		for (Layer& layer : layers) {
+			for (int fan = 1; fan + 1 < n; fan++) {
+				int polygonCorners[3] = { 0, fan, fan + 1 };
+				Prim prim;
+				glm::vec2 screen[3];
+				for (int k = 0; k < 3; k++) {
+					const glm::vec4& p = polygon[polygonCorners[k]];
+					float invW = 1.0f / p.w;
+					screen[k] = glm::vec2((p.x * layer.scale.x * invW * 0.5f + 0.5f) * layer.width, (p.y * layer.scale.y * invW * 0.5f + 0.5f) * layer.height);
+					prim.z[k] = p.z * invW;
+					prim.invW[k] = invW;
+					prim.weights[k] = weights[polygonCorners[k]];
+					prim.vertices[k] = ids[k];
+				}
+				prim.minX = std::max(0, (int)std::floor(std::min(screen[0].x, std::min(screen[1].x, screen[2].x))));
+				prim.maxX = std::min(layer.width - 1, (int)std::ceil(std::max(screen[0].x, std::max(screen[1].x, screen[2].x))));
+				prim.minY = std::max(0, (int)std::floor(std::min(screen[0].y, std::min(screen[1].y, screen[2].y))));
+				prim.maxY = std::min(layer.height - 1, (int)std::ceil(std::max(screen[0].y, std::max(screen[1].y, screen[2].y))));
+				if (prim.minX > prim.maxX || prim.minY > prim.maxY) {
+					continue;
+				}
+				float area = (screen[1].x - screen[0].x) * (screen[2].y - screen[0].y) - (screen[1].y - screen[0].y) * (screen[2].x - screen[0].x);
+				if (std::fabs(area) < 1e-8f) {
+					continue;
+				}
+				//edge opposite each corner, scaled by the area so the edge functions are the barycentric coordinates. Faces aren't
+				//culled on the GPU either, so both windings are drawn
+				for (int k = 0; k < 3; k++) {
+					const glm::vec2& a = screen[(k + 1) % 3];
+					const glm::vec2& b = screen[(k + 2) % 3];
+					prim.edgeA[k] = -(b.y - a.y) / area;
+					prim.edgeB[k] = (b.x - a.x) / area;
+					prim.edgeC[k] = -(prim.edgeA[k] * a.x + prim.edgeB[k] * a.y);
+				}
+				prim.mesh = triangleMeshes[triangle];
+
+				unsigned int index = (unsigned int)layer.prims[chunk].size();
+				layer.prims[chunk].push_back(prim);
+				for (int ty = prim.minY / TILE_SIZE; ty <= prim.maxY / TILE_SIZE; ty++) {
+					for (int tx = prim.minX / TILE_SIZE; tx <= prim.maxX / TILE_SIZE; tx++) {
+						layer.bins[chunk][ty * layer.tilesX + tx].push_back(index);
+					}
+				}
+			}
+		}
+	}
+}
+
+void SoftwareRasterizer::rasteriseTile(Layer& layer, int tile, const glm::vec3& camPos) {
+	int tileX = (tile % layer.tilesX) * TILE_SIZE, tileY = (tile / layer.tilesX) * TILE_SIZE;
+	int tileWidth = std::min((int)TILE_SIZE, layer.width - tileX), tileHeight = std::min((int)TILE_SIZE, layer.height - tileY);
+
+	//visibility first (nearest triangle per pixel), so each pixel is only shaded once however much overdraw there is
+	float depth[TILE_SIZE * TILE_SIZE];
+	const Prim* visible[TILE_SIZE * TILE_SIZE];
+	std::fill(depth, depth + TILE_SIZE * TILE_SIZE, 1.0f);
+	std::fill(visible, visible + TILE_SIZE * TILE_SIZE, (const Prim*)NULL);
+
+	Lanes offsets = Lanes::load(LANE_OFFSETS);
+	float coverage[Lanes::WIDTH], depths[Lanes::WIDTH];
+	//chunks in order, so ties in depth resolve the same way every run
+	for (size_t chunk = 0; chunk < layer.bins.size(); chunk++) {
+		const std::vector<Prim>& prims = layer.prims[chunk];
+		for (unsigned int index : layer.bins[chunk][tile]) {
+			const Prim& prim = prims[index];
+			//the triangle's bounding box within the tile, starting on a whole SIMD step so steps never leave the tile
+			int x0 = std::max(prim.minX, tileX) - tileX, x1 = std::min(prim.maxX, tileX + tileWidth - 1) - tileX;
+			int y0 = std::max(prim.minY, tileY) - tileY, y1 = std::min(prim.maxY, tileY + tileHeight - 1) - tileY;
+			x0 -= x0 % Lanes::WIDTH;
+
+			Lanes a0 = Lanes::set(prim.edgeA[0]), a1 = Lanes::set(prim.edgeA[1]), a2 = Lanes::set(prim.edgeA[2]);
+			Lanes z0 = Lanes::set(prim.z[0]), z1 = Lanes::set(prim.z[1]), z2 = Lanes::set(prim.z[2]);
+			for (int y = y0; y <= y1; y++) {
+				float py = tileY + y + 0.5f;
+				Lanes row0 = Lanes::set(prim.edgeB[0] * py + prim.edgeC[0]);
+				Lanes row1 = Lanes::set(prim.edgeB[1] * py + prim.edgeC[1]);
+				Lanes row2 = Lanes::set(prim.edgeB[2] * py + prim.edgeC[2]);
+				for (int x = x0; x <= x1; x += Lanes::WIDTH) {
+					Lanes px = Lanes::set((float)(tileX + x)) + offsets;
+					Lanes l0 = madd(a0, px, row0), l1 = madd(a1, px, row1), l2 = madd(a2, px, row2);
+					//inside when every barycentric coordinate is non-negative
+					min(l0, min(l1, l2)).store(coverage);
+					madd(l0, z0, madd(l1, z1, l2 * z2)).store(depths);
+					int lanes = std::min((int)Lanes::WIDTH, tileWidth - x);
+					for (int i = 0; i < lanes; i++) {
+						int pixel = y * TILE_SIZE + x + i;
+						if (coverage[i] >= 0.0f && depths[i] < depth[pixel]) {
+							depth[pixel] = depths[i];
+							visible[pixel] = &prim;
+						}
+					}
+				}
+			}
+		}
+	}
+
+	size_t shaded = 0;
+	for (int y = 0; y < tileHeight; y++) {
+		for (int x = 0; x < tileWidth; x++) {
+			const Prim* prim = visible[y * TILE_SIZE + x];
+			glm::vec3 colour(0.0f); // the GL path's clear colour
+			if (prim) {
+				colour = shade(*prim, tileX + x + 0.5f, tileY + y + 0.5f, camPos);
+				shaded++;
+			}
+			writePixel(&layer.colour[4 * ((size_t)(tileY + y) * layer.width + tileX + x)], colour);
+		}
+	}
+	shadedPixels += shaded;
+}
+
+glm::vec3 SoftwareRasterizer::shade(const Prim& prim, float x, float y, const glm::vec3& camPos) const {
+	//perspective correct barycentrics within the prim, then within the original triangle
+	float l[3], sum = 0.0f;
+	for (int k = 0; k < 3; k++) {
+		l[k] = (prim.edgeA[k] * x + prim.edgeB[k] * y + prim.edgeC[k]) * prim.invW[k];
+		sum += l[k];
+	}
+	glm::vec3 b = (prim.weights[0] * l[0] + prim.weights[1] * l[1] + prim.weights[2] * l[2]) / sum;
+	unsigned int v0 = prim.vertices[0], v1 = prim.vertices[1], v2 = prim.vertices[2];
+	size_t verticesPerInstance = positions.size();
+
+	glm::vec3 fragPos = worldPositions[v0] * b.x + worldPositions[v1] * b.y + worldPositions[v2] * b.z;
+	glm::vec3 n = glm::normalize(worldNormals[v0] * b.x + worldNormals[v1] * b.y + worldNormals[v2] * b.z);
+	glm::vec2 uv = texCoords[v0 % verticesPerInstance] * b.x + texCoords[v1 % verticesPerInstance] * b.y + texCoords[v2 % verticesPerInstance] * b.z;
+	const MeshMaterial& material = materials[prim.mesh];
+
+	//from here on a line by line port of fragmentShader.gl (full quality variant)
+	glm::vec3 lightDir = glm::normalize(-lighting.direction);
+	glm::vec3 camDir = glm::normalize(camPos - fragPos);
+	glm::vec3 reflectDir = glm::reflect(-lightDir, n);
+
+	glm::vec3 ambient = lighting.ambient;
+	glm::vec3 diffuse = lighting.diffuse * std::max(glm::dot(n, lightDir), 0.0f);
+	glm::vec3 specular = lighting.specular * std::pow(std::max(glm::dot(camDir, reflectDir), 0.0f), material.shininess);
+
+	for (const SoftwarePointLight& light : lighting.lights) {
+		float d = glm::length(light.pos - fragPos);
+		float attenuation = 1.0f / (light.constant + light.linear * d + light.quadratic * d * d);
+		lightDir = glm::normalize(light.pos - fragPos);
+		diffuse += light.diffuse * std::max(glm::dot(n, lightDir), 0.0f) * attenuation;
+		reflectDir = glm::reflect(-lightDir, n);
+		specular += light.specular * std::pow(std::max(glm::dot(camDir, reflectDir), 0.0f), material.shininess) * attenuation;
+	}
+
+	glm::vec3 surface = material.diffuseTexture >= 0 ? sample(textures[material.diffuseTexture], uv) : material.colour;
+	ambient *= surface;
+	diffuse *= surface;
+	if (material.specularTexture >= 0) {
+		specular *= sample(textures[material.specularTexture], uv);
+	}
+	return ambient + diffuse + specular;
+}
+
+glm::vec3 SoftwareRasterizer::sample(const Texture& texture, glm::vec2 uv) {
+	//nearest texel with repeat wrapping and no mipmaps, so distant surfaces alias more than they do on the GPU
+	float u = uv.x - std::floor(uv.x), v = uv.y - std::floor(uv.y);
+	int x = std::min(texture.width - 1, (int)(u * texture.width));
+	int y = std::min(texture.height - 1, (int)(v * texture.height));
+	const unsigned char* p = &texture.pixels[((size_t)y * texture.width + x) * texture.channels];
+	if (texture.channels < 3) {
+		return glm::vec3(p[0] / 255.0f);
+	}
+	return glm::vec3(p[0], p[1], p[2]) / 255.0f;
+}
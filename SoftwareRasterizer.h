@@ -0,0 +1,109 @@
+#pragma once
+
+#include <atomic>
+#include <string>
+#include <vector>
+#include <glm/glm.hpp>
+#include "ThreadPool.h"
+
+struct MeshData;
+
+//mirrors the lighting uniforms of fragmentShader.gl
+struct SoftwarePointLight {
+	glm::vec3 pos;
+	glm::vec3 diffuse;
+	glm::vec3 specular;
+	float constant, linear, quadratic;
+};
+struct SoftwareLighting {
+	//global light, direction is the way it shines
+	glm::vec3 direction;
+	glm::vec3 ambient, diffuse, specular;
+	std::vector<SoftwarePointLight> lights;
+};
+
+//CPU rendering backend for machines without a GPU, drawing the same scene, instances and lighting as the openGL path straight from
+//the meshes' vertex and index data. Triangles are transformed, near clipped and binned into TILE_SIZE tiles (in parallel over chunks
+//of triangles), then every tile of every eccentricity layer is an independent job: tiles are rasterised with SIMD edge functions
+//into a tile local depth and visibility buffer and each visible pixel is shaded once with a port of fragmentShader.gl's lighting.
+//Layers are then blended as blendingFragmentShader.gl does, so the pixels foveation saves show up directly as CPU time.
+//Images are RGBA8, bottom row first like glReadPixels
+class SoftwareRasterizer {
+public:
+	static const int TILE_SIZE = 64; // a multiple of every SIMD width
+	static const int SETUP_CHUNK = 4096; // triangles set up and binned per job
+
+	explicit SoftwareRasterizer(int numThreads);
+
+	//imports the model (see Scene::importMeshData) and decodes its textures
+	bool load(const char* scenePath);
+	void setInstances(const std::vector<glm::mat4>& instanceModels);
+	void setLighting(const SoftwareLighting& newLighting);
+
+	//the whole frame at full resolution, like Scene::draw
+	void draw(const glm::mat4& VP, const glm::vec3& camPos, int width, int height, std::vector<unsigned char>& image);
+	//the layered foveated frame, with the same sizes/resolutions layout as Scene::drawEccentricityLayer
+	void drawFoveated(const glm::mat4& VP, const glm::vec3& camPos, int width, int height, const int* sizes, const int* resolutions, int numLayers, std::vector<unsigned char>& image);
+
+	//pixels shaded by the last draw, across every layer
+	size_t getShadedPixels() const {
+		return shadedPixels.load();
+	}
+
+private:
+	struct Texture {
+		int width = 0, height = 0, channels = 0;
+		std::vector<unsigned char> pixels;
+	};
+	struct MeshMaterial {
+		glm::vec3 colour;
+		float shininess;
+		int diffuseTexture, specularTexture; // -1 when the map is disabled
+	};
+	//a triangle after clipping and projection into a layer
+	struct Prim {
+		//barycentric coordinate of each corner at a pixel centre (x, y) is edgeA * x + edgeB * y + edgeC
+		float edgeA[3], edgeB[3], edgeC[3];
+		float z[3], invW[3];
+		//the corners as barycentric weights of the original triangle, which only differ from the identity when near clipped
+		glm::vec3 weights[3];
+		unsigned int vertices[3]; // transformed vertices of the original triangle
+		int mesh;
+		int minX, minY, maxX, maxY; // pixel bounding box, clamped to the layer
+	};
+	struct Layer {
+		int width, height, tilesX, tilesY;
+		glm::vec2 scale; // magnification relative to the whole screen
+		std::vector<unsigned char> colour;
+		std::vector<std::vector<Prim>> prims; // per setup chunk
+		std::vector<std::vector<std::vector<unsigned int>>> bins; // per setup chunk and tile, indices into prims
+	};
+
+	ThreadPool pool;
+	std::string directory;
+	std::vector<glm::vec3> positions, normals;
+	std::vector<glm::vec2> texCoords;
+	std::vector<unsigned int> indices;
+	std::vector<int> triangleMeshes;
+	std::vector<MeshMaterial> materials;
+	std::vector<Texture> textures;
+	std::vector<std::string> texturePaths;
+	std::vector<glm::mat4> models;
+	std::vector<glm::mat3> normalMatrices;
+	SoftwareLighting lighting;
+
+	//per frame, every vertex of every instance
+	std::vector<glm::vec4> clipPositions;
+	std::vector<glm::vec3> worldPositions, worldNormals;
+	std::vector<Layer> layers;
+	std::atomic<size_t> shadedPixels{ 0 };
+
+	int addTexture(const std::string& path);
+	//draws every layer in layers, which have their size and scale set
+	void render(const glm::mat4& VP, const glm::vec3& camPos);
+	void transformVertices(const glm::mat4& VP);
+	void setupTriangles(int chunk, int begin, int end);
+	void rasteriseTile(Layer& layer, int tile, const glm::vec3& camPos);
+	glm::vec3 shade(const Prim& prim, float x, float y, const glm::vec3& camPos) const;
+	static glm::vec3 sample(const Texture& texture, glm::vec2 uv);
+};
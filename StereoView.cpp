@@ -0,0 +1,54 @@
+#include "StereoView.h"
+
+#include <glm/gtc/matrix_transform.hpp>
+
+StereoEyes computeStereoEyes(const glm::mat4& view, const glm::mat4& projection, float ipd) {
+	//same vertical field of view over half the width
+	glm::mat4 eyeProjection = projection;
+	eyeProjection[0][0] *= 2.0f;
+
+	StereoEyes eyes;
+	for (int eye = 0; eye < 2; eye++) {
+		//moving the eye left is moving the world right in view space
+		float offset = (eye == 0 ? 0.5f : -0.5f) * ipd;
+		eyes.VP[eye] = eyeProjection * glm::translate(glm::mat4(1.0f), glm::vec3(offset, 0.0f, 0.0f)) * view;
+	}
+	eyes.centreVP = eyeProjection * view;
+	return eyes;
+}
+
+Frustum::Frustum(const glm::mat4& VP) {
+	//Gribb/Hartmann, a point is inside when -w <= x, y, z <= w in clip space, so each plane is the last row plus or minus another
+	glm::vec4 rows[4];
+	for (int i = 0; i < 4; i++) {
+		rows[i] = glm::vec4(VP[0][i], VP[1][i], VP[2][i], VP[3][i]);
+	}
+	for (int i = 0; i < 3; i++) {
+		planes[2 * i] = rows[3] + rows[i];
+		planes[2 * i + 1] = rows[3] - rows[i];
+	}
+}
+
+bool Frustum::intersects(const glm::vec3& min, const glm::vec3& max) const {
+	for (const glm::vec4& plane : planes) {
+		//the box corner furthest along the plane's normal, if even that is behind the plane then the whole box is
+		glm::vec3 corner(plane.x >= 0.0f ? max.x : min.x, plane.y >= 0.0f ? max.y : min.y, plane.z >= 0.0f ? max.z : min.z);
+		if (plane.x * corner.x + plane.y * corner.y + plane.z * corner.z + plane.w < 0.0f) {
+			return false;
+		}
+	}
+	return true;
+}
+
+int cullInstances(const Frustum* frusta, int numFrusta, const glm::vec3* worldMin, const glm::vec3* worldMax, int count, int* visible) {
+	int numVisible = 0;
+	for (int i = 0; i < count; i++) {
+		for (int f = 0; f < numFrusta; f++) {
+			if (frusta[f].intersects(worldMin[i], worldMax[i])) {
+				visible[numVisible++] = i;
+				break;
+			}
+		}
+	}
+	return numVisible;
+}
@@ -0,0 +1,28 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+//View-projection matrices for the stereo (head mounted display) path. Both eyes look down the same direction as the camera and
+//sit ipd apart along its x axis, each drawn into one half of a side-by-side target, so their projection is narrowed to the half's
+//aspect ratio. The centre eye sits between them and draws the layers both eyes share
+struct StereoEyes {
+	glm::mat4 VP[2]; // left, right
+	glm::mat4 centreVP;
+};
+
+StereoEyes computeStereoEyes(const glm::mat4& view, const glm::mat4& projection, float ipd);
+
+//clip space planes of a view-projection matrix, for culling world space bounding boxes
+class Frustum {
+public:
+	explicit Frustum(const glm::mat4& VP);
+	//conservative, boxes near a corner of the frustum can pass without being inside it
+	bool intersects(const glm::vec3& min, const glm::vec3& max) const;
+
+private:
+	glm::vec4 planes[6]; // (normal, distance), pointing inwards
+};
+
+//writes the indices of the instances whose boxes intersect any of the frusta into visible and returns how many there are. Each box
+//is only tested once however many views are drawn, so every eye is culled at the cost of one
+int cullInstances(const Frustum* frusta, int numFrusta, const glm::vec3* worldMin, const glm::vec3* worldMax, int count, int* visible);
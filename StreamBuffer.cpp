@@ -0,0 +1,136 @@
+#include "StreamBuffer.h"
+
+#include <glad/glad.h>
+#include <GLFW/glfw3.h>
+#include "Profiler.h"
+
+#include <algorithm>
+#include <iostream>
+
+//buffer storage is core from 4.4, so like the program binary functions in Shader.cpp its enums and function are looked up here
+//rather than relying on the glad loader having been generated with them
+#define MAP_PERSISTENT_BIT 0x0040
+#define MAP_COHERENT_BIT 0x0080
+
+typedef void (APIENTRYP BufferStorageProc)(GLenum target, GLsizeiptr size, const void* data, GLbitfield flags);
+
+StreamBuffer::StreamBuffer(size_t regionBytes, int allocationsPerRegion) : buffer(GLBuffer::create()) {
+	GLint uniformAlignment = 0;
+	glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &uniformAlignment);
+	//16 keeps every allocation aligned for vec4s and vertex attributes as well
+	alignment = std::max((size_t)uniformAlignment, (size_t)16);
+	this->regionBytes = (regionBytes + alignment - 1) / alignment * alignment + alignment * allocationsPerRegion;
+	size_t bytes = this->regionBytes * NUM_REGIONS;
+
+	GLint major = 0, minor = 0;
+	glGetIntegerv(GL_MAJOR_VERSION, &major);
+	glGetIntegerv(GL_MINOR_VERSION, &minor);
+	BufferStorageProc bufferStorage = NULL;
+	if (major > 4 || (major == 4 && minor >= 4) || hasGLExtension("GL_ARB_buffer_storage")) {
+		bufferStorage = (BufferStorageProc)glfwGetProcAddress("glBufferStorage");
+	}
+
+	//bound to the copy target so creating the buffer doesn't disturb any vertex array or uniform block bindings
+	glBindBuffer(GL_COPY_WRITE_BUFFER, buffer.id());
+	if (bufferStorage) {
+		GLbitfield flags = GL_MAP_WRITE_BIT | MAP_PERSISTENT_BIT | MAP_COHERENT_BIT;
+		bufferStorage(GL_COPY_WRITE_BUFFER, bytes, NULL, flags);
+		mapped = (unsigned char*)glMapBufferRange(GL_COPY_WRITE_BUFFER, 0, bytes, flags);
+		persistent = mapped != NULL;
+		if (!persistent) {
+			//immutable storage can't be respecified, so start again with a fresh buffer for the fallback
+			glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+			buffer = GLBuffer::create();
+			glBindBuffer(GL_COPY_WRITE_BUFFER, buffer.id());
+		}
+	}
+	if (!persistent) {
+		glBufferData(GL_COPY_WRITE_BUFFER, bytes, NULL, GL_STREAM_DRAW);
+		std::cout << "Persistent buffer mapping not supported, streaming per frame data through an orphaned buffer instead" << std::endl;
+	}
+	glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+	buffer.setBytes(GPUMemoryCategory::BUFFERS, bytes);
+}
+
+StreamBuffer::~StreamBuffer() {
+	if (glfwGetCurrentContext() == NULL) {
+		return; // everything went with the context
+	}
+	for (__GLsync*& fence : fences) {
+		if (fence) {
+			glDeleteSync(fence);
+			fence = NULL;
+		}
+	}
+	if (mapped) {
+		glBindBuffer(GL_COPY_WRITE_BUFFER, buffer.id());
+		glUnmapBuffer(GL_COPY_WRITE_BUFFER);
+		glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+		mapped = NULL;
+	}
+}
+
+void StreamBuffer::begin() {
+	TRACE_FUNCTION();
+	if (persistent && region >= 0) {
+		fences[region] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+	}
+	region = (region + 1) % NUM_REGIONS;
+	used = 0;
+	overflowed = false;
+
+	if (persistent) {
+		//normally signalled long ago, only waits when the GPU is NUM_REGIONS frames behind
+		if (fences[region]) {
+			GLenum status = glClientWaitSync(fences[region], 0, 0);
+			if (status == GL_TIMEOUT_EXPIRED) {
+				TRACE_SCOPE("stream buffer stall");
+				stalls++;
+				do {
+					status = glClientWaitSync(fences[region], GL_SYNC_FLUSH_COMMANDS_BIT, 1000000);
+				} while (status == GL_TIMEOUT_EXPIRED);
+			}
+			glDeleteSync(fences[region]);
+			fences[region] = NULL;
+		}
+		return;
+	}
+
+	glBindBuffer(GL_COPY_WRITE_BUFFER, buffer.id());
+	if (region == 0) {
+		//the GPU may still be reading the regions written since the last wrap, so this hands the old storage over to the driver (to
+		//free once it is done with it) and allocates new storage, making the unsynchronized maps below safe
+		glBufferData(GL_COPY_WRITE_BUFFER, regionBytes * NUM_REGIONS, NULL, GL_STREAM_DRAW);
+	}
+	GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_UNSYNCHRONIZED_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_FLUSH_EXPLICIT_BIT;
+	mapped = (unsigned char*)glMapBufferRange(GL_COPY_WRITE_BUFFER, region * regionBytes, regionBytes, flags);
+	glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+}
+
+void* StreamBuffer::allocate(size_t bytes, size_t& offset) {
+	size_t start = (used + alignment - 1) / alignment * alignment;
+	if (!mapped || start + bytes > regionBytes) {
+		if (!overflowed) {
+			std::cout << "Stream buffer region full, dropping " << bytes << " bytes of per frame data" << std::endl;
+			overflowed = true;
+		}
+		return NULL;
+	}
+	used = start + bytes;
+	offset = region * regionBytes + start;
+	//the persistent mapping covers the whole buffer, the fallback's only the current region
+	return persistent ? mapped + offset : mapped + start;
+}
+
+void StreamBuffer::end() {
+	if (persistent || !mapped) {
+		return; // coherent, so writes are visible to commands issued from now on without flushing
+	}
+	glBindBuffer(GL_COPY_WRITE_BUFFER, buffer.id());
+	if (used > 0) {
+		glFlushMappedBufferRange(GL_COPY_WRITE_BUFFER, 0, used);
+	}
+	glUnmapBuffer(GL_COPY_WRITE_BUFFER);
+	glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+	mapped = NULL;
+}
@@ -0,0 +1,54 @@
+#pragma once
+
+#include <cstddef>
+#include "GLResource.h"
+
+struct __GLsync;
+
+//Ring allocator for data rewritten every frame (uniform blocks, dynamic vertex data), which is written straight into GPU visible
+//memory rather than copied by the driver out of glUniform*/glBufferData calls. The buffer is split into NUM_REGIONS regions used in
+//turn, one per begin()/end(). With ARB_buffer_storage (core in 4.4) the whole buffer is mapped persistently once and every region is
+//fenced after use, so a region is only waited on if the GPU falls NUM_REGIONS frames behind. Plain 3.3 drivers map each region
+//unsynchronized instead and orphan the buffer every time the ring wraps, so the driver hands out fresh storage rather than syncing.
+//The buffer can be bound to any target (GL_UNIFORM_BUFFER ranges, GL_ARRAY_BUFFER for vertex attributes) at the returned offsets
+class StreamBuffer {
+public:
+	static const int NUM_REGIONS = 3; // frames the CPU can get ahead of the GPU before it has to wait
+
+	//regionBytes is the most one frame can allocate over at most allocationsPerRegion allocations, each of which may be padded up to
+	//the driver's uniform buffer offset alignment
+	StreamBuffer(size_t regionBytes, int allocationsPerRegion);
+	~StreamBuffer();
+	StreamBuffer(const StreamBuffer&) = delete;
+	StreamBuffer& operator=(const StreamBuffer&) = delete;
+
+	//starts writing the next region, fencing the one before it (whose draws have all been issued by now)
+	void begin();
+	//space for bytes in the current region at an offset suitable for glBindBufferRange, NULL (with a message) if the region is full
+	void* allocate(size_t bytes, size_t& offset);
+	//finishes writing, the buffer can't be drawn from between begin() and end() without persistent mapping
+	void end();
+
+	unsigned int id() const {
+		return buffer.id();
+	}
+	bool isPersistent() const {
+		return persistent;
+	}
+	//times begin() had to wait for the GPU to finish with a region
+	int getStalls() const {
+		return stalls;
+	}
+
+private:
+	GLBuffer buffer;
+	size_t regionBytes;
+	size_t alignment;
+	bool persistent = false;
+	unsigned char* mapped = NULL; // the whole buffer when persistent, otherwise the current region while it is being written
+	__GLsync* fences[NUM_REGIONS] = {};
+	int region = -1;
+	size_t used = 0; // bytes of the current region allocated
+	bool overflowed = false;
+	int stalls = 0;
+};
@@ -0,0 +1,410 @@
+#include <glad/glad.h>
+#include "stb_image.h"
+
+#include "TextureCooker.h"
+#include "Profiler.h"
+#include "GLResource.h"
+
+#include <sys/stat.h>
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+
+//S3TC and anisotropic filtering are extensions in openGL 3.3, so glad's core profile header doesn't define their enums
+#ifndef GL_COMPRESSED_RGB_S3TC_DXT1_EXT
+#define GL_COMPRESSED_RGB_S3TC_DXT1_EXT 0x83F0
+#endif
+#ifndef GL_COMPRESSED_RGBA_S3TC_DXT5_EXT
+#define GL_COMPRESSED_RGBA_S3TC_DXT5_EXT 0x83F3
+#endif
+#ifndef GL_TEXTURE_MAX_ANISOTROPY
+#define GL_TEXTURE_MAX_ANISOTROPY 0x84FE
+#endif
+#ifndef GL_MAX_TEXTURE_MAX_ANISOTROPY
+#define GL_MAX_TEXTURE_MAX_ANISOTROPY 0x84FF
+#endif
+
+size_t CookedTexture::sizeInBytes() const {
+	size_t bytes = 0;
+	for (const std::vector<unsigned char>& level : levels) {
+		bytes += level.size();
+	}
+	return bytes;
+}
+
+// ----- MIP CHAIN -----
+
+//2x2 box filter, odd sized levels reuse their last row/column
+static std::vector<unsigned char> downsample(const std::vector<unsigned char>& src, int width, int height, int channels) {
+	int w = std::max(1, width / 2), h = std::max(1, height / 2);
+	std::vector<unsigned char> dst((size_t)w * h * channels);
+	for (int y = 0; y < h; y++) {
+		int y0 = std::min(2 * y, height - 1), y1 = std::min(2 * y + 1, height - 1);
+		for (int x = 0; x < w; x++) {
+			int x0 = std::min(2 * x, width - 1), x1 = std::min(2 * x + 1, width - 1);
+			for (int c = 0; c < channels; c++) {
+				int sum = src[((size_t)y0 * width + x0) * channels + c] + src[((size_t)y0 * width + x1) * channels + c]
+					+ src[((size_t)y1 * width + x0) * channels + c] + src[((size_t)y1 * width + x1) * channels + c];
+				dst[((size_t)y * w + x) * channels + c] = (unsigned char)((sum + 2) / 4);
+			}
+		}
+	}
+	return dst;
+}
+
+// ----- BLOCK COMPRESSION -----
+
+static uint16_t packRGB565(const float* c) {
+	int r = std::min(31, std::max(0, (int)(c[0] * 31.0f / 255.0f + 0.5f)));
+	int g = std::min(63, std::max(0, (int)(c[1] * 63.0f / 255.0f + 0.5f)));
+	int b = std::min(31, std::max(0, (int)(c[2] * 31.0f / 255.0f + 0.5f)));
+	return (uint16_t)((r << 11) | (g << 5) | b);
+}
+
+static void unpackRGB565(uint16_t packed, float* c) {
+	c[0] = (float)((packed >> 11) & 31) * 255.0f / 31.0f;
+	c[1] = (float)((packed >> 5) & 63) * 255.0f / 63.0f;
+	c[2] = (float)(packed & 31) * 255.0f / 31.0f;
+}
+
+//BC1 colour block for 16 RGBA texels: endpoints are the extremes of the block's colours along their principal axis, indices
+//pick the closest of the 4 colours interpolated between them. Always written in 4 colour mode (c0 > c1) so it is also valid as
+//the colour half of a BC3 block
+static void encodeColourBlock(const unsigned char block[16][4], unsigned char* out) {
+	float mean[3] = { 0.0f, 0.0f, 0.0f };
+	for (int i = 0; i < 16; i++) {
+		for (int c = 0; c < 3; c++) {
+			mean[c] += block[i][c] / 16.0f;
+		}
+	}
+	float cov[6] = {}; // rr, rg, rb, gg, gb, bb
+	for (int i = 0; i < 16; i++) {
+		float d[3] = { block[i][0] - mean[0], block[i][1] - mean[1], block[i][2] - mean[2] };
+		cov[0] += d[0] * d[0]; cov[1] += d[0] * d[1]; cov[2] += d[0] * d[2];
+		cov[3] += d[1] * d[1]; cov[4] += d[1] * d[2]; cov[5] += d[2] * d[2];
+	}
+	//a few power iterations are plenty to find the principal axis of 16 points
+	float axis[3] = { 1.0f, 1.0f, 1.0f };
+	for (int it = 0; it < 4; it++) {
+		float next[3] = {
+			cov[0] * axis[0] + cov[1] * axis[1] + cov[2] * axis[2],
+			cov[1] * axis[0] + cov[3] * axis[1] + cov[4] * axis[2],
+			cov[2] * axis[0] + cov[4] * axis[1] + cov[5] * axis[2]
+		};
+		float length = std::max(std::max(std::abs(next[0]), std::abs(next[1])), std::abs(next[2]));
+		if (length < 1e-6f) {
+			break;
+		}
+		for (int c = 0; c < 3; c++) {
+			axis[c] = next[c] / length;
+		}
+	}
+
+	float minT = 1e30f, maxT = -1e30f;
+	for (int i = 0; i < 16; i++) {
+		float t = (block[i][0] - mean[0]) * axis[0] + (block[i][1] - mean[1]) * axis[1] + (block[i][2] - mean[2]) * axis[2];
+		minT = std::min(minT, t);
+		maxT = std::max(maxT, t);
+	}
+	float axisLength2 = axis[0] * axis[0] + axis[1] * axis[1] + axis[2] * axis[2];
+	float end0[3], end1[3];
+	for (int c = 0; c < 3; c++) {
+		end0[c] = mean[c] + axis[c] * maxT / std::max(axisLength2, 1e-6f);
+		end1[c] = mean[c] + axis[c] * minT / std::max(axisLength2, 1e-6f);
+	}
+
+	uint16_t c0 = packRGB565(end0), c1 = packRGB565(end1);
+	if (c0 < c1) {
+		std::swap(c0, c1);
+	}
+
+	uint32_t indices = 0;
+	if (c0 != c1) {
+		float palette[4][3];
+		unpackRGB565(c0, palette[0]);
+		unpackRGB565(c1, palette[1]);
+		for (int c = 0; c < 3; c++) {
+			palette[2][c] = (2.0f * palette[0][c] + palette[1][c]) / 3.0f;
+			palette[3][c] = (palette[0][c] + 2.0f * palette[1][c]) / 3.0f;
+		}
+		for (int i = 0; i < 16; i++) {
+			int best = 0;
+			float bestDistance = 1e30f;
+			for (int p = 0; p < 4; p++) {
+				float dr = block[i][0] - palette[p][0], dg = block[i][1] - palette[p][1], db = block[i][2] - palette[p][2];
+				float distance = dr * dr + dg * dg + db * db;
+				if (distance < bestDistance) {
+					bestDistance = distance;
+					best = p;
+				}
+			}
+			indices |= (uint32_t)best << (2 * i);
+		}
+	}
+
+	out[0] = c0 & 0xFF; out[1] = c0 >> 8;
+	out[2] = c1 & 0xFF; out[3] = c1 >> 8;
+	for (int i = 0; i < 4; i++) {
+		out[4 + i] = (indices >> (8 * i)) & 0xFF;
+	}
+}
+
+//BC3 alpha block: min/max endpoints with 6 interpolated values between them, 3 bit index per texel
+static void encodeAlphaBlock(const unsigned char block[16][4], unsigned char* out) {
+	int a0 = 0, a1 = 255;
+	for (int i = 0; i < 16; i++) {
+		a0 = std::max(a0, (int)block[i][3]);
+		a1 = std::min(a1, (int)block[i][3]);
+	}
+
+	uint64_t indices = 0;
+	if (a0 != a1) {
+		int palette[8] = { a0, a1 };
+		for (int p = 2; p < 8; p++) {
+			palette[p] = ((8 - p) * a0 + (p - 1) * a1) / 7;
+		}
+		for (int i = 0; i < 16; i++) {
+			int best = 0;
+			for (int p = 1; p < 8; p++) {
+				if (std::abs(block[i][3] - palette[p]) < std::abs(block[i][3] - palette[best])) {
+					best = p;
+				}
+			}
+			indices |= (uint64_t)best << (3 * i);
+		}
+	}
+
+	out[0] = (unsigned char)a0;
+	out[1] = (unsigned char)a1;
+	for (int i = 0; i < 6; i++) {
+		out[2 + i] = (indices >> (8 * i)) & 0xFF;
+	}
+}
+
+static std::vector<unsigned char> compressLevel(const std::vector<unsigned char>& pixels, int width, int height, int channels) {
+	int blocksX = (width + 3) / 4, blocksY = (height + 3) / 4;
+	int blockBytes = channels == 4 ? 16 : 8;
+	std::vector<unsigned char> out((size_t)blocksX * blocksY * blockBytes);
+
+	unsigned char block[16][4];
+	for (int by = 0; by < blocksY; by++) {
+		for (int bx = 0; bx < blocksX; bx++) {
+			//levels smaller than a block (and the edges of non multiple of 4 sizes) repeat their edge texels
+			for (int i = 0; i < 16; i++) {
+				int x = std::min(bx * 4 + i % 4, width - 1), y = std::min(by * 4 + i / 4, height - 1);
+				const unsigned char* texel = &pixels[((size_t)y * width + x) * channels];
+				block[i][0] = texel[0];
+				block[i][1] = texel[1];
+				block[i][2] = texel[2];
+				block[i][3] = channels == 4 ? texel[3] : 255;
+			}
+			unsigned char* dst = &out[((size_t)by * blocksX + bx) * blockBytes];
+			if (channels == 4) {
+				encodeAlphaBlock(block, dst);
+				encodeColourBlock(block, dst + 8);
+			}
+			else {
+				encodeColourBlock(block, dst);
+			}
+		}
+	}
+	return out;
+}
+
+bool cookTexture(const unsigned char* pixels, int width, int height, int channels, bool compress, CookedTexture& out) {
+	TRACE_FUNCTION();
+	if (channels != 3 && channels != 4) {
+		std::cout << "Unsupported number of channels (" << channels << ") for texture cooking" << std::endl;
+		return false;
+	}
+
+	out.width = width;
+	out.height = height;
+	out.compressed = compress;
+	out.internalFormat = compress ? (channels == 4 ? GL_COMPRESSED_RGBA_S3TC_DXT5_EXT : GL_COMPRESSED_RGB_S3TC_DXT1_EXT) : GL_RGBA8;
+	out.levels.clear();
+
+	std::vector<unsigned char> level(pixels, pixels + (size_t)width * height * channels);
+	int w = width, h = height;
+	while (true) {
+		if (compress) {
+			out.levels.push_back(compressLevel(level, w, h, channels));
+		}
+		else {
+			//uncompressed levels are always stored as RGBA so rows are 4 byte aligned, as KTX requires
+			std::vector<unsigned char> rgba((size_t)w * h * 4);
+			for (size_t i = 0; i < (size_t)w * h; i++) {
+				for (int c = 0; c < 4; c++) {
+					rgba[i * 4 + c] = c < channels ? level[i * channels + c] : 255;
+				}
+			}
+			out.levels.push_back(std::move(rgba));
+		}
+		if (w == 1 && h == 1) {
+			break;
+		}
+		level = downsample(level, w, h, channels);
+		w = std::max(1, w / 2);
+		h = std::max(1, h / 2);
+	}
+	return true;
+}
+
+// ----- KTX FILES -----
+
+static const unsigned char KTX_IDENTIFIER[12] = { 0xAB, 0x4B, 0x54, 0x58, 0x20, 0x31, 0x31, 0xBB, 0x0D, 0x0A, 0x1A, 0x0A };
+
+struct KTXHeader {
+	uint32_t endianness;
+	uint32_t glType;
+	uint32_t glTypeSize;
+	uint32_t glFormat;
+	uint32_t glInternalFormat;
+	uint32_t glBaseInternalFormat;
+	uint32_t pixelWidth;
+	uint32_t pixelHeight;
+	uint32_t pixelDepth;
+	uint32_t numberOfArrayElements;
+	uint32_t numberOfFaces;
+	uint32_t numberOfMipmapLevels;
+	uint32_t bytesOfKeyValueData;
+};
+
+bool writeKTX(const std::string& path, const CookedTexture& texture) {
+	std::ofstream file(path, std::ios::binary);
+	if (!file) {
+		std::cout << "Failed to write texture cache: " << path << std::endl;
+		return false;
+	}
+
+	KTXHeader header;
+	header.endianness = 0x04030201;
+	header.glType = texture.compressed ? 0 : GL_UNSIGNED_BYTE;
+	header.glTypeSize = 1;
+	header.glFormat = texture.compressed ? 0 : GL_RGBA;
+	header.glInternalFormat = texture.internalFormat;
+	header.glBaseInternalFormat = texture.internalFormat == GL_COMPRESSED_RGB_S3TC_DXT1_EXT ? GL_RGB : GL_RGBA;
+	header.pixelWidth = texture.width;
+	header.pixelHeight = texture.height;
+	header.pixelDepth = 0;
+	header.numberOfArrayElements = 0;
+	header.numberOfFaces = 1;
+	header.numberOfMipmapLevels = (uint32_t)texture.levels.size();
+	header.bytesOfKeyValueData = 0;
+
+	file.write((const char*)KTX_IDENTIFIER, sizeof(KTX_IDENTIFIER));
+	file.write((const char*)&header, sizeof(header));
+	//every level is a multiple of 4 bytes (8/16 byte blocks or RGBA texels), so no mip padding is needed
+	for (const std::vector<unsigned char>& level : texture.levels) {
+		uint32_t imageSize = (uint32_t)level.size();
+		file.write((const char*)&imageSize, sizeof(imageSize));
+		file.write((const char*)level.data(), level.size());
+	}
+	return (bool)file;
+}
+
+bool readKTX(const std::string& path, CookedTexture& texture) {
+	TRACE_FUNCTION();
+	std::ifstream file(path, std::ios::binary);
+	if (!file) {
+		return false;
+	}
+
+	unsigned char identifier[12];
+	KTXHeader header;
+	file.read((char*)identifier, sizeof(identifier));
+	file.read((char*)&header, sizeof(header));
+	if (!file || std::memcmp(identifier, KTX_IDENTIFIER, sizeof(identifier)) != 0 || header.endianness != 0x04030201
+		|| header.numberOfFaces != 1 || header.pixelDepth != 0 || header.numberOfArrayElements != 0) {
+		std::cout << "Invalid texture cache file: " << path << std::endl;
+		return false;
+	}
+	file.seekg(header.bytesOfKeyValueData, std::ios::cur);
+
+	texture.width = header.pixelWidth;
+	texture.height = header.pixelHeight;
+	texture.internalFormat = header.glInternalFormat;
+	texture.compressed = header.glType == 0;
+	texture.levels.resize(header.numberOfMipmapLevels);
+	for (std::vector<unsigned char>& level : texture.levels) {
+		uint32_t imageSize;
+		file.read((char*)&imageSize, sizeof(imageSize));
+		level.resize(imageSize);
+		file.read((char*)level.data(), imageSize);
+		file.seekg((4 - imageSize % 4) % 4, std::ios::cur);
+	}
+	if (!file) {
+		std::cout << "Truncated texture cache file: " << path << std::endl;
+		return false;
+	}
+	return true;
+}
+
+bool loadCookedTexture(const std::string& sourcePath, bool compress, CookedTexture& out) {
+	std::string cachePath = sourcePath + ".ktx";
+
+	//the cache is only used if it was written after the source image was last modified
+	struct stat sourceStat, cacheStat;
+	bool sourceExists = stat(sourcePath.c_str(), &sourceStat) == 0;
+	bool cacheExists = stat(cachePath.c_str(), &cacheStat) == 0;
+	if (cacheExists && (!sourceExists || cacheStat.st_mtime >= sourceStat.st_mtime) && readKTX(cachePath, out)) {
+		if (out.compressed == compress) {
+			return true;
+		}
+	}
+
+	int width, height, channels;
+	unsigned char* data = stbi_load(sourcePath.c_str(), &width, &height, &channels, 0);
+	if (!data) {
+		std::cout << "Failed to load texture: " << sourcePath << std::endl;
+		return false;
+	}
+	bool cooked = cookTexture(data, width, height, channels, compress, out);
+	stbi_image_free(data);
+	if (cooked) {
+		writeKTX(cachePath, out);
+	}
+	return cooked;
+}
+
+// ----- UPLOAD -----
+
+bool textureCompressionSupported() {
+	static bool supported = hasGLExtension("GL_EXT_texture_compression_s3tc");
+	return supported;
+}
+
+void setTextureSampling(float anisotropy) {
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+
+	//core in 4.6, available as GL_EXT_texture_filter_anisotropic (with the same enums) almost everywhere else
+	static bool anisotropySupported = hasGLExtension("GL_EXT_texture_filter_anisotropic") || hasGLExtension("GL_ARB_texture_filter_anisotropic");
+	if (anisotropy > 1.0f && anisotropySupported) {
+		GLfloat maxAnisotropy = 1.0f;
+		glGetFloatv(GL_MAX_TEXTURE_MAX_ANISOTROPY, &maxAnisotropy);
+		glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_MAX_ANISOTROPY, std::min(anisotropy, maxAnisotropy));
+	}
+}
+
+void uploadCookedTexture(const CookedTexture& texture, bool fromUnpackBuffer, size_t unpackOffset) {
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+	int w = texture.width, h = texture.height;
+	size_t offset = unpackOffset;
+	for (int level = 0; level < (int)texture.levels.size(); level++) {
+		const void* data = fromUnpackBuffer ? (const void*)offset : (const void*)texture.levels[level].data();
+		if (texture.compressed) {
+			glCompressedTexImage2D(GL_TEXTURE_2D, level, texture.internalFormat, w, h, 0, (GLsizei)texture.levels[level].size(), data);
+		}
+		else {
+			glTexImage2D(GL_TEXTURE_2D, level, texture.internalFormat, w, h, 0, GL_RGBA, GL_UNSIGNED_BYTE, data);
+		}
+		offset += texture.levels[level].size();
+		w = std::max(1, w / 2);
+		h = std::max(1, h / 2);
+	}
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, 0);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, (int)texture.levels.size() - 1);
+}
\ No newline at end of file
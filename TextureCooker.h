@@ -0,0 +1,38 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+//Texture with its full mip chain already generated (and block compressed if supported), ready to be uploaded level by level
+//without decoding the source image or calling glGenerateMipmap
+struct CookedTexture {
+	unsigned int internalFormat = 0; // GL_COMPRESSED_RGB_S3TC_DXT1_EXT, GL_COMPRESSED_RGBA_S3TC_DXT5_EXT or GL_RGBA8
+	bool compressed = false;
+	int width = 0;
+	int height = 0;
+	std::vector<std::vector<unsigned char>> levels; // level 0 is full size, each following one half the size of the last (min 1)
+
+	size_t sizeInBytes() const;
+};
+
+//builds the mip chain for an 8 bit image with 3 or 4 channels and encodes each level as BC1 (3 channels) or BC3 (4 channels),
+//or stores them as uncompressed RGBA8 if compress is false. No openGL calls, safe to call from any thread
+bool cookTexture(const unsigned char* pixels, int width, int height, int channels, bool compress, CookedTexture& out);
+
+//KTX (version 1) files, the format used for the texture cache
+bool writeKTX(const std::string& path, const CookedTexture& texture);
+bool readKTX(const std::string& path, CookedTexture& texture);
+
+//returns the cooked version of the image at sourcePath, from the cache file next to it (sourcePath + ".ktx") if it is up to date
+//and in the wanted format, otherwise decoding and cooking the source and writing the cache for next time. No openGL calls
+bool loadCookedTexture(const std::string& sourcePath, bool compress, CookedTexture& out);
+
+// ----- openGL side, must be called from the thread owning the context -----
+
+//whether the driver exposes S3TC (BCn) texture compression, if not textures are cached uncompressed
+bool textureCompressionSupported();
+//trilinear filtering, plus anisotropic filtering (clamped to what the driver supports) if anisotropy is greater than 1
+void setTextureSampling(float anisotropy);
+//uploads every level of the texture into the currently bound GL_TEXTURE_2D. If a pixel unpack buffer is bound, level data is
+//read from it instead, packed one level after another starting at unpackOffset
+void uploadCookedTexture(const CookedTexture& texture, bool fromUnpackBuffer = false, size_t unpackOffset = 0);
\ No newline at end of file
@@ -0,0 +1,114 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <algorithm>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "Profiler.h"
+
+//Fixed size pool of worker threads running submitted tasks in submission order (used for background asset loading, so tasks
+//must not make openGL calls - the context belongs to the render thread). Tasks still queued when the pool is destroyed are dropped,
+//tasks already running are waited for
+class ThreadPool {
+public:
+	ThreadPool(int numThreads) {
+		for (int i = 0; i < numThreads; i++) {
+			workers.emplace_back([this]() { workerLoop(); });
+		}
+	}
+	~ThreadPool() {
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			stopping = true;
+			tasks.clear();
+		}
+		wake.notify_all();
+		for (std::thread& worker : workers) {
+			worker.join();
+		}
+	}
+	ThreadPool(const ThreadPool&) = delete;
+	ThreadPool& operator=(const ThreadPool&) = delete;
+
+	void submit(std::function<void()> task) {
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			tasks.push_back(std::move(task));
+		}
+		wake.notify_one();
+	}
+
+	int getNumThreads() const {
+		return (int)workers.size();
+	}
+
+	//calls fn(begin, end) over [0, count) in chunks of at most grain, spread over the workers and the calling thread, returning once
+	//every chunk is done. Runs after any tasks already queued, so don't use it on a pool busy with long running work
+	void parallelFor(int count, int grain, const std::function<void(int, int)>& fn) {
+		int numChunks = (count + grain - 1) / grain;
+		if (numChunks <= 1 || workers.empty()) {
+			if (count > 0) {
+				fn(0, count);
+			}
+			return;
+		}
+
+		struct Job {
+			std::atomic<int> nextChunk{ 0 };
+			std::atomic<int> chunksLeft;
+			std::mutex doneMutex;
+			std::condition_variable done;
+		};
+		std::shared_ptr<Job> job = std::make_shared<Job>();
+		job->chunksLeft.store(numChunks);
+		//the job outlives this call in case a helper only gets dequeued after everything is finished, fn doesn't so it is only
+		//touched while chunks remain
+		auto runChunks = [job, numChunks, count, grain, &fn]() {
+			int chunk;
+			while ((chunk = job->nextChunk.fetch_add(1)) < numChunks) {
+				int begin = chunk * grain;
+				fn(begin, std::min(begin + grain, count));
+				if (job->chunksLeft.fetch_sub(1) == 1) {
+					std::lock_guard<std::mutex> lock(job->doneMutex);
+					job->done.notify_all();
+				}
+			}
+		};
+		int numHelpers = std::min((int)workers.size(), numChunks - 1);
+		for (int i = 0; i < numHelpers; i++) {
+			submit(runChunks);
+		}
+		runChunks();
+		std::unique_lock<std::mutex> lock(job->doneMutex);
+		job->done.wait(lock, [&job]() { return job->chunksLeft.load() == 0; });
+	}
+
+private:
+	std::vector<std::thread> workers;
+	std::deque<std::function<void()>> tasks;
+	std::mutex mutex;
+	std::condition_variable wake;
+	bool stopping = false;
+
+	void workerLoop() {
+		TRACE_THREAD_NAME("worker");
+		while (true) {
+			std::function<void()> task;
+			{
+				std::unique_lock<std::mutex> lock(mutex);
+				wake.wait(lock, [this]() { return stopping || !tasks.empty(); });
+				if (stopping) {
+					return;
+				}
+				task = std::move(tasks.front());
+				tasks.pop_front();
+			}
+			task();
+		}
+	}
+};
\ No newline at end of file
@@ -0,0 +1,237 @@
+#include <glad/glad.h>
+
+#include "TiledBlend.h"
+#include "Profiler.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <string>
+
+//same as the blending shaders, below this fraction of its radius an inner layer is opaque
+static const float BLENDING_CUTOFF = 0.6f;
+
+//tiles are instances of a unit square, whose corners are given as texture coordinates to match the blending vertex shader
+static const float TILE_CORNERS[] = {
+	0.0f, 1.0f,
+	0.0f, 0.0f,
+	1.0f, 0.0f,
+
+	0.0f, 1.0f,
+	1.0f, 0.0f,
+	1.0f, 1.0f
+};
+
+static std::vector<std::string> variantDefines(const char* variant, bool multisample) {
+	std::vector<std::string> defines = { "TILED", variant };
+	if (multisample) {
+		defines.push_back("MULTISAMPLE");
+	}
+	return defines;
+}
+
+float TiledBlend::Layout::radius(int layer) const {
+	const glm::vec4& b = boundaries[layer - 1];
+	return 0.5f * std::min((b.y - b.x) * screenSize.x, (b.w - b.z) * screenSize.y) - margin;
+}
+
+bool TiledBlend::Layout::operator==(const Layout& other) const {
+	return numLayers == other.numLayers && std::memcmp(boundaries, other.boundaries, sizeof(boundaries)) == 0 &&
+		foveaCentre == other.foveaCentre && margin == other.margin && screenSize == other.screenSize;
+}
+
+TiledBlend::TiledBlend(const char* generalFragmentPath, bool multisample) :
+	baseShader("blendingVertexShader.gl", "blendingTileFragmentShader.gl", variantDefines("BASE_COPY", multisample)),
+	copyShader("blendingVertexShader.gl", "blendingTileFragmentShader.gl", variantDefines("LAYER_COPY", multisample)),
+	ringShader("blendingVertexShader.gl", "blendingTileFragmentShader.gl", variantDefines("RING", multisample)),
+	generalShader("blendingVertexShader.gl", generalFragmentPath, { "TILED" }),
+	vao(GLVertexArray::create()),
+	quadBuffer(GLBuffer::create()),
+	tileBuffer(GLBuffer::create()),
+	multisample(multisample) {
+	glBindVertexArray(vao.id());
+	glBindBuffer(GL_ARRAY_BUFFER, quadBuffer.id());
+	glBufferData(GL_ARRAY_BUFFER, sizeof(TILE_CORNERS), TILE_CORNERS, GL_STATIC_DRAW);
+	quadBuffer.setBytes(GPUMemoryCategory::BUFFERS, sizeof(TILE_CORNERS));
+	//locations are fixed in the vertex shader, inPos (0) isn't read by the tiled variant
+	glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 2 * sizeof(float), (void*)0);
+	glEnableVertexAttribArray(1);
+	//pointed at each batch's tiles when it is drawn
+	glBindBuffer(GL_ARRAY_BUFFER, tileBuffer.id());
+	glVertexAttribPointer(2, 2, GL_UNSIGNED_SHORT, GL_FALSE, 0, (void*)0);
+	glVertexAttribDivisor(2, 1);
+	glEnableVertexAttribArray(2);
+	glBindVertexArray(0);
+
+	//the copy and ring variants always read the outer layer from unit 0 and the inner one from unit 1
+	for (Shader* shader : { &baseShader, &copyShader, &ringShader }) {
+		shader->use();
+		shader->setInt("outer", 0);
+		shader->setInt("inner", 1);
+		shader->setFloat("tileSize", (float)TILE_SIZE);
+	}
+	generalShader.use();
+	generalShader.setFloat("tileSize", (float)TILE_SIZE);
+	for (int i = 0; i < MAX_LAYERS; i++) {
+		generalShader.setInt(("textures[" + std::to_string(i) + "]").c_str(), i);
+	}
+}
+
+void TiledBlend::setSamples(const int* layerSamples, int numLayers) {
+	for (int i = 0; i < MAX_LAYERS; i++) {
+		samples[i] = i < numLayers ? layerSamples[i] : 0;
+	}
+	samplesChanged = true;
+}
+
+void TiledBlend::draw(const Layout& layout, unsigned int textureTarget, const unsigned int* textures) {
+	TRACE_FUNCTION();
+	if (!haveClassified || !(layout == classified)) {
+		classify(layout);
+	}
+	if (multisample && samplesChanged) {
+		generalShader.use();
+		for (int i = 0; i < MAX_LAYERS; i++) {
+			generalShader.setInt(("samples[" + std::to_string(i) + "]").c_str(), samples[i]);
+		}
+		samplesChanged = false;
+	}
+
+	glViewport(0, 0, (int)layout.screenSize.x, (int)layout.screenSize.y);
+	glBindVertexArray(vao.id());
+	glBindBuffer(GL_ARRAY_BUFFER, tileBuffer.id());
+	for (const Batch& batch : batches) {
+		if (batch.tileClass == GENERAL) {
+			generalShader.use();
+			for (int i = 0; i < layout.numLayers; i++) {
+				glActiveTexture(GL_TEXTURE0 + i);
+				glBindTexture(textureTarget, textures[i]);
+			}
+		}
+		else {
+			Shader& shader = batch.tileClass == BASE_COPY ? baseShader : batch.tileClass == LAYER_COPY ? copyShader : ringShader;
+			shader.use();
+			glActiveTexture(GL_TEXTURE0);
+			glBindTexture(textureTarget, textures[batch.outer]);
+			shader.setVec4f("outerTransform", layerTransform(layout, batch.outer));
+			if (multisample) {
+				shader.setInt("outerSamples", samples[batch.outer]);
+			}
+			if (batch.tileClass == RING) {
+				glActiveTexture(GL_TEXTURE1);
+				glBindTexture(textureTarget, textures[batch.inner]);
+				shader.setVec4f("innerTransform", layerTransform(layout, batch.inner));
+				shader.setFloat("innerRadiusInverse", 1.0f / layout.radius(batch.inner));
+				if (multisample) {
+					shader.setInt("innerSamples", samples[batch.inner]);
+				}
+			}
+		}
+		glVertexAttribPointer(2, 2, GL_UNSIGNED_SHORT, GL_FALSE, 0, (void*)(batch.first * 2 * sizeof(unsigned short)));
+		glDrawArraysInstanced(GL_TRIANGLES, 0, 6, batch.count);
+	}
+	glBindVertexArray(0);
+}
+
+void TiledBlend::classify(const Layout& layout) {
+	TRACE_FUNCTION();
+	classified = layout;
+	haveClassified = true;
+
+	int width = (int)layout.screenSize.x, height = (int)layout.screenSize.y;
+	int tilesX = (width + TILE_SIZE - 1) / TILE_SIZE, tilesY = (height + TILE_SIZE - 1) / TILE_SIZE;
+	glm::vec2 fovea = layout.foveaCentre * layout.screenSize;
+	float radii[MAX_LAYERS] = {};
+	for (int i = 1; i < layout.numLayers; i++) {
+		radii[i] = layout.radius(i);
+	}
+
+	for (std::vector<unsigned short>& bucket : buckets) {
+		bucket.clear();
+	}
+	for (int ty = 0; ty < tilesY; ty++) {
+		for (int tx = 0; tx < tilesX; tx++) {
+			//nearest and furthest the tile gets from the fovea, fragments are sampled at pixel centres so this is conservative
+			float x0 = (float)(tx * TILE_SIZE), x1 = (float)std::min((tx + 1) * TILE_SIZE, width);
+			float y0 = (float)(ty * TILE_SIZE), y1 = (float)std::min((ty + 1) * TILE_SIZE, height);
+			glm::vec2 nearest(std::max(std::max(x0 - fovea.x, fovea.x - x1), 0.0f), std::max(std::max(y0 - fovea.y, fovea.y - y1), 0.0f));
+			glm::vec2 furthest(std::max(std::fabs(x0 - fovea.x), std::fabs(x1 - fovea.x)), std::max(std::fabs(y0 - fovea.y), std::fabs(y1 - fovea.y)));
+			float rMin = glm::length(nearest), rMax = glm::length(furthest);
+
+			//layers are blended outermost first, so an inner layer opaque over the whole tile hides everything outside it
+			int outer = 0, inner = 0, partial = 0;
+			for (int i = 1; i < layout.numLayers; i++) {
+				if (radii[i] <= 0.0f) {
+					continue;
+				}
+				if (rMax <= BLENDING_CUTOFF * radii[i]) {
+					outer = i;
+					partial = 0;
+				}
+				else if (rMin < radii[i]) {
+					inner = i;
+					partial++;
+				}
+			}
+
+			TileClass tileClass = partial > 1 ? GENERAL : partial == 1 ? RING : outer > 0 ? LAYER_COPY : BASE_COPY;
+			if (tileClass != RING) {
+				inner = 0;
+			}
+			if (tileClass == GENERAL) {
+				outer = 0;
+			}
+			std::vector<unsigned short>& bucket = buckets[(tileClass * MAX_LAYERS + outer) * MAX_LAYERS + inner];
+			bucket.push_back((unsigned short)(tx * TILE_SIZE));
+			bucket.push_back((unsigned short)(ty * TILE_SIZE));
+		}
+	}
+
+	tiles.clear();
+	batches.clear();
+	std::fill(tileCounts, tileCounts + NUM_CLASSES, 0);
+	for (int key = 0; key < NUM_CLASSES * MAX_LAYERS * MAX_LAYERS; key++) {
+		if (buckets[key].empty()) {
+			continue;
+		}
+		Batch batch;
+		batch.tileClass = (TileClass)(key / (MAX_LAYERS * MAX_LAYERS));
+		batch.outer = key / MAX_LAYERS % MAX_LAYERS;
+		batch.inner = key % MAX_LAYERS;
+		batch.first = (int)tiles.size() / 2;
+		batch.count = (int)buckets[key].size() / 2;
+		batches.push_back(batch);
+		tileCounts[batch.tileClass] += batch.count;
+		tiles.insert(tiles.end(), buckets[key].begin(), buckets[key].end());
+	}
+
+	//orphaned rather than updated in place, the last blend may still be reading it
+	size_t bytes = tiles.size() * sizeof(unsigned short);
+	glBindBuffer(GL_ARRAY_BUFFER, tileBuffer.id());
+	glBufferData(GL_ARRAY_BUFFER, bytes, tiles.data(), GL_DYNAMIC_DRAW);
+	tileBuffer.setBytes(GPUMemoryCategory::BUFFERS, bytes);
+
+	//the general shader does its own per fragment work, so gets the layout as blendingFragmentShader.gl always has
+	generalShader.use();
+	generalShader.setVec2f("screenSize", layout.screenSize);
+	for (int i = 1; i < MAX_LAYERS; i++) {
+		glm::vec4 boundary = i < layout.numLayers ? layout.boundaries[i - 1] : glm::vec4(0.0f);
+		generalShader.setVec4f(("boundaries[" + std::to_string(i - 1) + "]").c_str(), boundary);
+	}
+	generalShader.setVec2f("foveaCentre", layout.foveaCentre);
+	generalShader.setFloat("margin", layout.margin);
+	for (Shader* shader : { &baseShader, &copyShader, &ringShader }) {
+		shader->use();
+		shader->setVec2f("screenSize", layout.screenSize);
+		shader->setVec2f("foveaPixel", fovea);
+	}
+}
+
+glm::vec4 TiledBlend::layerTransform(const Layout& layout, int layer) {
+	if (layer == 0) {
+		return glm::vec4(1.0f, 1.0f, 0.0f, 0.0f);
+	}
+	const glm::vec4& b = layout.boundaries[layer - 1];
+	glm::vec2 scale(1.0f / (b.y - b.x), 1.0f / (b.w - b.z));
+	return glm::vec4(scale.x, scale.y, -b.x * scale.x, -b.z * scale.y);
+}
@@ -0,0 +1,83 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include <vector>
+#include "GLResource.h"
+#include "shader.h"
+
+//The layered mode's blend drawn as TILE_SIZE screen tiles rather than one full screen quad. The layers are circles of known radius
+//around the fovea, so the CPU sorts every tile by which layers can reach it: tiles only the base layer reaches and tiles entirely
+//inside one layer's opaque centre are copied from that layer alone, tiles on a single layer's blending ring read just that layer
+//and the one beneath it, and only the few tiles where more rings meet get the full blending shader. Tiles are drawn instanced,
+//one draw per class and pair of layers, and are only re-sorted when the layout changes (eg the fovea moving)
+class TiledBlend {
+public:
+	static const int TILE_SIZE = 32;
+	static const int MAX_LAYERS = 4; // as many as blendingFragmentShader.gl has room for
+
+	enum TileClass {
+		BASE_COPY,
+		LAYER_COPY,
+		RING,
+		GENERAL,
+		NUM_CLASSES
+	};
+
+	//where the layers are for one blend, as the blending shaders take it
+	struct Layout {
+		int numLayers = 1;
+		//(lowerX, upperX, lowerY, upperY) of the region of the screen each inner layer was drawn for, in texture coordinates
+		glm::vec4 boundaries[MAX_LAYERS - 1] = {};
+		glm::vec2 foveaCentre = glm::vec2(0.5f); // texture coordinates, the inner layers are blended in around it
+		float margin = 0.0f; // pixels
+		glm::vec2 screenSize = glm::vec2(0.0f);
+
+		//blending radius of inner layer i in pixels, as the blending shaders work it out. The layer is never blended in if it isn't positive
+		float radius(int layer) const;
+		bool operator==(const Layout& other) const;
+	};
+
+	//generalFragmentPath is the full blending shader, used for the tiles more than two layers reach. multisample picks the
+	//variants reading the layers' multisampled textures directly
+	TiledBlend(const char* generalFragmentPath, bool multisample);
+	TiledBlend(const TiledBlend&) = delete;
+	TiledBlend& operator=(const TiledBlend&) = delete;
+
+	//sample count of each layer's texture, only read by the multisample variants
+	void setSamples(const int* layerSamples, int numLayers);
+	//blends the layers into the bound framebuffer, with their textures bound to textureTarget (as for Scene::blendLayers)
+	void draw(const Layout& layout, unsigned int textureTarget, const unsigned int* textures);
+
+	//tiles of each class in the last blend drawn
+	int getTileCount(TileClass tileClass) const {
+		return tileCounts[tileClass];
+	}
+
+private:
+	//tiles drawn with the same shader and layers
+	struct Batch {
+		TileClass tileClass;
+		int outer, inner; // layers read, inner only for RING
+		int first, count; // in tiles
+	};
+
+	Shader baseShader, copyShader, ringShader, generalShader;
+	GLVertexArray vao;
+	GLBuffer quadBuffer, tileBuffer;
+	bool multisample;
+	int samples[MAX_LAYERS] = {};
+
+	Layout classified;
+	bool haveClassified = false;
+	bool samplesChanged = true;
+	//per batch while sorting, kept between frames so sorting doesn't allocate
+	std::vector<unsigned short> buckets[NUM_CLASSES * MAX_LAYERS * MAX_LAYERS];
+	std::vector<unsigned short> tiles; // lower left corner of every tile in pixels, in batch order
+	std::vector<Batch> batches;
+	int tileCounts[NUM_CLASSES] = {};
+
+	//sorts the tiles into batches and uploads them, along with the uniforms that only change with the layout
+	void classify(const Layout& layout);
+	//from screen texture coordinates to the layer's own, as the (scale, offset) the tile shaders take
+	static glm::vec4 layerTransform(const Layout& layout, int layer);
+};
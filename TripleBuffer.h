@@ -0,0 +1,47 @@
+#pragma once
+
+#include <atomic>
+
+//Lock-free single producer/single consumer triple buffer, used to hand immutable per-frame snapshots from the input/simulation
+//thread to the render thread. The producer fills back() and then publish()es it, the consumer calls consume() to swap in the newest
+//published value and reads it through front(). Neither side ever waits for the other, the producer never writes to the slot the
+//consumer is reading, and values published but never consumed are simply replaced (the render thread only ever wants the newest input)
+template <typename T>
+class TripleBuffer {
+public:
+	TripleBuffer() : shared(1), backIndex(2), frontIndex(0) {}
+
+	//producer side
+	T& back() {
+		return slots[backIndex];
+	}
+	void publish() {
+		//the slot we get back is either the consumer's old front slot or an older value that was never consumed, both free to reuse
+		int previous = shared.exchange(backIndex | FRESH, std::memory_order_acq_rel);
+		backIndex = previous & INDEX_MASK;
+	}
+
+	//consumer side, returns false (leaving front() unchanged) if nothing new has been published since the last call
+	bool consume() {
+		if (!(shared.load(std::memory_order_acquire) & FRESH)) {
+			return false;
+		}
+		int previous = shared.exchange(frontIndex, std::memory_order_acq_rel);
+		frontIndex = previous & INDEX_MASK;
+		return true;
+	}
+	const T& front() const {
+		return slots[frontIndex];
+	}
+
+private:
+	//shared holds the index of the middle slot, with FRESH set if it was published since the consumer last took it
+	static const int INDEX_MASK = 3;
+	static const int FRESH = 4;
+
+	T slots[3];
+	//each index is only touched by one thread, keep them away from the shared index's cache line
+	alignas(64) std::atomic<int> shared;
+	alignas(64) int backIndex;
+	alignas(64) int frontIndex;
+};
@@ -0,0 +1,113 @@
+//Microbenchmark of the per frame instance transforms: the original scalar glm loops against InstanceStore's batched SIMD kernels,
+//single threaded and spread over a thread pool. Needs no OpenGL context, build from the repository root with eg
+//	g++ -std=c++17 -O2 -march=native -I. benchmarks/InstanceTransformBenchmark.cpp InstanceTransforms.cpp -pthread -o instanceBenchmark
+//(or add both files to a new console project with AVX2 enabled)
+
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <random>
+#include <thread>
+#include <vector>
+#include "InstanceTransforms.h"
+#include "ThreadPool.h"
+
+namespace {
+	//repeats fn until at least this long has been spent timing it
+	const double MIN_SECONDS = 0.25;
+
+	template<typename Fn>
+	double nanosecondsPerInstance(int count, Fn fn) {
+		typedef std::chrono::steady_clock Clock;
+		fn(); // warm up caches
+		int runs = 0;
+		Clock::time_point start = Clock::now();
+		double elapsed = 0.0;
+		do {
+			fn();
+			runs++;
+			elapsed = std::chrono::duration<double>(Clock::now() - start).count();
+		} while (elapsed < MIN_SECONDS);
+		return elapsed * 1e9 / ((double)runs * count);
+	}
+
+	float maxDifference(const float* a, const float* b, size_t n) {
+		float result = 0.0f;
+		for (size_t i = 0; i < n; i++) {
+			result = std::max(result, std::fabs(a[i] - b[i]) / std::max(1.0f, std::fabs(b[i])));
+		}
+		return result;
+	}
+}
+
+int main() {
+	unsigned int numThreads = std::max(1u, std::thread::hardware_concurrency());
+	ThreadPool pool(numThreads - 1);
+	std::mt19937 rng(1234);
+	std::uniform_real_distribution<float> position(-100.0f, 100.0f), angle(0.0f, 6.2831853f), scale(0.001f, 2.0f);
+
+	glm::mat4 projection = glm::perspective(glm::radians(90.0f), 16.0f / 9.0f, 0.1f, 1000.0f);
+	glm::mat4 view = glm::lookAt(glm::vec3(0.0f, 10.0f, 30.0f), glm::vec3(0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+	glm::mat4 VP = projection * view;
+
+	printf("%d threads, times in ns per instance\n", numThreads);
+	printf("%10s | %10s %10s %10s | %10s %10s %10s | %10s %10s\n",
+		"instances", "MVP glm", "SIMD", "SIMD MT", "normal glm", "SIMD", "SIMD MT", "bounds", "SIMD MT");
+
+	const int counts[] = { 20, 1000, 100000, 1000000 };
+	for (int count : counts) {
+		std::vector<glm::mat4> model(count);
+		InstanceStore instances;
+		for (int i = 0; i < count; i++) {
+			glm::mat4 m = glm::translate(glm::mat4(1.0f), glm::vec3(position(rng), position(rng), position(rng)));
+			m = glm::rotate(m, angle(rng), glm::normalize(glm::vec3(position(rng), position(rng), position(rng)) + glm::vec3(0.01f)));
+			model[i] = glm::scale(m, glm::vec3(scale(rng), scale(rng), scale(rng)));
+			instances.add(model[i]);
+		}
+
+		std::vector<glm::mat4> mvpGlm(count), mvpStore(count);
+		std::vector<glm::mat3> normalGlm(count), normalStore(count);
+		std::vector<glm::vec3> worldMin(count), worldMax(count);
+
+		//the loops Main.cpp used before InstanceStore
+		double mvpGlmTime = nanosecondsPerInstance(count, [&]() {
+			for (int i = 0; i < count; i++) {
+				mvpGlm[i] = VP * model[i];
+			}
+		});
+		double mvpTime = nanosecondsPerInstance(count, [&]() { instances.computeMVP(VP, mvpStore.data()); });
+		double mvpParallelTime = nanosecondsPerInstance(count, [&]() { instances.computeMVP(VP, mvpStore.data(), &pool); });
+
+		double normalGlmTime = nanosecondsPerInstance(count, [&]() {
+			for (int i = 0; i < count; i++) {
+				normalGlm[i] = glm::mat3(glm::transpose(glm::inverse(model[i])));
+			}
+		});
+		double normalTime = nanosecondsPerInstance(count, [&]() { instances.computeNormalMatrices(normalStore.data()); });
+		double normalParallelTime = nanosecondsPerInstance(count, [&]() { instances.computeNormalMatrices(normalStore.data(), &pool); });
+
+		glm::vec3 localMin(-1.0f, 0.0f, -2.0f), localMax(1.0f, 3.0f, 2.0f);
+		double boundsTime = nanosecondsPerInstance(count, [&]() {
+			instances.computeWorldBounds(localMin, localMax, worldMin.data(), worldMax.data());
+		});
+		double boundsParallelTime = nanosecondsPerInstance(count, [&]() {
+			instances.computeWorldBounds(localMin, localMax, worldMin.data(), worldMax.data(), &pool);
+		});
+
+		printf("%10d | %10.2f %10.2f %10.2f | %10.2f %10.2f %10.2f | %10.2f %10.2f\n", count,
+			mvpGlmTime, mvpTime, mvpParallelTime, normalGlmTime, normalTime, normalParallelTime, boundsTime, boundsParallelTime);
+
+		//the SIMD results should match glm up to rounding
+		float mvpError = maxDifference(&mvpStore[0][0][0], &mvpGlm[0][0][0], (size_t)count * 16);
+		float normalError = maxDifference(&normalStore[0][0][0], &normalGlm[0][0][0], (size_t)count * 9);
+		if (mvpError > 1e-4f || normalError > 1e-3f) {
+			printf("MISMATCH: MVP relative error %g, normal matrix relative error %g\n", mvpError, normalError);
+			return 1;
+		}
+	}
+	return 0;
+}
\ No newline at end of file
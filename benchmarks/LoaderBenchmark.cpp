@@ -0,0 +1,351 @@
+//Microbenchmarks of the CPU side of loading and of the per frame uniform work: converting an assimp mesh (Scene::convertMesh),
+//uploading it (Scene::processMesh), Scene::loadTexture's lookup and decode, the Shader uniform setters, and writing a frame's
+//uniforms the way Main.cpp used to (a setMat4f per instance) and does now (InstanceStore into the StreamBuffer). Runs headless,
+//GL calls go to MockGL, so only the engine's own cost is measured and not the driver's. Meshes are synthetic grids whose size is
+//set with --triangles. Prints ns, heap allocations and GL calls per op, and with --json writes the same as JSON (with --label,
+//eg a commit hash) for comparing runs. Build from the repository root with eg
+//	g++ -std=c++17 -O2 -march=native -I. -I<glad include> benchmarks/LoaderBenchmark.cpp benchmarks/MockGL.cpp Scene.cpp Mesh.cpp
+//		Shader.cpp GLResource.cpp TextureCooker.cpp StreamBuffer.cpp InstanceTransforms.cpp Profiler.cpp <glad>/glad.c -lassimp -pthread
+//		-o loaderBenchmark
+//(or add the same files to a new console project, without GLFW)
+
+#define STB_IMAGE_IMPLEMENTATION
+#include "stb_image.h"
+#include <glad/glad.h>
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <new>
+#include <string>
+#include <vector>
+#include "InstanceTransforms.h"
+#include "Scene.h"
+#include "StreamBuffer.h"
+#include "MockGL.h"
+
+//normally defined in Main.cpp
+int WIDTH = 1920, HEIGHT = 1080;
+bool COOK_TEXTURES = false;
+float TEXTURE_ANISOTROPY = 8.0f;
+
+//every heap allocation in the program goes through these, so allocations per op include those made inside assimp and the STL
+static std::atomic<long long> allocations(0);
+
+void* operator new(std::size_t size) {
+	allocations.fetch_add(1, std::memory_order_relaxed);
+	void* p = std::malloc(size ? size : 1);
+	if (!p) {
+		throw std::bad_alloc();
+	}
+	return p;
+}
+
+void operator delete(void* p) noexcept {
+	std::free(p);
+}
+
+void operator delete(void* p, std::size_t) noexcept {
+	std::free(p);
+}
+
+//reaches the parts of Scene the loader hot paths are made of (Scene declares it a friend)
+class LoaderBenchmark {
+public:
+	static MeshData convertMesh(aiMesh* mesh, const aiScene* scene, ImportStats& stats) {
+		return Scene::convertMesh(mesh, scene, stats);
+	}
+	static Mesh processMesh(Scene& scene, MeshData& data) {
+		return scene.processMesh(data);
+	}
+	static std::vector<Texture>& loadedTextures() {
+		return Scene::loadedTextures;
+	}
+};
+
+namespace {
+	//repeats an op until at least this long has been spent timing it
+	const double MIN_SECONDS = 0.25;
+	//same as Main.cpp
+	const int INSTANCES = 20;
+
+	struct Result {
+		std::string name;
+		long long size; // what the op scales with (triangles, textures, texels), 0 if nothing
+		double nanoseconds, allocations, glCalls; // per op
+	};
+	std::vector<Result> results;
+
+	template<typename Fn>
+	void run(const char* name, long long size, Fn op) {
+		typedef std::chrono::steady_clock Clock;
+		op(); // warm up caches (and anything allocated on first use)
+		long long ops = 0;
+		long long startAllocations = allocations.load();
+		MockGL::resetCalls();
+		Clock::time_point start = Clock::now();
+		double elapsed = 0.0;
+		do {
+			op();
+			ops++;
+			elapsed = std::chrono::duration<double>(Clock::now() - start).count();
+		} while (elapsed < MIN_SECONDS);
+
+		Result result;
+		result.name = name;
+		result.size = size;
+		result.nanoseconds = elapsed * 1e9 / ops;
+		result.allocations = (double)(allocations.load() - startAllocations) / ops;
+		result.glCalls = (double)MockGL::getCalls() / ops;
+		results.push_back(result);
+		printf("%-36s %10lld | %14.1f %12.2f %10.2f\n", name, size, result.nanoseconds, result.allocations, result.glCalls);
+	}
+
+	//a grid of quads with a vertex per face corner, which is what assimp gives for most .obj files, so welding has work to do.
+	//The aiScene owns (and deletes) everything
+	aiScene* syntheticScene(long long triangles) {
+		int side = std::max(1, (int)std::sqrt(triangles / 2.0));
+		aiMesh* mesh = new aiMesh();
+		mesh->mPrimitiveTypes = aiPrimitiveType_TRIANGLE;
+		mesh->mNumVertices = side * side * 6;
+		mesh->mNumFaces = side * side * 2;
+		mesh->mVertices = new aiVector3D[mesh->mNumVertices];
+		mesh->mNormals = new aiVector3D[mesh->mNumVertices];
+		mesh->mTextureCoords[0] = new aiVector3D[mesh->mNumVertices];
+		mesh->mNumUVComponents[0] = 2;
+		mesh->mFaces = new aiFace[mesh->mNumFaces];
+
+		const int corners[6][2] = { { 0, 0 }, { 1, 0 }, { 1, 1 }, { 0, 0 }, { 1, 1 }, { 0, 1 } };
+		unsigned int v = 0;
+		for (int y = 0; y < side; y++) {
+			for (int x = 0; x < side; x++) {
+				for (const int* corner : corners) {
+					float u = (float)(x + corner[0]) / side, w = (float)(y + corner[1]) / side;
+					mesh->mVertices[v] = aiVector3D(u * 100.0f, std::sin(u * 20.0f) * std::cos(w * 20.0f), w * 100.0f);
+					mesh->mNormals[v] = aiVector3D(0.0f, 1.0f, 0.0f);
+					mesh->mTextureCoords[0][v] = aiVector3D(u, w, 0.0f);
+					v++;
+				}
+			}
+		}
+		for (unsigned int f = 0; f < mesh->mNumFaces; f++) {
+			aiFace& face = mesh->mFaces[f];
+			face.mNumIndices = 3;
+			face.mIndices = new unsigned int[3] { f * 3, f * 3 + 1, f * 3 + 2 };
+		}
+
+		aiScene* scene = new aiScene();
+		scene->mNumMeshes = 1;
+		scene->mMeshes = new aiMesh*[1] { mesh };
+		scene->mNumMaterials = 1;
+		scene->mMaterials = new aiMaterial*[1] { new aiMaterial() };
+		return scene;
+	}
+
+	bool writeFile(const std::string& path, const std::string& contents) {
+		std::ofstream file(path, std::ios::binary);
+		file << contents;
+		return (bool)file;
+	}
+
+	//uncompressed 24 bit TGA, which stb_image decodes without any entropy decoding, so this is a floor for real textures
+	bool writeTexture(const std::string& path, int size) {
+		std::string contents(18 + (size_t)size * size * 3, '\0');
+		contents[2] = 2; // uncompressed true colour
+		contents[12] = (char)(size & 0xFF);
+		contents[13] = (char)(size >> 8);
+		contents[14] = (char)(size & 0xFF);
+		contents[15] = (char)(size >> 8);
+		contents[16] = 24;
+		for (size_t i = 18; i < contents.size(); i++) {
+			contents[i] = (char)(i * 2654435761u >> 24);
+		}
+		return writeFile(path, contents);
+	}
+
+	void writeJson(const char* path, const char* label) {
+		FILE* file = fopen(path, "w");
+		if (!file) {
+			printf("Failed to write results to %s\n", path);
+			return;
+		}
+		fprintf(file, "{\n\t\"label\": \"");
+		for (const char* c = label; *c; c++) {
+			if (*c == '"' || *c == '\\') {
+				fputc('\\', file);
+			}
+			fputc(*c, file);
+		}
+		fprintf(file, "\",\n\t\"results\": [\n");
+		for (size_t i = 0; i < results.size(); i++) {
+			const Result& r = results[i];
+			fprintf(file, "\t\t{ \"name\": \"%s\", \"size\": %lld, \"ns_per_op\": %.2f, \"allocations_per_op\": %.3f, \"gl_calls_per_op\": %.3f }%s\n",
+				r.name.c_str(), r.size, r.nanoseconds, r.allocations, r.glCalls, i + 1 < results.size() ? "," : "");
+		}
+		fprintf(file, "\t]\n}\n");
+		fclose(file);
+		printf("Results written to %s\n", path);
+	}
+}
+
+int main(int argc, char** argv) {
+	std::vector<long long> triangleCounts = { 2000, 200000, 2000000 };
+	const char* jsonPath = NULL;
+	const char* label = "";
+	for (int i = 1; i < argc; i++) {
+		if (std::strcmp(argv[i], "--triangles") == 0 && i + 1 < argc) {
+			//comma separated, eg --triangles 1000,50000
+			triangleCounts.clear();
+			for (const char* s = argv[++i]; *s; ) {
+				char* end;
+				triangleCounts.push_back(std::strtoll(s, &end, 10));
+				s = *end == ',' ? end + 1 : end + std::strlen(end);
+			}
+		}
+		else if (std::strcmp(argv[i], "--json") == 0 && i + 1 < argc) {
+			jsonPath = argv[++i];
+		}
+		else if (std::strcmp(argv[i], "--label") == 0 && i + 1 < argc) {
+			label = argv[++i];
+		}
+		else {
+			printf("Usage: %s [--triangles n,n,...] [--json results.json] [--label text]\n", argv[0]);
+			return 1;
+		}
+	}
+
+	if (!MockGL::install()) {
+		printf("Failed to load the mock GL functions\n");
+		return 1;
+	}
+
+	//a scene to upload meshes into, imported from a single triangle so it has nothing of its own
+	const char* scenePath = "benchmarkScene.obj";
+	writeFile(scenePath, "v 0 0 0\nv 1 0 0\nv 0 1 0\nf 1 2 3\n");
+	Scene scene(scenePath);
+	std::remove(scenePath);
+
+	printf("%-36s %10s | %14s %12s %10s\n", "benchmark", "size", "ns/op", "allocs/op", "GL calls/op");
+
+	// ----- MESHES -----
+	for (long long triangles : triangleCounts) {
+		aiScene* aScene = syntheticScene(triangles);
+		long long actualTriangles = aScene->mMeshes[0]->mNumFaces;
+		ImportStats stats;
+		run("Scene::convertMesh", actualTriangles, [&]() {
+			MeshData data = LoaderBenchmark::convertMesh(aScene->mMeshes[0], aScene, stats);
+		});
+		MeshData converted = LoaderBenchmark::convertMesh(aScene->mMeshes[0], aScene, stats);
+		run("Scene::processMesh", actualTriangles, [&]() {
+			Mesh mesh = LoaderBenchmark::processMesh(scene, converted);
+		});
+		delete aScene;
+	}
+
+	// ----- TEXTURES -----
+	//the directory is passed by value as in the real calls, long enough that it doesn't fit in the small string buffer
+	std::string directory = "resources\\models\\sponza";
+	std::vector<Texture>& loaded = LoaderBenchmark::loadedTextures();
+	for (int count : { 16, 256 }) {
+		loaded.clear();
+		for (int i = 0; i < count; i++) {
+			Texture t;
+			t.texture = GLTexture::create();
+			t.path = "textures\\texture" + std::to_string(i) + ".png";
+			t.resident = true;
+			loaded.push_back(std::move(t));
+		}
+		//the last one loaded is the worst case for the linear search
+		std::string path = loaded.back().path;
+		run("Scene::loadTexture (lookup)", count, [&]() {
+			Scene::loadTexture(path.c_str(), directory);
+		});
+	}
+	for (int size : { 256, 1024 }) {
+		//written where loadTexture will look, which on anything but Windows is a file with a backslash in its name
+		std::string name = "benchmarkTexture" + std::to_string(size) + ".tga";
+		std::string fullPath = std::string(".") + "\\" + name;
+		if (!writeTexture(fullPath, size)) {
+			printf("Failed to write %s\n", fullPath.c_str());
+			continue;
+		}
+		run("Scene::loadTexture (decode)", (long long)size * size, [&]() {
+			loaded.clear();
+			Scene::loadTexture(name.c_str(), ".");
+		});
+		std::remove(fullPath.c_str());
+	}
+	loaded.clear();
+
+	// ----- SHADER SETTERS -----
+	writeFile("benchmark.vert", "#version 330 core\nvoid main() {}\n");
+	writeFile("benchmark.frag", "#version 330 core\nvoid main() {}\n");
+	Shader shader("benchmark.vert", "benchmark.frag");
+	std::remove("benchmark.vert");
+	std::remove("benchmark.frag");
+	shader.use();
+	glm::mat4 matrix(1.0f);
+	glm::vec3 colour(0.5f);
+	run("Shader::setMat4f", 0, [&]() { shader.setMat4f("VP", &matrix[0][0]); });
+	run("Shader::setVec3f", 0, [&]() { shader.setVec3f("objectColour", colour); });
+	run("Shader::setFloat", 0, [&]() { shader.setFloat("shininess", 32.0f); });
+	run("Shader::setBool", 0, [&]() { shader.setBool("diffuseEnabled", true); });
+
+	// ----- PER FRAME UNIFORMS -----
+	glm::mat4 VP = glm::perspective(glm::radians(90.0f), 16.0f / 9.0f, 0.1f, 1000.0f) *
+		glm::lookAt(glm::vec3(0.0f, 10.0f, 30.0f), glm::vec3(0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+	glm::vec3 camPos(0.0f, 10.0f, 30.0f);
+	std::vector<glm::mat4> model(INSTANCES);
+	InstanceStore instances;
+	for (int i = 0; i < INSTANCES; i++) {
+		model[i] = glm::translate(glm::mat4(1.0f), glm::vec3(i * 3.0f, 0.0f, 0.0f));
+		instances.add(model[i]);
+	}
+
+	//the loop main() ran before the FrameData block
+	run("frame uniforms (setMat4f loop)", INSTANCES, [&]() {
+		for (int i = 0; i < INSTANCES; i++) {
+			glm::mat4 MVP = VP * model[i];
+			shader.setMat4f(("MVP[" + std::to_string(i) + "]").c_str(), &MVP[0][0]);
+		}
+		shader.setMat4f("VP", &VP[0][0]);
+		shader.setVec3f("camPos", camPos);
+	});
+
+	//what the simulation and render threads do now, with the same layout as Main.cpp's FrameUniforms. The mock has no buffer
+	//storage, so this takes StreamBuffer's per frame map/unmap path
+	struct FrameUniforms {
+		glm::mat4 MVP[INSTANCES];
+		glm::mat4 VP;
+		glm::mat4 eyeVP[2];
+		glm::mat4 centreVP;
+		glm::vec3 camPos;
+		float padding;
+	};
+	StreamBuffer streamBuffer(sizeof(FrameUniforms), 1);
+	glm::mat4 MVP[INSTANCES];
+	run("frame uniforms (stream buffer)", INSTANCES, [&]() {
+		instances.computeMVP(VP, MVP);
+		streamBuffer.begin();
+		size_t offset = 0;
+		FrameUniforms* uniforms = (FrameUniforms*)streamBuffer.allocate(sizeof(FrameUniforms), offset);
+		std::memcpy(uniforms->MVP, MVP, sizeof(MVP));
+		uniforms->VP = VP;
+		uniforms->eyeVP[0] = uniforms->eyeVP[1] = uniforms->centreVP = VP;
+		uniforms->camPos = camPos;
+		streamBuffer.end();
+		glBindBufferRange(GL_UNIFORM_BUFFER, 0, streamBuffer.id(), offset, sizeof(FrameUniforms));
+	});
+
+	if (jsonPath) {
+		writeJson(jsonPath, label);
+	}
+	return 0;
+}
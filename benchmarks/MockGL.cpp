@@ -0,0 +1,308 @@
+#include <glad/glad.h>
+#include <GLFW/glfw3.h>
+
+#include "MockGL.h"
+
+#include <cstring>
+#include <vector>
+
+namespace {
+	//only ever touched by the thread using the mock context, so deliberately not atomic (which would add to every call timed)
+	long long calls = 0;
+	GLuint nextName = 1;
+	std::vector<unsigned char> mapped; // what glMapBufferRange hands out, grown to the largest range ever mapped
+	char context; // any non-NULL pointer will do as the current context
+
+	const GLubyte* APIENTRY mockGetString(GLenum name) {
+		calls++;
+		switch (name) {
+		case GL_VERSION:
+			return (const GLubyte*)"3.3.0 MockGL";
+		case GL_SHADING_LANGUAGE_VERSION:
+			return (const GLubyte*)"3.30 MockGL";
+		default:
+			return (const GLubyte*)"MockGL";
+		}
+	}
+	const GLubyte* APIENTRY mockGetStringi(GLenum name, GLuint index) {
+		calls++;
+		return (const GLubyte*)""; // never asked for, as GL_NUM_EXTENSIONS is 0
+	}
+	void APIENTRY mockGetIntegerv(GLenum name, GLint* data) {
+		calls++;
+		switch (name) {
+		case GL_MAJOR_VERSION:
+			*data = 3;
+			break;
+		case GL_MINOR_VERSION:
+			*data = 3;
+			break;
+		case GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT:
+			*data = 256;
+			break;
+		default:
+			*data = 0;
+		}
+	}
+	void APIENTRY mockGetFloatv(GLenum name, GLfloat* data) {
+		calls++;
+		*data = 0.0f;
+	}
+	GLenum APIENTRY mockGetError() {
+		calls++;
+		return GL_NO_ERROR;
+	}
+
+	// ----- OBJECTS -----
+	void APIENTRY mockGenNames(GLsizei n, GLuint* names) {
+		calls++;
+		for (GLsizei i = 0; i < n; i++) {
+			names[i] = nextName++;
+		}
+	}
+	void APIENTRY mockDeleteNames(GLsizei n, const GLuint* names) {
+		calls++;
+	}
+	GLuint APIENTRY mockCreateProgram() {
+		calls++;
+		return nextName++;
+	}
+	GLuint APIENTRY mockCreateShader(GLenum type) {
+		calls++;
+		return nextName++;
+	}
+	void APIENTRY mockDeleteName(GLuint name) {
+		calls++;
+	}
+
+	// ----- SHADERS -----
+	void APIENTRY mockShaderSource(GLuint shader, GLsizei count, const GLchar* const* string, const GLint* length) {
+		calls++;
+	}
+	void APIENTRY mockCompileShader(GLuint shader) {
+		calls++;
+	}
+	void APIENTRY mockAttachShader(GLuint program, GLuint shader) {
+		calls++;
+	}
+	void APIENTRY mockLinkProgram(GLuint program) {
+		calls++;
+	}
+	//everything compiles and links, with empty info logs
+	void APIENTRY mockGetObjectiv(GLuint object, GLenum name, GLint* params) {
+		calls++;
+		*params = name == GL_COMPILE_STATUS || name == GL_LINK_STATUS ? GL_TRUE : 0;
+	}
+	void APIENTRY mockGetInfoLog(GLuint object, GLsizei bufSize, GLsizei* length, GLchar* infoLog) {
+		calls++;
+		if (length) {
+			*length = 0;
+		}
+		if (bufSize > 0) {
+			infoLog[0] = '\0';
+		}
+	}
+	void APIENTRY mockUseProgram(GLuint program) {
+		calls++;
+	}
+	//drivers look locations up by name as well, this stands in for that with a hash rather than allocating a table of every name
+	//ever asked for. Not a model of any driver's cost, the benchmarks measure the engine's side of the call
+	GLint APIENTRY mockGetLocation(GLuint program, const GLchar* name) {
+		calls++;
+		unsigned int hash = 2166136261u;
+		for (const GLchar* c = name; *c; c++) {
+			hash = (hash ^ (unsigned char)*c) * 16777619u;
+		}
+		return (GLint)(hash & 0x3FF);
+	}
+	GLuint APIENTRY mockGetUniformBlockIndex(GLuint program, const GLchar* name) {
+		calls++;
+		return 0;
+	}
+	void APIENTRY mockUniformBlockBinding(GLuint program, GLuint index, GLuint binding) {
+		calls++;
+	}
+	void APIENTRY mockUniform1f(GLint location, GLfloat v0) {
+		calls++;
+	}
+	void APIENTRY mockUniform1i(GLint location, GLint v0) {
+		calls++;
+	}
+	void APIENTRY mockUniformfv(GLint location, GLsizei count, const GLfloat* value) {
+		calls++;
+	}
+	void APIENTRY mockUniformMatrixfv(GLint location, GLsizei count, GLboolean transpose, const GLfloat* value) {
+		calls++;
+	}
+
+	// ----- BUFFERS AND VERTEX ARRAYS -----
+	void APIENTRY mockBindBuffer(GLenum target, GLuint buffer) {
+		calls++;
+	}
+	void APIENTRY mockBufferData(GLenum target, GLsizeiptr size, const void* data, GLenum usage) {
+		calls++;
+	}
+	void APIENTRY mockBindBufferRange(GLenum target, GLuint index, GLuint buffer, GLintptr offset, GLsizeiptr size) {
+		calls++;
+	}
+	void* APIENTRY mockMapBufferRange(GLenum target, GLintptr offset, GLsizeiptr length, GLbitfield access) {
+		calls++;
+		if (mapped.size() < (size_t)length) {
+			mapped.resize(length);
+		}
+		return mapped.data();
+	}
+	void APIENTRY mockFlushMappedBufferRange(GLenum target, GLintptr offset, GLsizeiptr length) {
+		calls++;
+	}
+	GLboolean APIENTRY mockUnmapBuffer(GLenum target) {
+		calls++;
+		return GL_TRUE;
+	}
+	void APIENTRY mockBindVertexArray(GLuint array) {
+		calls++;
+	}
+	void APIENTRY mockVertexAttribPointer(GLuint index, GLint size, GLenum type, GLboolean normalized, GLsizei stride, const void* pointer) {
+		calls++;
+	}
+	void APIENTRY mockEnableVertexAttribArray(GLuint index) {
+		calls++;
+	}
+
+	// ----- TEXTURES -----
+	void APIENTRY mockActiveTexture(GLenum texture) {
+		calls++;
+	}
+	void APIENTRY mockBindTexture(GLenum target, GLuint texture) {
+		calls++;
+	}
+	void APIENTRY mockTexParameteri(GLenum target, GLenum name, GLint param) {
+		calls++;
+	}
+	void APIENTRY mockTexParameterf(GLenum target, GLenum name, GLfloat param) {
+		calls++;
+	}
+	void APIENTRY mockTexImage2D(GLenum target, GLint level, GLint internalformat, GLsizei width, GLsizei height, GLint border, GLenum format, GLenum type, const void* pixels) {
+		calls++;
+	}
+	void APIENTRY mockCompressedTexImage2D(GLenum target, GLint level, GLenum internalformat, GLsizei width, GLsizei height, GLint border, GLsizei imageSize, const void* data) {
+		calls++;
+	}
+	void APIENTRY mockGenerateMipmap(GLenum target) {
+		calls++;
+	}
+	void APIENTRY mockPixelStorei(GLenum name, GLint param) {
+		calls++;
+	}
+
+	// ----- DRAWING -----
+	void APIENTRY mockViewport(GLint x, GLint y, GLsizei width, GLsizei height) {
+		calls++;
+	}
+	void APIENTRY mockClear(GLbitfield mask) {
+		calls++;
+	}
+	void APIENTRY mockDrawArrays(GLenum mode, GLint first, GLsizei count) {
+		calls++;
+	}
+	void APIENTRY mockDrawElementsInstanced(GLenum mode, GLsizei count, GLenum type, const void* indices, GLsizei instancecount) {
+		calls++;
+	}
+
+	struct MockFunction {
+		const char* name;
+		void* function;
+	};
+	const MockFunction FUNCTIONS[] = {
+		{ "glGetString", (void*)mockGetString },
+		{ "glGetStringi", (void*)mockGetStringi },
+		{ "glGetIntegerv", (void*)mockGetIntegerv },
+		{ "glGetFloatv", (void*)mockGetFloatv },
+		{ "glGetError", (void*)mockGetError },
+		{ "glGenBuffers", (void*)mockGenNames },
+		{ "glGenVertexArrays", (void*)mockGenNames },
+		{ "glGenTextures", (void*)mockGenNames },
+		{ "glGenFramebuffers", (void*)mockGenNames },
+		{ "glGenRenderbuffers", (void*)mockGenNames },
+		{ "glDeleteBuffers", (void*)mockDeleteNames },
+		{ "glDeleteVertexArrays", (void*)mockDeleteNames },
+		{ "glDeleteTextures", (void*)mockDeleteNames },
+		{ "glDeleteFramebuffers", (void*)mockDeleteNames },
+		{ "glDeleteRenderbuffers", (void*)mockDeleteNames },
+		{ "glCreateProgram", (void*)mockCreateProgram },
+		{ "glCreateShader", (void*)mockCreateShader },
+		{ "glDeleteProgram", (void*)mockDeleteName },
+		{ "glDeleteShader", (void*)mockDeleteName },
+		{ "glShaderSource", (void*)mockShaderSource },
+		{ "glCompileShader", (void*)mockCompileShader },
+		{ "glAttachShader", (void*)mockAttachShader },
+		{ "glLinkProgram", (void*)mockLinkProgram },
+		{ "glGetShaderiv", (void*)mockGetObjectiv },
+		{ "glGetProgramiv", (void*)mockGetObjectiv },
+		{ "glGetShaderInfoLog", (void*)mockGetInfoLog },
+		{ "glGetProgramInfoLog", (void*)mockGetInfoLog },
+		{ "glUseProgram", (void*)mockUseProgram },
+		{ "glGetUniformLocation", (void*)mockGetLocation },
+		{ "glGetAttribLocation", (void*)mockGetLocation },
+		{ "glGetUniformBlockIndex", (void*)mockGetUniformBlockIndex },
+		{ "glUniformBlockBinding", (void*)mockUniformBlockBinding },
+		{ "glUniform1f", (void*)mockUniform1f },
+		{ "glUniform1i", (void*)mockUniform1i },
+		{ "glUniform2fv", (void*)mockUniformfv },
+		{ "glUniform3fv", (void*)mockUniformfv },
+		{ "glUniform4fv", (void*)mockUniformfv },
+		{ "glUniformMatrix3fv", (void*)mockUniformMatrixfv },
+		{ "glUniformMatrix4fv", (void*)mockUniformMatrixfv },
+		{ "glBindBuffer", (void*)mockBindBuffer },
+		{ "glBufferData", (void*)mockBufferData },
+		{ "glBindBufferRange", (void*)mockBindBufferRange },
+		{ "glMapBufferRange", (void*)mockMapBufferRange },
+		{ "glFlushMappedBufferRange", (void*)mockFlushMappedBufferRange },
+		{ "glUnmapBuffer", (void*)mockUnmapBuffer },
+		{ "glBindVertexArray", (void*)mockBindVertexArray },
+		{ "glVertexAttribPointer", (void*)mockVertexAttribPointer },
+		{ "glEnableVertexAttribArray", (void*)mockEnableVertexAttribArray },
+		{ "glActiveTexture", (void*)mockActiveTexture },
+		{ "glBindTexture", (void*)mockBindTexture },
+		{ "glTexParameteri", (void*)mockTexParameteri },
+		{ "glTexParameterf", (void*)mockTexParameterf },
+		{ "glTexImage2D", (void*)mockTexImage2D },
+		{ "glCompressedTexImage2D", (void*)mockCompressedTexImage2D },
+		{ "glGenerateMipmap", (void*)mockGenerateMipmap },
+		{ "glPixelStorei", (void*)mockPixelStorei },
+		{ "glViewport", (void*)mockViewport },
+		{ "glClear", (void*)mockClear },
+		{ "glDrawArrays", (void*)mockDrawArrays },
+		{ "glDrawElementsInstanced", (void*)mockDrawElementsInstanced },
+	};
+
+	void* mockProcAddress(const char* name) {
+		for (const MockFunction& f : FUNCTIONS) {
+			if (std::strcmp(f.name, name) == 0) {
+				return f.function;
+			}
+		}
+		return NULL;
+	}
+}
+
+bool MockGL::install() {
+	return gladLoadGLLoader((GLADloadproc)mockProcAddress) != 0;
+}
+
+long long MockGL::getCalls() {
+	return calls;
+}
+
+void MockGL::resetCalls() {
+	calls = 0;
+}
+
+//in place of GLFW's, which would need glfwInit and a window
+GLFWglproc glfwGetProcAddress(const char* procname) {
+	return (GLFWglproc)mockProcAddress(procname);
+}
+
+GLFWwindow* glfwGetCurrentContext() {
+	return (GLFWwindow*)&context;
+}
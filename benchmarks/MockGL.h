@@ -0,0 +1,16 @@
+#pragma once
+
+//Headless stand in for an OpenGL driver, so the CPU side of code that makes GL calls can be benchmarked without a window or GPU.
+//install() loads glad through a loader that hands back no-op functions (gen/create calls return fresh names, queries report a
+//3.3 context with no extensions and everything compiled and linked). MockGL.cpp also defines the two GLFW functions the
+//engine calls outside of Main.cpp (glfwGetProcAddress and glfwGetCurrentContext), so GLFW isn't linked at all. Functions the
+//mock doesn't implement are left NULL by glad, so code reaching one crashes at the call rather than silently doing nothing.
+//Like a real context it must only be used from one thread at a time
+class MockGL {
+public:
+	//points glad's function pointers at the mock, false if glad rejected it
+	static bool install();
+	//GL calls made since the last resetCalls()
+	static long long getCalls();
+	static void resetCalls();
+};
@@ -1,16 +1,33 @@
 #pragma once
 
 #include <glm/glm.hpp>
+#include <string>
+#include <vector>
+#include "GLResource.h"
 
+// move-only, the program is deleted along with the Shader
 class Shader
 {
 private:
-	// the opengl shader program ID
-	unsigned int shaderProgram;
+	// the opengl shader program
+	GLProgram shaderProgram;
+	// compile/link status is only checked (blocking until the driver has finished) the first time the program is used, so
+	// drivers that compile in the background can work on every shader created at startup at once
+	mutable bool linkChecked = false;
+	unsigned int vertexShader = 0, fragmentShader = 0; // only kept for their info logs, deleted along with the program
+	unsigned long long cacheKey = 0;
+	bool fromCache = false;
+	void finishLinking() const;
 public:
+	// linked program binaries are saved in directory, keyed by the shader sources (including defines) and the driver, and loaded
+	// instead of compiling when they are there and the driver accepts them. Call once the context exists and before creating shaders
+	static void enableProgramCache(const char* directory);
+
 	// constructor reads, compiles and links shaders
-	Shader(const char* vertexPath, const char* fragmentPath);
-	// use the shader (glUseProgram(ShaderProgram))
+	// defines are inserted into both shaders straight after the #version line as "#define <entry>", eg "NUM_LIGHTS 4",
+	// allowing variants of the same source to be compiled
+	Shader(const char* vertexPath, const char* fragmentPath, const std::vector<std::string>& defines = std::vector<std::string>());
+	// use the shader (glUseProgram(ShaderProgram)), the first call also checks it linked properly
 	void use() const;
 	// get attribute location
 	int getAttributeLocation(const char* attribute) const;
@@ -23,4 +40,6 @@ public:
 	void setVec3f(const char* name, const glm::vec3& value) const;
 	void setVec4f(const char* name, const glm::vec4& value) const;
 	void setBool(const char* name, bool value) const;
+	// binds the named uniform block to a uniform buffer binding point, does nothing if the program doesn't use the block
+	void setUniformBlock(const char* name, unsigned int binding) const;
 };
\ No newline at end of file